@@ -0,0 +1,247 @@
+/*   Part of the rsked package.
+ *   Copyright 2020 Steven A. Harp   farlies(at)gmail.com
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <csignal>
+#include <unordered_map>
+#include <pthread.h>
+
+#include "logging.hpp"
+#include "player.hpp"
+
+
+/// Number of operations queued or running, per player.
+///
+static std::mutex BusyMutex {};
+static std::unordered_map<const Player*,unsigned> BusyCount {};
+
+static void note_busy( const Player *p, bool busy )
+{
+    std::lock_guard<std::mutex> lock( BusyMutex );
+    if (busy) {
+        ++BusyCount[p];
+    } else if (0 == --BusyCount[p]) {
+        BusyCount.erase(p);
+    }
+}
+
+
+///////////////////////////////// Player_op ///////////////////////////////////
+
+/// CTOR what names the operation (for the log), fn performs it, and
+/// timeout is how long the owner is willing to wait for it.
+///
+Player_op::Player_op( const char *what, std::function<void(Player&)> fn,
+                      std::chrono::milliseconds timeout )
+    : m_what(what), m_fn(std::move(fn)),
+      m_deadline( std::chrono::steady_clock::now() + timeout )
+{
+}
+
+/// Record a final status st (with exception ep if failed) unless the
+/// operation already has one.  Returns true if st was recorded.
+///
+bool Player_op::finish( Op_status st, std::exception_ptr ep )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    if ((Op_status::pending != m_status) and (Op_status::running != m_status)) {
+        return false;
+    }
+    m_status = st;
+    m_error = ep;
+    m_cv.notify_all();
+    return true;
+}
+
+/// Give up on the operation: if it has not started it never will.
+/// * Will NOT throw
+///
+void Player_op::cancel()
+{
+    if (finish( Op_status::cancelled, nullptr )) {
+        LOG_INFO(Lgr) << "Player operation '" << m_what << "' cancelled";
+    }
+}
+
+/// Has the operation reached a final status?
+///
+bool Player_op::finished() const
+{
+    Op_status st = status();
+    return (Op_status::pending != st) and (Op_status::running != st);
+}
+
+/// Throw whatever the operation threw, or a Player_timeout_exception
+/// or Player_cancel_exception if it was abandoned. Otherwise return.
+///
+void Player_op::rethrow() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    switch (m_status) {
+    case Op_status::failed:
+        std::rethrow_exception( m_error );
+    case Op_status::timed_out:
+        throw Player_timeout_exception();
+    case Op_status::cancelled:
+        throw Player_cancel_exception();
+    default:
+        break;
+    }
+}
+
+/// Current status.
+///
+Op_status Player_op::status() const
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_status;
+}
+
+/// Wait up to ms for the operation to finish.  If its deadline passes
+/// first, it is marked timed out.  Returns true if it has finished
+/// (in whatever way), false if it is still pending or running.
+///
+bool Player_op::wait_for( std::chrono::milliseconds ms )
+{
+    using Clock = std::chrono::steady_clock;
+    {
+        std::unique_lock<std::mutex> lock( m_mutex );
+        auto until = std::min( Clock::now() + ms, m_deadline );
+        m_cv.wait_until( lock, until, [this] {
+                return (Op_status::pending != m_status)
+                    and (Op_status::running != m_status); } );
+    }
+    if (not finished() and (Clock::now() >= m_deadline)) {
+        if (finish( Op_status::timed_out, nullptr )) {
+            LOG_WARNING(Lgr) << "Player operation '" << m_what << "' timed out";
+        }
+    }
+    return finished();
+}
+
+
+//////////////////////////////// Async_player /////////////////////////////////
+
+/// CTOR Start a worker thread for player.
+///
+Async_player::Async_player( spPlayer player )
+    : m_player( std::move(player) )
+{
+    m_worker = std::thread( &Async_player::run, this );
+}
+
+/// DTOR Abandon any operations not yet started, then wait for the
+/// running one (if any) to return.
+///
+Async_player::~Async_player()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_quit = true;
+        for (auto &op : m_queue) {
+            op->cancel();
+            note_busy( m_player.get(), false );
+        }
+        m_queue.clear();
+    }
+    m_cv.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+}
+
+/// Is any operation queued or running on player p?
+///
+bool Async_player::busy( const Player *p )
+{
+    std::lock_guard<std::mutex> lock( BusyMutex );
+    return (BusyCount.count(p) > 0);
+}
+
+/// Queue operation fn, named what, to run on the player once all
+/// earlier ones are done.  The owner will wait up to timeout for it.
+///
+spPlayer_op Async_player::submit( const char *what,
+                                  std::function<void(Player&)> fn,
+                                  std::chrono::milliseconds timeout )
+{
+    auto op = std::make_shared<Player_op>( what, std::move(fn), timeout );
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        note_busy( m_player.get(), true );
+        m_queue.push_back( op );
+    }
+    m_cv.notify_all();
+    return op;
+}
+
+/// Queue play(src).
+///
+spPlayer_op Async_player::play( spSource src, std::chrono::milliseconds timeout )
+{
+    return submit( "play", [src](Player &p) { p.play(src); }, timeout );
+}
+
+/// Queue stop().
+///
+spPlayer_op Async_player::stop( std::chrono::milliseconds timeout )
+{
+    return submit( "stop", [](Player &p) { p.stop(); }, timeout );
+}
+
+/// Worker thread: run queued operations in order until told to quit.
+/// Signals are left to the main thread.
+///
+void Async_player::run()
+{
+    sigset_t all;
+    sigfillset( &all );
+    pthread_sigmask( SIG_BLOCK, &all, nullptr );
+    for (;;) {
+        spPlayer_op op;
+        {
+            std::unique_lock<std::mutex> lock( m_mutex );
+            m_cv.wait( lock, [this] { return m_quit or not m_queue.empty(); } );
+            if (m_queue.empty()) {
+                return;         // m_quit
+            }
+            op = m_queue.front();
+            m_queue.pop_front();
+        }
+        {
+            std::lock_guard<std::mutex> lock( op->m_mutex );
+            if (Op_status::pending == op->m_status) {
+                op->m_status = Op_status::running;
+            }
+        }
+        if (Op_status::running != op->status()) {
+            note_busy( m_player.get(), false );
+            continue;
+        }
+        Op_status st { Op_status::done };
+        std::exception_ptr ep {};
+        try {
+            op->m_fn( *m_player );
+        } catch (...) {
+            st = Op_status::failed;
+            ep = std::current_exception();
+        }
+        note_busy( m_player.get(), false );   // idle before anyone is told
+        if (not op->finish( st, ep )) {
+            LOG_INFO(Lgr) << m_player->name() << " finished abandoned '"
+                          << op->what() << "'";
+        }
+    }
+}
@@ -22,13 +22,16 @@
 
 /// CTOR
 Base_player::Base_player()
-{}
+{
+    m_cm->enable_capture( DefaultCaptureBytes );
+}
 
 /// CTOR with name
 Base_player::Base_player( const char* nm )
     : m_name(nm)
 {
     m_cm->set_name(nm);
+    m_cm->enable_capture( DefaultCaptureBytes );
 }
 
 /// DTOR
@@ -272,6 +275,7 @@ bool Base_player::attempt_restart()
         if ( nrestarts < m_max_restarts) {
             LOG_INFO(Lgr) << m_name << " Attempt to restart player on {"
                           << m_src->name() << "}";
+            ++m_restarts;
             play( m_src );
         } else {
             LOG_ERROR(Lgr) << m_name << " Too many failures to attempt another restart";
@@ -16,6 +16,8 @@
  *   limitations under the License.
  */
 
+#include <atomic>
+
 #include "player.hpp"
 #include "childmgr.hpp"
 
@@ -27,8 +29,10 @@
 class Base_player : public Player_with_caps {
 protected:
     spSource m_src {};
+    static constexpr size_t DefaultCaptureBytes { 8192 }; // child output kept
     const unsigned m_max_restarts { 2 };     // no more than this many restarts
     const time_t m_restart_interval { 10 };  // in this many seconds
+    std::atomic<unsigned long> m_restarts { 0 };  // restarts attempted
     PlayerState m_pstate { PlayerState::Stopped };
     std::string m_name { "Base_player" };
     std::string m_device { };                // audio device e.g. "hw:0,0"
@@ -57,6 +61,7 @@ public:
     virtual void pause();
     virtual void play( spSource )=0;
     virtual void resume();
+    virtual unsigned long restarts() const { return m_restarts; }
     virtual PlayerState state();
     virtual void stop();
     virtual bool check();
@@ -18,6 +18,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <netdb.h>
 
 #include "inetcheck.hpp"
 #include "util/config.hpp"
@@ -131,3 +132,46 @@ bool Inet_checker::inet_ready()
                    << " < " << m_refresh_secs;
     return m_last_status;
 }
+
+
+/// Resolve the host named in url (scheme://[user@]host[:port]/...) so
+/// that the answer is in the resolver cache when the url is played.
+/// Returns true if the host resolved.  This blocks for as long as the
+/// resolver takes, so call it ahead of time, not when audio is due.
+///
+/// * Will NOT throw
+///
+bool prefetch_host( const std::string &url )
+{
+    auto p = url.find("://");
+    if (p == std::string::npos) {
+        return false;
+    }
+    std::string host { url.substr( p+3 ) };
+    host = host.substr( 0, host.find_first_of("/?#") );
+    auto at = host.rfind('@');
+    if (at != std::string::npos) {
+        host.erase( 0, at+1 );
+    }
+    if (not host.empty() and host.front()=='[') {     // [IPv6]:port
+        host = host.substr( 1, host.find(']')-1 );
+    } else {
+        host = host.substr( 0, host.find(':') );
+    }
+    if (host.empty()) {
+        return false;
+    }
+    struct addrinfo hints {};
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res { nullptr };
+    int rc = getaddrinfo( host.c_str(), nullptr, &hints, &res );
+    if (res) {
+        freeaddrinfo( res );
+    }
+    if (rc) {
+        LOG_WARNING(Lgr) << "Cannot resolve " << host << ": " << gai_strerror(rc);
+        return false;
+    }
+    LOG_DEBUG(Lgr) << "Resolved " << host << " ahead of play";
+    return true;
+}
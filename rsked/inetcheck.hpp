@@ -27,6 +27,7 @@
  *   limitations under the License.
  */
 
+#include <string>
 #include <boost/filesystem.hpp>
 
 class Config;
@@ -51,3 +52,5 @@ public:
     //
     Inet_checker();
 };
+
+extern bool prefetch_host( const std::string& );
@@ -86,10 +86,10 @@ bool Main::Button1 = false;
 bool Main::ReloadReq = false;
 
 
-/// Signal handler function for various signals.
-/// This is handled in the main loop.
+/// Record the arrival of signal s in the flags examined by the main
+/// loop. Safe to call from a signal handler.
 ///
-void my_signal_handler(int s)
+void Main::note_signal(int s)
 {
     if ((s == SIGTERM) || (s == SIGINT) || (s==SIGQUIT)) {
         Main::Terminate = true;
@@ -103,6 +103,31 @@ void my_signal_handler(int s)
     }
 }
 
+/// Block (blockp true) or unblock, in the calling thread, the signals
+/// handled by note_signal.  Threads inherit the mask of their creator,
+/// so main blocks them before any thread is started: then they can
+/// only be taken from the reactor's signalfd (Rsked::track_events),
+/// instead of being handled by whichever thread the kernel picks.
+/// * Will NOT throw
+///
+void Main::block_signals(bool blockp)
+{
+    sigset_t mask;
+    sigemptyset( &mask );
+    for (int s : { SIGTERM, SIGINT, SIGQUIT, SIGUSR1, SIGHUP }) {
+        sigaddset( &mask, s );
+    }
+    pthread_sigmask( (blockp ? SIG_BLOCK : SIG_UNBLOCK), &mask, nullptr );
+}
+
+/// Signal handler function for various signals.
+/// This is handled in the main loop.
+///
+void my_signal_handler(int s)
+{
+    Main::note_signal(s);
+}
+
 /// Handle SIGTERM and SIGINT by flagging Terminate
 ///
 void setup_term_handler()
@@ -171,6 +196,7 @@ int main(int ac, char **av)
     }
     //
     setup_term_handler();
+    Main::block_signals(true);   // before any thread starts
     auto  logpath = expand_home( "~/logs/rsked_%5N.log" );
     int log_mode = (vm.count("console") or vm.count("test")
                    ? (LF_FILE|LF_CONSOLE) : LF_FILE);
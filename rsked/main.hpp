@@ -31,5 +31,7 @@ namespace Main {
     extern bool Terminate;
     extern int  gTermSignal;
 
+    void block_signals(bool);
     void log_banner(bool);
+    void note_signal(int);
 }
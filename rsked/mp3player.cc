@@ -82,6 +82,7 @@ void Mp3_player::initialize( Config& cfg, bool /* testp */ )
     boost::filesystem::path binpath { DefaultBinPath };
     cfg.get_pathname(section, "bin_path", FileCond::MustExist, binpath );
     m_cm->set_binary( binpath );
+    configure_child( cfg, section, *m_cm );
     LOG_INFO(Lgr) << m_name << " initialized";
 }
 
@@ -16,6 +16,7 @@
  *   limitations under the License.
  */
 
+#include <algorithm>
 #include <assert.h>
 #include <unistd.h>
 #include <iostream>
@@ -105,6 +106,7 @@ void Mpd_client::connect()
         if (not m_conn) {
             m_conn = mpd_connection_new( m_socket_path.c_str(), 
                                          m_port, m_timeout_ms );
+            ++m_round_trips;        // the server greets us
             if (!m_conn) { // this means: out of memory
                 throw Mpd_connect_exception();
             }
@@ -160,6 +162,7 @@ bool Mpd_client::check_status(Mpd_opt printopt)
             return false;
         }
         // Get status:
+        ++m_round_trips;
         status = mpd_run_status( m_conn );
         if (!status) {
             LOG_ERROR(Lgr) << "Mpd_client: Did not get a status object from MPD";
@@ -196,6 +199,7 @@ bool Mpd_client::check_status(Mpd_opt printopt)
             LOG_ERROR(Lgr) << "Mpd_client::check_status/2: " << perr;
             runtime_error = true;
             // attempt to clear it
+            ++m_round_trips;
             if (m_conn and not mpd_run_clearerror(m_conn)) {
                 LOG_ERROR(Lgr) << "Mpd_client::check_status/3 "
                     "failed to clear the last player error";
@@ -386,6 +390,7 @@ void Mpd_client::stop()
     unsigned tries=1;
     connect();
     assert_connected();
+    ++m_round_trips;
     while (not mpd_run_stop(m_conn)) {
         enum mpd_server_error serr;
         auto perr = diag_error("Mpd_client::stop: ",serr);
@@ -404,6 +409,7 @@ void Mpd_client::enqueue( const std::string &uri )
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     int id = mpd_run_add( m_conn, uri.c_str() );
     if (-1 == id) {
         enum mpd_server_error serr;
@@ -441,6 +447,7 @@ int Mpd_client::enqueue_id( const std::string &uri )
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     int id = mpd_run_add_id( m_conn, uri.c_str() );
     if (-1 == id) {
         enum mpd_server_error serr;
@@ -460,6 +467,7 @@ void Mpd_client::enqueue_playlist( const std::string &plname )
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     bool ok = mpd_run_load( m_conn, plname.c_str() );
     if (not ok) {
         enum mpd_server_error serr;
@@ -480,6 +488,7 @@ void Mpd_client::pause()
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     if (not mpd_run_pause( m_conn, true )) {
         enum mpd_server_error serr;
         diag_error("Mpd_client::pause: ",serr);
@@ -494,6 +503,7 @@ void Mpd_client::unpause()
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     if (not mpd_run_pause( m_conn, false )) {
         enum mpd_server_error serr;
         diag_error("Mpd_client::unpause: ",serr);
@@ -507,6 +517,7 @@ void Mpd_client::play()
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     if (not mpd_run_play( m_conn )) {
         enum mpd_server_error serr;
         diag_error("Mpd_client::play: ",serr);
@@ -521,6 +532,7 @@ void Mpd_client::play_pos(unsigned p)
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     if (not mpd_run_play_pos( m_conn, p )) {
         enum mpd_server_error serr;
         diag_error("Mpd_client::play_pos: ",serr);
@@ -535,6 +547,7 @@ void Mpd_client::play( unsigned id )
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     if (not mpd_run_play_id( m_conn, id )) {
         enum mpd_server_error serr;
         diag_error("Mpd_client::play(id): ",serr);
@@ -548,6 +561,7 @@ void Mpd_client::set_repeat_mode(bool repeatp)
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     if (not mpd_run_repeat(m_conn, repeatp)) {
         enum mpd_server_error serr;
         diag_error("Mpd_client::set_repeat_mode: ",serr);
@@ -564,6 +578,7 @@ void Mpd_client::set_volume(unsigned pct)
     }
     connect();
     assert_connected();
+    ++m_round_trips;
     if (not mpd_run_set_volume(m_conn, pct)) {
         enum mpd_server_error serr;
         diag_error("Mpd_client::set_volume: ",serr);
@@ -578,6 +593,7 @@ void Mpd_client::clear_queue()
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     if (not mpd_run_clear(m_conn)) {
         enum mpd_server_error serr;
         diag_error("Mpd_client::clear_queue: ",serr);
@@ -585,6 +601,190 @@ void Mpd_client::clear_queue()
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
+/// Stop playing.
+Mpd_batch& Mpd_batch::stop()
+{
+    m_cmds.push_back( Cmd{ Op::stop } );
+    return *this;
+}
+
+/// Clear the queue.
+Mpd_batch& Mpd_batch::clear_queue()
+{
+    m_cmds.push_back( Cmd{ Op::clear } );
+    return *this;
+}
+
+/// Set the volume to a given percentage of full (0-100).
+Mpd_batch& Mpd_batch::set_volume( unsigned pct )
+{
+    m_cmds.push_back( Cmd{ Op::volume, {}, std::min( pct, 100U ) } );
+    return *this;
+}
+
+/// Whether to repeat the queue indefinitely many times.
+Mpd_batch& Mpd_batch::set_repeat_mode( bool repeatp )
+{
+    m_cmds.push_back( Cmd{ Op::repeat, {}, (repeatp ? 1U : 0U) } );
+    return *this;
+}
+
+/// Add a local file, directory, or URL to the end of the queue.
+Mpd_batch& Mpd_batch::enqueue( const std::string &uri )
+{
+    m_cmds.push_back( Cmd{ Op::add, uri } );
+    return *this;
+}
+
+/// Add a named playlist to the end of the queue.
+Mpd_batch& Mpd_batch::enqueue_playlist( const std::string &plname )
+{
+    m_cmds.push_back( Cmd{ Op::load, plname } );
+    return *this;
+}
+
+/// Play the current track.
+Mpd_batch& Mpd_batch::play()
+{
+    m_cmds.push_back( Cmd{ Op::play } );
+    return *this;
+}
+
+
+/// Descriptor of the connection to MPD, e.g. to watch for the reply
+/// to idle(), or -1 if not connected.
+///
+int Mpd_client::fd() const
+{
+    return (m_conn ? mpd_connection_get_fd( m_conn ) : -1);
+}
+
+/// Put the connection in idle mode: MPD will reply once any of the
+/// subsystems in mask (mpd_idle bits, e.g. MPD_IDLE_PLAYER) changes.
+/// Collect the reply with recv_idle() when fd() is readable.  No other
+/// command may be sent meanwhile.  Returns false on failure.
+///
+/// * May throw Mpd_connect_exception
+///
+bool Mpd_client::idle( unsigned mask )
+{
+    connect();
+    assert_connected();
+    ++m_round_trips;            // the reply comes later
+    if (not mpd_send_idle_mask( m_conn, static_cast<enum mpd_idle>(mask) )) {
+        enum mpd_server_error serr;
+        diag_error("Mpd_client::idle: ",serr);
+        return false;
+    }
+    return true;
+}
+
+/// Collect the reply to idle(), setting events to the subsystems that
+/// changed.  With cancel, first ask MPD to end the idle at once
+/// (noidle), when events may be 0.  Returns false if the connection
+/// failed, in which case it is closed.
+///
+/// * Will NOT throw
+///
+bool Mpd_client::recv_idle( unsigned &events, bool cancel )
+{
+    events = 0;
+    if (not m_conn) {
+        return false;
+    }
+    if (cancel) {
+        mpd_send_noidle( m_conn );
+    }
+    events = static_cast<unsigned>( mpd_recv_idle( m_conn, false ) );
+    if (MPD_ERROR_SUCCESS != mpd_connection_get_error( m_conn )) {
+        enum mpd_server_error serr;
+        diag_error("Mpd_client::recv_idle: ",serr);
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+/// Send (but do not finish) the single command c; see run_batch.
+/// Returns false if it could not be sent.
+///
+bool Mpd_client::send_cmd( const Mpd_batch::Cmd &c )
+{
+    using Op = Mpd_batch::Op;
+    switch (c.op) {
+    case Op::stop:
+        return mpd_send_stop( m_conn );
+    case Op::clear:
+        return mpd_send_clear( m_conn );
+    case Op::volume:
+        return mpd_send_set_volume( m_conn, c.n );
+    case Op::repeat:
+        return mpd_send_repeat( m_conn, (c.n != 0) );
+    case Op::add:
+        return mpd_send_add( m_conn, c.arg.c_str() );
+    case Op::load:
+        return mpd_send_load( m_conn, c.arg.c_str() );
+    case Op::play:
+        return mpd_send_play( m_conn );
+    }
+    return false;
+}
+
+/// Send all the commands of batch to MPD as one command list, and
+/// await the single reply: one round trip however many commands.  MPD
+/// runs them in order, abandoning the rest should one fail.  Failures
+/// are reported as the lone command would have been: a resource that
+/// cannot be enqueued throws Mpd_queue_exception (with last_err
+/// NoExist), anything else Mpd_run_exception.
+///
+/// * May throw.
+///
+void Mpd_client::run_batch( const Mpd_batch &batch )
+{
+    if (batch.empty()) {
+        return;
+    }
+    connect();
+    assert_connected();
+    ++m_round_trips;
+    bool ok = mpd_command_list_begin( m_conn, false );
+    for (const auto &c : batch.commands()) {
+        ok = ok and send_cmd( c );
+    }
+    ok = ok and mpd_command_list_end( m_conn ) and mpd_response_finish( m_conn );
+    LOG_DEBUG(Lgr) << "Mpd_client: " << batch.size()
+                   << " commands in one round trip (" << m_round_trips
+                   << " round trips in all)";
+    if (ok) {
+        return;
+    }
+    // Which command failed? MPD tells us, for a server error.
+    const Mpd_batch::Cmd *failed { nullptr };
+    if (MPD_ERROR_SERVER == mpd_connection_get_error( m_conn )) {
+        unsigned at = mpd_connection_get_server_error_location( m_conn );
+        if (at < batch.size()) {
+            failed = &batch.commands()[at];
+        }
+    }
+    enum mpd_server_error serr;
+    diag_error( "Mpd_client::run_batch: ", serr );
+    if (failed and (Mpd_batch::Op::add == failed->op)) {
+        LOG_ERROR(Lgr) << "Failed to enqueue resource '" << failed->arg << "'";
+        m_last_err = Mpd_err::NoExist;
+        throw Mpd_queue_exception();
+    }
+    if (failed and (Mpd_batch::Op::load == failed->op)) {
+        if (MPD_SERVER_ERROR_NO_EXIST == serr) {
+            LOG_ERROR(Lgr) << "Playlist '" << failed->arg << "' was not found";
+        }
+        m_last_err = Mpd_err::NoExist;
+        throw Mpd_queue_exception();
+    }
+    throw Mpd_run_exception();
+}
+
 /// Determine if the given URI is playing. Will return true if
 /// mpd is on the right URI, but play is paused or stopped.
 /// @returns true if the current song matches the given URI
@@ -593,6 +793,7 @@ bool Mpd_client::verify_playing_uri( const std::string &uri)
 {
     connect();
     assert_connected();
+    ++m_round_trips;
     mpd_song *song = mpd_run_current_song(m_conn);
     if (!song) { return false; }
     if (const char* puri=mpd_song_get_uri(song)) {
@@ -612,6 +813,7 @@ unsigned Mpd_client::search_album(const std::string &name,
     connect();
     assert_connected();
     mpd_search_cancel(m_conn);
+    ++m_round_trips;
     bool rc =
         mpd_search_db_songs(m_conn,true)
         and mpd_search_add_tag_constraint(m_conn, MPD_OPERATOR_DEFAULT,
@@ -647,3 +849,4 @@ void desc_song( const mpd_song *song )
     }
 }
 
+
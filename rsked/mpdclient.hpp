@@ -73,6 +73,36 @@ enum class Mpd_err {
 
 //////////////////////////////////////////////////////////////////////////
 
+/// A sequence of MPD commands to be sent together as one command list,
+/// costing one round trip, by Mpd_client::run_batch.  The methods are
+/// named for the Mpd_client methods that would send each one alone.
+///
+class Mpd_batch {
+public:
+    enum class Op { stop, clear, volume, repeat, add, load, play };
+    struct Cmd {
+        Op op;
+        std::string arg {};     // uri or playlist name
+        unsigned n {0};         // volume, or repeat flag
+    };
+private:
+    std::vector<Cmd> m_cmds {};
+public:
+    const std::vector<Cmd>& commands() const { return m_cmds; }
+    bool empty() const { return m_cmds.empty(); }
+    size_t size() const { return m_cmds.size(); }
+    //
+    Mpd_batch& clear_queue();
+    Mpd_batch& enqueue( const std::string & );
+    Mpd_batch& enqueue_playlist( const std::string & );
+    Mpd_batch& play();
+    Mpd_batch& set_repeat_mode( bool );
+    Mpd_batch& set_volume( unsigned );
+    Mpd_batch& stop();
+};
+
+//////////////////////////////////////////////////////////////////////////
+
 /// Class to manage MPD
 ///
 class Mpd_client {
@@ -85,8 +115,10 @@ private:
     PlayerState m_obs_state {PlayerState::Stopped};
     unsigned m_server_vers[4] {0,0,0,0};
     Mpd_err m_last_err {Mpd_err::NoError};
+    unsigned long m_round_trips {0};   // exchanges with the server
     void assert_connected();
     void log_status( mpd_status *);
+    bool send_cmd( const Mpd_batch::Cmd & );
 public:
     bool check_status( Mpd_opt );
     void clear_queue();
@@ -100,12 +132,17 @@ public:
     int enqueue( const mpd_song* );
     int enqueue_id( const std::string & );
     void enqueue_playlist( const std::string & );
+    int fd() const;
+    bool idle( unsigned );
     Mpd_err last_err() const { return m_last_err; };
+    unsigned long round_trips() const { return m_round_trips; }
+    void run_batch( const Mpd_batch & );
     PlayerState obs_state() const { return m_obs_state; }
     void pause();
     void play();
     void play(unsigned);
     void play_pos(unsigned);
+    bool recv_idle( unsigned&, bool );
     unsigned search_album(const std::string&, std::vector<std::string>& ); 
     void set_repeat_mode(bool);
     void set_connection_params( const std::string&, unsigned port=0);
@@ -5,6 +5,8 @@
 /// - socket
 /// - host
 /// - port
+/// - idle_events
+/// - stall_check_secs
 
 /*   Part of the rsked package.
  *   Copyright 2020 Steven A. Harp   farlies(at)gmail.com
@@ -28,6 +30,7 @@
 #include "mpdclient.hpp"
 #include "playermgr.hpp"
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <boost/asio.hpp>
 
@@ -37,6 +40,12 @@ constexpr const unsigned Default_mpd_volume = 100;
 constexpr const char *Default_mpd_hostname = "localhost";
 const boost::filesystem::path Default_mpd_socket {"~/.config/mpd/socket"};
 
+/// MPD subsystems watched by the idle connection: the player (play,
+/// stop, song changes, errors), mixer (volume), queue (a.k.a. the
+/// "playlist") and options (e.g. repeat).
+constexpr const unsigned IdleMask =
+    MPD_IDLE_PLAYER | MPD_IDLE_MIXER | MPD_IDLE_QUEUE | MPD_IDLE_OPTIONS;
+
 namespace fs = boost::filesystem;
 
 /// Establish baseline capabilities. Shared by all ctors.
@@ -72,6 +81,7 @@ void Mpd_player::cap_init()
 Mpd_player::Mpd_player()
     : m_name("Mpd_player"),
       m_remote(std::make_unique<Mpd_client>()),
+      m_idler(std::make_unique<Mpd_client>()),
       m_socket(expand_home(Default_mpd_socket)),
       m_hostname(Default_mpd_hostname),
       m_port(Default_mpd_port),
@@ -90,6 +100,7 @@ Mpd_player::Mpd_player()
 Mpd_player::Mpd_player(const char *name)
     : m_name(name),
       m_remote(std::make_unique<Mpd_client>()),
+      m_idler(std::make_unique<Mpd_client>()),
       m_socket(expand_home(Default_mpd_socket)),
       m_hostname(Default_mpd_hostname),
       m_port(Default_mpd_port),
@@ -105,6 +116,10 @@ Mpd_player::Mpd_player(const char *name)
 ///
 Mpd_player::~Mpd_player()
 {
+    {
+        std::lock_guard<std::mutex> lock( m_idle_mutex );
+        drop_idle();
+    }
     shutdown_mpd();  // will not throw
 }
 
@@ -188,6 +203,7 @@ bool Mpd_player::try_connect(bool probe_only)
     if (boost::filesystem::exists(m_socket)) {
         try {
             m_remote->set_connection_params( m_socket.native() );
+            m_idler->set_connection_params( m_socket.native() );
             m_remote->connect();
             LOG_INFO(Lgr) << m_name << " unix socket is connected.";
             return true;
@@ -201,6 +217,7 @@ bool Mpd_player::try_connect(bool probe_only)
     // else try TCP socket
     try {
         m_remote->set_connection_params( m_hostname, m_port );
+        m_idler->set_connection_params( m_hostname, m_port );
         m_remote->connect();
         LOG_INFO(Lgr) << m_name << " " << m_port 
                       << " /TCP  socket is connected.";
@@ -281,6 +298,10 @@ void Mpd_player::mark_unusable()
 {
     m_usable = false;
     m_remote->disconnect();          // no exceptions
+    {
+        std::lock_guard<std::mutex> lock( m_idle_mutex );
+        drop_idle();
+    }
     m_last_unusable = time(0);
     LOG_WARNING(Lgr) << m_name << " is being marked as Unusable until future notice";
     if (m_run_mpd) {
@@ -322,8 +343,203 @@ void Mpd_player::check_not_stalled()
 }
 
 
+/// Names of the MPD subsystems in events, for the log.
+///
+static std::string idle_names( unsigned events )
+{
+    std::string names {};
+    for (unsigned bit=1; bit and (bit <= events); bit <<= 1) {
+        if (events & bit) {
+            const char *nm = mpd_idle_name( static_cast<enum mpd_idle>(bit) );
+            names += (names.empty() ? "" : ",");
+            names += (nm ? nm : "?");
+        }
+    }
+    return names;
+}
+
+/// A copy of the news from the idle connection.
+///
+Mpd_news Mpd_player::idle_news()
+{
+    std::lock_guard<std::mutex> lock( m_idle_mutex );
+    return m_news;
+}
+
+/// Once play() has started a source, expect it to be playing, and
+/// (if not already) put the idle connection to work with the stall
+/// timer.  If that cannot be done, the player polls as before.
+///
+/// * Will NOT throw
+///
+void Mpd_player::watch_idle()
+{
+    if (not m_idle_loop) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock( m_idle_mutex );
+    m_news = Mpd_news{};
+    m_news.state = PlayerState::Playing;
+    m_news.may_be_quiet = (m_src and m_src->may_be_quiet());
+    try {
+        if (m_idle_fd < 0) {
+            if (not m_idler->idle( IdleMask )) {
+                throw Mpd_connect_exception();
+            }
+            m_idle_fd = m_idler->fd();
+            m_idle_loop->add( m_idle_fd, [this](uint32_t) { m_idle_woke = true; } );
+            LOG_DEBUG(Lgr) << m_name << " watching MPD events";
+        }
+        m_stall_timer->arm_periodic( static_cast<time_t>(m_stall_check_secs) );
+        m_news.live = true;
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << m_name << " cannot watch MPD events ("
+                         << ex.what() << ")--will poll";
+        drop_idle();
+    }
+}
+
+/// Close the idle connection and stop the stall timer; the player
+/// then polls MPD.  Caller must hold m_idle_mutex.
+///
+/// * Will NOT throw
+///
+void Mpd_player::drop_idle()
+{
+    if (m_idle_loop and (m_idle_fd >= 0)) {
+        m_idle_loop->remove( m_idle_fd );
+    }
+    m_idle_fd = -1;
+    m_idler->disconnect();
+    if (m_stall_timer) {
+        m_stall_timer->disarm();
+    }
+    m_news.live = false;
+}
+
+/// The player has been told to stop or pause (st): expect that, and
+/// take no more stall samples until it plays again.
+///
+/// * Will NOT throw
+///
+void Mpd_player::quiet_idle( PlayerState st )
+{
+    std::lock_guard<std::mutex> lock( m_idle_mutex );
+    m_news.state = st;
+    if (m_stall_timer) {
+        m_stall_timer->disarm();
+    }
+}
+
+/// Service whatever woke handle_events() in one batch: the idle
+/// connection, the stall timer, or both.  The events are collected
+/// once--for the timer by breaking off the idle, which also takes any
+/// reply already sent--then the status is sampled and we go back to
+/// idle.  Caller must hold m_idle_mutex.
+///
+/// * Will NOT throw
+///
+void Mpd_player::on_idle()
+{
+    const bool timed { m_timer_woke };
+    if (timed) {
+        m_stall_timer->consume();
+    }
+    if (m_idle_fd < 0) {
+        return;
+    }
+    unsigned events {0};
+    if (not m_idler->recv_idle( events, timed )) {
+        LOG_WARNING(Lgr) << m_name << " lost its MPD idle connection--will poll";
+        drop_idle();
+        return;
+    }
+    sample_news( events, timed );
+    try {
+        if ((m_idle_fd >= 0) and not m_idler->idle( IdleMask )) {
+            throw Mpd_connect_exception();
+        }
+    } catch (const Mpd_exception &) {
+        LOG_WARNING(Lgr) << m_name << " cannot resume MPD idle--will poll";
+        drop_idle();
+    }
+}
+
+/// Take the status from the idle connection into m_news, given the
+/// subsystems that changed.  A sample taken by the stall timer (timed)
+/// that finds the elapsed time unchanged while playing counts toward a
+/// stall; more than m_stalls_max in a row is one.  Caller must hold
+/// m_idle_mutex.
+///
+/// * Will NOT throw
+///
+void Mpd_player::sample_news( unsigned events, bool timed )
+{
+    bool ok = m_idler->check_status( Mpd_opt::NoPrint );
+    if (not m_idler->connected()) {
+        LOG_WARNING(Lgr) << m_name << " lost its MPD idle connection--will poll";
+        drop_idle();
+        return;
+    }
+    if (not ok and not m_news.failed) {
+        LOG_WARNING(Lgr) << m_name << " MPD reports a playback error";
+        m_news.failed = true;
+    }
+    if (events & (MPD_IDLE_PLAYER | MPD_IDLE_QUEUE)) {
+        m_news.changed = true;
+    }
+    PlayerState st = m_idler->obs_state();
+    if ((PlayerState::Playing == m_news.state) and (PlayerState::Stopped == st)) {
+        LOG_INFO(Lgr) << m_name << " MPD has stopped playing";
+    }
+    m_news.state = st;
+    unsigned u = m_idler->elapsed_secs();
+    if (timed and (PlayerState::Playing == st) and not m_news.may_be_quiet
+        and (u == m_news.last_elapsed)) {
+        if ((++m_news.stall_count > m_stalls_max) and not m_news.stalled) {
+            LOG_WARNING(Lgr) << m_name << " MPD elapsed time stuck at "
+                             << u << " secs";
+            m_news.stalled = true;
+        }
+    } else if (u != m_news.last_elapsed) {
+        m_news.stall_count = 0;
+    }
+    m_news.last_elapsed = u;
+    if (events) {
+        LOG_DEBUG(Lgr) << m_name << " MPD events: " << idle_names( events )
+                       << "; elapsed " << u << " secs";
+    }
+}
+
+
 ///////////////////////////////// Player API /////////////////////////////////
 
+/// Descriptor that is readable when the idle connection or the stall
+/// timer has news for handle_events(), or -1 if MPD is only polled.
+///
+int Mpd_player::event_fd() const
+{
+    return (m_idle_loop ? m_idle_loop->fd() : -1);
+}
+
+/// Take in the news from the idle connection and the stall timer.
+/// Called by the main thread, perhaps while another thread is busy
+/// with this player, so it touches only the idle connection and news.
+///
+/// * Will NOT throw
+///
+void Mpd_player::handle_events()
+{
+    std::lock_guard<std::mutex> lock( m_idle_mutex );
+    if (m_idle_loop) {
+        m_idle_woke = m_timer_woke = false;
+        m_idle_loop->run_once( 0 );
+        if (m_idle_woke or m_timer_woke) {
+            on_idle();
+        }
+    }
+}
+
 /// Returns true if MPD is not actually playing, or the connection to the
 /// process is broken.
 ///
@@ -331,6 +547,10 @@ void Mpd_player::check_not_stalled()
 ///
 bool Mpd_player::completed()
 {
+    Mpd_news news = idle_news();
+    if (news.live) {            // no need to ask
+        return (news.state != PlayerState::Playing);
+    }
     if (!m_remote->check_status((m_debug ? Mpd_opt::Print : Mpd_opt::NoPrint))) {
         // there was a serious issue, e.g. cannot communicate with mpd
         return false;
@@ -350,21 +570,33 @@ bool Mpd_player::completed()
 /// playing a named playlist--if this type of source is encountered
 /// we just verify the name of the source is the last one we enqueued.
 ///
+/// While the idle connection is watching, its news stands in for the
+/// status, and the song is verified only if it may have changed.
+///
 /// * May THROW a Player_exception if there is something basically
 ///   wrong with the player.  Player should have marked itself unusable.
+///   Throws Player_media_exception if MPD failed or stalled on src.
 ///
 bool Mpd_player::currently_playing( spSource src )
 {
     if (!src or !m_src) { return false; }
-    assure_connected();
+    Mpd_news news = idle_news();
+    if (not news.live) {
+        assure_connected();
+    }
     if (m_src->name() != src->name()) { // wrong source?
         return false;
     }
+    if (news.failed or news.stalled) {
+        LOG_WARNING(Lgr) << m_name << (news.failed ? " failed" : " appears stalled")
+                         << " on {" << m_src->name() << "}";
+        throw Player_media_exception();
+    }
     // remote elapsed_secs() and obs_state() have been updated.
     // Verify that state is play, or pause, or stopped with no-repeat
     // If playing, check whether elapsed time is different than last check;
     // and if the same, increment the stall counter, up to STALLS_MAX.
-    switch (m_remote->obs_state()) {
+    switch (news.live ? news.state : m_remote->obs_state()) {
     case PlayerState::Stopped:
         if (src->repeatp()) {
             LOG_WARNING(Lgr) << m_name 
@@ -373,7 +605,9 @@ bool Mpd_player::currently_playing( spSource src )
         }
         break;
     case PlayerState::Playing:
-        check_not_stalled();
+        if (not news.live) {
+            check_not_stalled();
+        }
         return true;
         break;
     case PlayerState::Paused:
@@ -392,6 +626,9 @@ bool Mpd_player::currently_playing( spSource src )
     if (src->medium() == Medium::playlist) {
         return true;
     }
+    if (news.live and not news.changed) { // still the song play() started
+        return true;
+    }
     // this checks that the song or the URL is the same as resource()
     return m_remote->verify_playing_uri( src->resource() );
 }
@@ -402,6 +639,10 @@ bool Mpd_player::currently_playing( spSource src )
 ///
 void Mpd_player::exit()
 {
+    {
+        std::lock_guard<std::mutex> lock( m_idle_mutex );
+        drop_idle();
+    }
     if (m_cm->running()) {
         try {
             m_remote->disconnect();
@@ -456,12 +697,31 @@ void Mpd_player::initialize( Config &cfg, bool testp )
     }
     cfg.get_string(m_name.c_str(),"host", m_hostname);
     cfg.get_bool(m_name.c_str(),"debug", m_debug);
+    cfg.get_bool(m_name.c_str(),"idle_events", m_use_idle);
+    cfg.get_unsigned(m_name.c_str(),"stall_check_secs", m_stall_check_secs);
+    if (m_stall_check_secs < 1) {
+        LOG_WARNING(Lgr) << "Mpd stall_check_secs raised to 1";
+        m_stall_check_secs = 1;
+    }
+    if (m_use_idle and not m_testmode and not m_idle_loop) {
+        try {
+            m_idle_loop = std::make_unique<Event_loop>();
+            m_stall_timer = std::make_unique<Timer_fd>( CLOCK_MONOTONIC );
+            m_idle_loop->add( m_stall_timer->fd(), [this](uint32_t) {
+                    m_timer_woke = true; } );
+        } catch (const Event_loop_exception&) {
+            LOG_WARNING(Lgr) << m_name << " will poll MPD, not watch it";
+            m_idle_loop.reset();
+            m_stall_timer.reset();
+        }
+    }
     // depending on timing, the socket might not exist (yet)
     cfg.get_pathname(m_name.c_str(),"socket", FileCond::NA, m_socket);
     cfg.get_pathname(m_name.c_str(),"bin_path", 
                      FileCond::MustExist, m_bin_path);
     m_cm->set_binary( m_bin_path );
     m_cm->set_name( m_name );
+    configure_child( cfg, m_name.c_str(), *m_cm );
     //
     if (m_enabled) {
         LOG_INFO(Lgr) << "Mpd_player '" << m_name << "' initialized";
@@ -552,6 +812,7 @@ void Mpd_player::pause()
         m_remote->pause();
     }
     m_state = PlayerState::Paused;
+    quiet_idle( PlayerState::Paused );
 }
 
 
@@ -560,7 +821,8 @@ void Mpd_player::pause()
 /// cleared and only the source will be scheduled to play.  It will
 /// verify that MPD is usable; if the process or connection had not
 /// been initiated, it will be launched now: this is the normal way to
-/// start the MPD process/connection. The volume is set to m_volume%.
+/// start the MPD process/connection. The volume is set to m_level% of
+/// m_volume%.
 ///
 /// * May throw Player_media_exception(), Player_comm_exception
 ///
@@ -574,18 +836,14 @@ void Mpd_player::play( spSource src )
     if (m_testmode) {           // testing only
         return;
     }
+    auto trips = m_remote->round_trips();
     assure_connected();
-    try {
-        if (not m_usable) {
-            LOG_ERROR(Lgr) << m_name << " is not usable--cannot play";
-            throw Player_comm_exception();
-        }
-        m_remote->stop();
-        m_remote->clear_queue();
-        m_remote->set_volume(m_volume);
-    } catch (const Mpd_run_exception &) {
-        throw Player_media_exception();
+    if (not m_usable) {
+        LOG_ERROR(Lgr) << m_name << " is not usable--cannot play";
+        throw Player_comm_exception();
     }
+    Mpd_batch batch {};
+    batch.stop().clear_queue().set_volume( m_volume * m_level / 100 );
 
     Medium medium = src->medium();
     // validate medium
@@ -601,38 +859,57 @@ void Mpd_player::play( spSource src )
     case Medium::directory:
     case Medium::file:
         LOG_INFO(Lgr) << m_name << " play: {" << src->name() << "}";
-        try {
-            if (src->dynamic()) {
-                std::string dynstr;
-                uri_expand_time( src->resource(), dynstr );
-                m_remote->enqueue(dynstr);
-            } else {
-                m_remote->enqueue(src->resource());
-            }
-        } catch (Mpd_queue_exception&) {
-            throw Player_media_exception();
+        if (src->dynamic()) {
+            std::string dynstr;
+            uri_expand_time( src->resource(), dynstr );
+            batch.enqueue(dynstr);
+        } else {
+            batch.enqueue(src->resource());
         }
-        m_src = src;
         break;
     case Medium::playlist:
         LOG_INFO(Lgr) << m_name << " play: {" << src->name() << "}";
         // strip any trailing extension, like .m3u, if present
         fs::path plfile { src->name() };
         std::string plstem { plfile.stem().native() };
-        try {
-            m_remote->enqueue_playlist( plstem );
-        } catch (Mpd_queue_exception&) {
-            throw Player_media_exception();
-        }
-        m_src = src;
+        batch.enqueue_playlist( plstem );
         break;
     };
+    batch.set_repeat_mode( src->repeatp() ).play();
     //
+    // Everything goes to MPD in one round trip.
+    try {
+        m_remote->run_batch( batch );
+    } catch (const Mpd_queue_exception &) {
+        throw Player_media_exception();
+    } catch (const Mpd_run_exception &) {
+        throw Player_media_exception();
+    }
+    LOG_DEBUG(Lgr) << m_name << " play took " << (m_remote->round_trips() - trips)
+                   << " MPD round trips";
+    m_src = src;
     m_stall_counter = 0;
     m_last_elapsed_secs = 0;
-    m_remote->set_repeat_mode( src->repeatp() );
-    m_remote->play();
     m_state = PlayerState::Playing;
+    watch_idle();
+}
+
+/// Get ready to play src at an upcoming slot boundary: make sure the
+/// MPD process and connection are up, and for a network stream look up
+/// the host now, so that play() has less to do when the time comes.
+/// Anything now playing is left alone.
+///
+/// * May throw Player_exception or CM_exception
+///
+void Mpd_player::prepare( spSource src )
+{
+    if (not m_enabled or m_testmode or not src) {
+        return;
+    }
+    assure_connected();
+    if (Medium::stream == src->medium() and Player_manager::inet_available()) {
+        prefetch_host( src->resource() );
+    }
 }
 
 /// Resume play after pause. If the current source is a network stream,
@@ -650,10 +927,31 @@ void Mpd_player::resume()
         play(m_src);
     } else {
         m_remote->unpause();
+        watch_idle();
     }
     m_state = PlayerState::Playing;
 }
 
+/// Set the level to pct (at most 100) percent of the configured volume.
+/// It takes effect at once if MPD is connected, and otherwise at the
+/// next play().
+///
+/// * May throw Player_media_exception
+///
+bool Mpd_player::set_volume( unsigned pct )
+{
+    m_level = std::min( pct, 100U );
+    if (m_testmode or not m_remote->connected()) {
+        return true;
+    }
+    try {
+        m_remote->set_volume( m_volume * m_level / 100 );
+    } catch (const Mpd_run_exception &) {
+        throw Player_media_exception();
+    }
+    return true;
+}
+
 /// Return current state.
 ///
 /// * Will NOT throw :-)
@@ -675,6 +973,7 @@ void Mpd_player::stop()
     }
     m_src.reset();
     m_state = PlayerState::Stopped;
+    quiet_idle( PlayerState::Stopped );
     //
     try {
         assure_connected();
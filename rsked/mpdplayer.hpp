@@ -17,12 +17,27 @@
  */
 
 #include <memory>
+#include <mutex>
 #include "player.hpp"
 #include "childmgr.hpp"
+#include "evloop.hpp"
 #include "schedule.hpp"
 
 class Mpd_client;
 
+/// What the idle connection has learned of MPD since the last play().
+///
+struct Mpd_news {
+    bool live {false};          // idle connection is watching
+    PlayerState state {PlayerState::Stopped};  // as last observed
+    bool failed {false};        // MPD reported a player error
+    bool stalled {false};       // elapsed time stopped advancing
+    bool changed {false};       // song or queue changed
+    bool may_be_quiet {false};  // source may be silent (no stall checks)
+    unsigned last_elapsed {0};  // elapsed secs at last sample
+    unsigned stall_count {0};   // samples with no progress in a row
+};
+
 /// MPD Plays most media types, including mp3 streams.
 /// The MPD API is embedded in class Mpd_client.
 /// If m_run_mpd is true, this process will start its own
@@ -31,16 +46,25 @@ class Mpd_client;
 /// Note: this will kill any already running mpd if a pid file
 /// was specified in the configuration.
 ///
+/// While playing, a second connection to MPD waits in idle mode for
+/// changes to the player, mixer, queue or options.  Its replies (and a
+/// periodic sample of the elapsed time, to catch stalls that MPD does
+/// not report) are taken in by handle_events(), and tell the next
+/// currently_playing() whether MPD has stopped, failed or stalled
+/// without its asking.  Without that connection, it polls.
+///
 class Mpd_player : public Player_with_caps {
 private:
     std::string m_name;
     std::unique_ptr<Mpd_client> m_remote;
+    std::unique_ptr<Mpd_client> m_idler;   // second connection, idle mode
     spSource m_src {};  // store the source we are playing
     PlayerState m_state { PlayerState::Stopped };
     boost::filesystem::path m_socket;
     std::string m_hostname;
     unsigned m_port;
     unsigned m_volume;     // as a percentage [0-100]
+    unsigned m_level {100}; // percent of m_volume to play at
     bool m_enabled {true};
     bool m_run_mpd  {true};
     bool m_usable {true};
@@ -53,15 +77,30 @@ private:
     boost::filesystem::path m_bin_path {};
     time_t m_last_unusable { 0 };
     time_t m_recheck_secs { 2*60*60 }; // willing to recheck every 2 hrs
+    bool m_use_idle {true};             // watch MPD with m_idler
+    unsigned m_stall_check_secs {2};    // elapsed time sample period
+    std::unique_ptr<Event_loop> m_idle_loop {};  // watches m_idler
+    std::unique_ptr<Timer_fd> m_stall_timer {};  // when to sample
+    std::mutex m_idle_mutex {};         // guards m_idler and m_news
+    int m_idle_fd {-1};                 // m_idler descriptor, if watched
+    bool m_idle_woke {false};           // m_idle_fd readable this batch
+    bool m_timer_woke {false};          // m_stall_timer expired this batch
+    Mpd_news m_news {};
     //
     bool any_mpd_running();
     void assure_connected();
     void cap_init();
     void check_not_stalled();
+    void drop_idle();
+    Mpd_news idle_news();
     void mark_unusable();
+    void on_idle();
+    void quiet_idle( PlayerState );
+    void sample_news( unsigned, bool );
     void shutdown_mpd();
     bool try_connect( bool probe_only=false );
     void try_start();
+    void watch_idle();
 public:
     Mpd_player();
     Mpd_player(const char*);
@@ -77,7 +116,11 @@ public:
     virtual bool is_usable();
     virtual void pause();
     virtual void play( spSource );
+    virtual void prepare( spSource );
     virtual void resume();
+    virtual bool set_volume( unsigned );
+    virtual int event_fd() const;
+    virtual void handle_events();
     virtual PlayerState state();
     virtual void stop();
     virtual bool check();
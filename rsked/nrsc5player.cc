@@ -83,6 +83,7 @@ void Nrsc5_player::initialize( Config& cfg, bool testp )
     cfg.get_pathname( myName, "bin_path",
                       FileCond::MustExist, binpath);
     m_cm->set_binary( binpath );
+    configure_child( cfg, myName, *m_cm );
     //
     m_device_index = 0;
     cfg.get_unsigned( myName, "device_index", m_device_index );
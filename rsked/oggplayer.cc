@@ -78,6 +78,7 @@ void Ogg_player::initialize( Config& cfg, bool /* testp */ )
     cfg.get_pathname("Ogg_player","bin_path",
                  FileCond::MustExist, binpath);
     m_cm->set_binary( binpath );
+    configure_child( cfg, "Ogg_player", *m_cm );
     //
     fs::path wkdir {"."};
     if (cfg.get_pathname("Ogg_player","working_dir",
@@ -0,0 +1,436 @@
+/// The warm annunciator plays pre-decoded clips through a resident sink.
+
+/*   Part of the rsked package.
+ *   Copyright 2020 Steven A. Harp   farlies(at)gmail.com
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pcmplayer.hpp"
+#include "config.hpp"
+#include "schedule.hpp"
+
+using Steady = std::chrono::steady_clock;
+
+
+//////////////////////////////////////////////////////////////////////////////
+
+/// CTOR with name.  The feeder thread starts now and idles.
+///
+Pcm_player::Pcm_player( const char *nm )
+    : m_name(nm),
+      m_sink( Child_mgr::create( m_sink_path ) ),
+      m_decoder( Child_mgr::create( m_decoder_path ) )
+{
+    m_sink->set_name( m_name + "_sink" );
+    m_sink->enable_input( PipeBytes );
+    m_decoder->set_name( m_name + "_decoder" );
+    add_cap( Medium::file, Encoding::ogg );
+    m_feeder = std::thread( &Pcm_player::feed, this );
+    LOG_INFO(Lgr) << "Created a Pcm_player: " << m_name;
+}
+
+/// DTOR. Kill the sink, which also releases a feeder blocked in write.
+///
+Pcm_player::~Pcm_player()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_quit = true;
+    }
+    m_cv.notify_all();
+    m_sink->kill_child( true, 100'000 );
+    if (m_feeder.joinable()) {
+        m_feeder.join();
+    }
+}
+
+/// Init: find the sink and decoder, then start the sink so that it is
+/// warm before the first announcement. If either is missing the player
+/// is unusable, and the caller may prefer another annunciator.
+///
+void Pcm_player::initialize( Config &cfg, bool testp )
+{
+    namespace fs = boost::filesystem;
+    const char *section = "Pcm_player";
+    m_testmode = testp;
+    cfg.get_bool( section, "enabled", m_enabled );
+    if (not m_enabled) {
+        LOG_INFO(Lgr) << "Pcm_player '" << m_name << "' (disabled)";
+        return;
+    }
+    cfg.get_pathname( section, "sink_path", FileCond::NA, m_sink_path );
+    cfg.get_pathname( section, "decoder_path", FileCond::NA, m_decoder_path );
+    cfg.get_pathname( section, "tmp_dir", FileCond::NA, m_tmp_dir );
+    cfg.get_unsigned( section, "latency_ms", m_latency_ms );
+    if (not fs::is_directory( m_tmp_dir )) {
+        m_tmp_dir = fs::temp_directory_path();
+    }
+    m_usable = true;
+    for (const fs::path &p : { m_sink_path, m_decoder_path }) {
+        if (not fs::exists( p )) {
+            LOG_WARNING(Lgr) << "Pcm_player '" << m_name << "' needs " << p;
+            m_usable = false;
+        }
+    }
+    m_sink->set_binary( m_sink_path );
+    m_decoder->set_binary( m_decoder_path );
+    configure_child( cfg, section, *m_sink );
+    if (m_usable and not m_testmode) {
+        try {
+            start_sink( m_sink_rate, m_sink_channels );
+        } catch (const CM_exception&) {
+            m_usable = false;
+        }
+    }
+    LOG_INFO(Lgr) << "Pcm_player '" << m_name << "' initialized"
+                  << (m_usable ? "" : " but unusable");
+}
+
+/// (Re)start the sink for PCM of the given rate and channels.  The
+/// feeder must be idle.
+/// * May throw CM_exception
+///
+void Pcm_player::start_sink( unsigned rate, unsigned channels )
+{
+    m_sink->kill_child( true, 100'000 );
+    m_sink->clear_args();
+    m_sink->add_arg( "--playback" );
+    m_sink->add_arg( "--raw" );
+    m_sink->add_arg( "--format=s16le" );
+    m_sink->add_arg( "--rate=" + std::to_string(rate) );
+    m_sink->add_arg( "--channels=" + std::to_string(channels) );
+    m_sink->add_arg( "--latency-msec=" + std::to_string(m_latency_ms) );
+    m_sink->add_arg( "--client-name=rsked" );
+    m_sink->add_arg( "--stream-name=" + m_name );
+    m_sink->start_child();
+    m_sink_rate = rate;
+    m_sink_channels = channels;
+}
+
+/// Decode the ogg file at path into clip, by way of a temporary wav
+/// file.  Returns false (logged) on failure.  Caller must hold
+/// m_cache_mutex, which also guards the decoder and the wav file.
+/// * Will NOT throw
+///
+bool Pcm_player::decode( const std::string &path, Pcm_clip &clip )
+{
+    namespace fs = boost::filesystem;
+    fs::path wav = m_tmp_dir / ("rsked_" + std::to_string(getpid()) + "_ann.wav");
+    auto t0 = Steady::now();
+    bool ok = false;
+    try {
+        m_decoder->clear_args();
+        m_decoder->add_arg( "-q" );
+        m_decoder->add_arg( "-d" );
+        m_decoder->add_arg( "wav" );
+        m_decoder->add_arg( "-f" );
+        m_decoder->add_arg( wav.string() );
+        m_decoder->add_arg( path );
+        m_decoder->start_child();
+        if (not m_decoder->wait_for_phase( ChildPhase::gone, 10'000'000 )) {
+            m_decoder->kill_child( true, 100'000 );
+        } else if (0 == m_decoder->get_exit_status()) {
+            std::ifstream wf( wav.string(), std::ios::binary );
+            std::vector<char> buf { std::istreambuf_iterator<char>(wf),
+                                    std::istreambuf_iterator<char>() };
+            ok = parse_wav( buf, clip );
+        }
+    } catch (const std::exception &ex) {
+        LOG_ERROR(Lgr) << m_name << " decoder: " << ex.what();
+    }
+    boost::system::error_code ec;
+    fs::remove( wav, ec );
+    if (ok) {
+        LOG_INFO(Lgr) << m_name << " decoded " << path << ": " << clip.secs()
+                      << " s at " << clip.rate << "x" << clip.channels << " in "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(
+                          Steady::now() - t0 ).count() << " ms";
+    } else {
+        LOG_ERROR(Lgr) << m_name << " failed to decode " << path;
+    }
+    return ok;
+}
+
+/// Return the clip for src, decoding it unless already cached (from
+/// the same modification of the file); null on failure.  Files too
+/// large for a brief announcement are refused.  Should the cache be
+/// full, the clip is played without being kept, so the clips already
+/// cached (the snooze announcements) stay warm.
+///
+spPcm_clip Pcm_player::load_clip( const spSource &src )
+{
+    namespace fs = boost::filesystem;
+    fs::path path;
+    if (not src->res_path( path )) {
+        return nullptr;             // logged
+    }
+    boost::system::error_code ec;
+    std::time_t mtime = fs::last_write_time( path, ec );
+    uintmax_t bytes = fs::file_size( path, ec );
+    if (ec) {
+        LOG_ERROR(Lgr) << m_name << " cannot read " << path << ": " << ec.message();
+        return nullptr;
+    }
+    if (bytes > MaxClipFileBytes) {
+        LOG_ERROR(Lgr) << m_name << " will not decode " << path << " ("
+                       << bytes << " bytes): too long for an announcement";
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock( m_cache_mutex );
+    auto it = m_clips.find( path.string() );
+    if (it != m_clips.end()) {
+        if (it->second.mtime == mtime) {
+            return it->second.clip;
+        }
+        m_cache_bytes -= it->second.clip->pcm.size();   // file was replaced
+        m_clips.erase( it );
+    }
+    auto clip = std::make_shared<Pcm_clip>();
+    if (not decode( path.string(), *clip )) {
+        return nullptr;
+    }
+    if (m_cache_bytes + clip->pcm.size() <= MaxCacheBytes) {
+        m_cache_bytes += clip->pcm.size();
+        m_clips[ path.string() ] = Cached{ mtime, clip };
+    }
+    return clip;
+}
+
+/// Stop feeding the current clip, if any, and wait until the feeder is
+/// out of write().  Should the sink have stalled, it is killed.
+///
+void Pcm_player::halt_feeder()
+{
+    std::unique_lock<std::mutex> lock( m_mutex );
+    m_clip.reset();
+    if (not m_cv.wait_for( lock, std::chrono::seconds(1),
+                           [this]{ return not m_writing; } )) {
+        lock.unlock();
+        LOG_WARNING(Lgr) << m_name << " sink stalled--killing it";
+        m_sink->kill_child( true, 100'000 );
+        lock.lock();
+        m_cv.wait( lock, [this]{ return not m_writing; } );
+    }
+}
+
+/// Feeder thread: write the current clip to the sink a chunk at a
+/// time.  Signals (SIGPIPE in particular) are left to the main thread.
+///
+void Pcm_player::feed()
+{
+    sigset_t all;
+    sigfillset( &all );
+    pthread_sigmask( SIG_BLOCK, &all, nullptr );
+    std::unique_lock<std::mutex> lock( m_mutex );
+    for (;;) {
+        m_cv.wait( lock, [this]{ return m_quit or (m_clip and not m_paused); } );
+        if (m_quit) {
+            return;
+        }
+        spPcm_clip clip = m_clip;
+        size_t off = m_fed;
+        size_t n = std::min<size_t>( ChunkBytes, clip->pcm.size() - off );
+        int fd = m_sink->input_fd();
+        m_writing = true;
+        lock.unlock();
+        ssize_t rc = write( fd, clip->pcm.data() + off, n );
+        int err = errno;
+        lock.lock();
+        m_writing = false;
+        m_cv.notify_all();
+        if (rc < 0 and EINTR == err) {
+            continue;
+        }
+        if (m_clip != clip) {
+            continue;                   // halted meanwhile
+        }
+        if (rc < 0) {
+            LOG_ERROR(Lgr) << m_name << " cannot write to sink: " << strerror(err);
+            m_clip.reset();
+            m_done_at = Steady::now();
+            continue;
+        }
+        m_fed += static_cast<size_t>(rc);
+        if (m_fed >= clip->pcm.size()) {
+            m_clip.reset();
+        }
+    }
+}
+
+/// Play src, which must be an ogg file.  The clip is decoded first if
+/// need be (see prepare), and the sink restarted only if it died or
+/// the clip's format differs.
+/// * May throw Player_media_exception or Player_startup_exception
+///
+void Pcm_player::play( spSource src )
+{
+    if (not src) {
+        stop();
+        return;
+    }
+    if (not has_cap( src->medium(), src->encoding() )) {
+        LOG_ERROR(Lgr) << m_name << " cannot play type of source in " << src->name();
+        throw Player_media_exception();
+    }
+    spPcm_clip clip = load_clip( src );
+    if (not clip) {
+        throw Player_media_exception();
+    }
+    halt_feeder();
+    if (not m_sink->running() or (clip->rate != m_sink_rate)
+        or (clip->channels != m_sink_channels)) {
+        try {
+            start_sink( clip->rate, clip->channels );
+        } catch (const CM_exception&) {
+            throw Player_startup_exception();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_src = src;
+        m_clip = clip;
+        m_fed = 0;
+        m_paused = false;
+        m_state = PlayerState::Playing;
+        m_done_at = Steady::now() + std::chrono::milliseconds(
+            static_cast<long>(1000.0*clip->secs()) + m_latency_ms );
+    }
+    m_cv.notify_all();
+    LOG_INFO(Lgr) << m_name << " play: {" << src->name() << "}";
+}
+
+/// Decode src ahead of time, and have the sink ready for its format.
+/// * Will NOT throw
+///
+void Pcm_player::prepare( spSource src )
+{
+    if (not src or not is_usable()
+        or not has_cap( src->medium(), src->encoding() )) {
+        return;
+    }
+    try {
+        spPcm_clip clip = load_clip( src );
+        std::lock_guard<std::mutex> lock( m_mutex );
+        if (clip and not m_clip and not m_testmode
+            and (not m_sink->running() or (clip->rate != m_sink_rate)
+                 or (clip->channels != m_sink_channels))) {
+            start_sink( clip->rate, clip->channels );
+        }
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << m_name << " failed to prepare {" << src->name()
+                         << "}: " << ex.what();
+    }
+}
+
+/// Has the current clip been heard in full?  True also when stopped.
+///
+bool Pcm_player::completed()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return (PlayerState::Paused != m_state) and not m_clip
+        and (Steady::now() >= m_done_at);
+}
+
+/// Is src the clip playing (or just played)?
+///
+bool Pcm_player::currently_playing( spSource src )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return src and (src == m_src) and (PlayerState::Stopped != m_state);
+}
+
+/// Stop the clip. The sink stays up, so what it has already buffered
+/// (a few tens of ms) will still be heard.
+///
+void Pcm_player::stop()
+{
+    halt_feeder();
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_state = PlayerState::Stopped;
+    m_src.reset();
+    m_done_at = Steady::now();
+}
+
+/// Stop, and also shut down the sink.
+///
+void Pcm_player::exit()
+{
+    stop();
+    LOG_INFO(Lgr) << "forcing " << m_name << " to exit";
+    m_sink->kill_child( true, 100'000 );
+}
+
+/// Suspend feeding the clip.
+///
+void Pcm_player::pause()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    if (PlayerState::Playing == m_state) {
+        m_paused = true;
+        m_paused_at = Steady::now();
+        m_state = PlayerState::Paused;
+    }
+}
+
+/// Resume feeding the clip.
+///
+void Pcm_player::resume()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        if (PlayerState::Paused != m_state) {
+            return;
+        }
+        m_done_at += (Steady::now() - m_paused_at);
+        m_paused = false;
+        m_state = PlayerState::Playing;
+    }
+    m_cv.notify_all();
+}
+
+/// Current state.
+///
+PlayerState Pcm_player::state()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_state;
+}
+
+/// Keep the sink warm: restart it if it has died while idle.
+/// Returns false if that fails.
+///
+bool Pcm_player::check()
+{
+    if (not is_usable() or m_testmode) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock( m_mutex );
+    if (m_clip or m_sink->running()) {
+        return true;
+    }
+    LOG_WARNING(Lgr) << m_name << " sink is gone--restarting it";
+    try {
+        start_sink( m_sink_rate, m_sink_channels );
+    } catch (const CM_exception&) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+/*   Part of the rsked package.
+ *   Copyright 2020 Steven A. Harp   farlies(at)gmail.com
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "player.hpp"
+#include "childmgr.hpp"
+#include "wavparse.hpp"
+
+
+using spPcm_clip = std::shared_ptr<const Pcm_clip>;
+
+
+/// An annunciator that stays warm: announcements are decoded (by
+/// ogg123) to PCM once and kept in memory, and played by writing them
+/// to a resident sink process (pacat) that has the audio stream open
+/// already.  Starting an announcement thus costs neither a process
+/// launch nor decoder setup.  Writing is done by a feeder thread, so
+/// play() returns at once; a small stdin pipe on the sink keeps the
+/// audio queued behind a stop() short.  Only brief clips (rsked's own
+/// announcements) are accepted; scheduled announcements, which may be
+/// long, are streamed by an Ogg_player instead.
+///
+class Pcm_player : public Player_with_caps {
+private:
+    enum { ChunkBytes=4096, PipeBytes=8192, MaxCacheBytes=(32<<20),
+           MaxClipFileBytes=(256<<10) };
+    struct Cached {
+        std::time_t mtime;              // of the file decoded
+        spPcm_clip clip;
+    };
+    std::string m_name;
+    bool m_enabled {true};
+    bool m_usable {true};
+    bool m_testmode {false};
+    boost::filesystem::path m_sink_path {"/usr/bin/pacat"};
+    boost::filesystem::path m_decoder_path {"/usr/bin/ogg123"};
+    spCM m_sink;                        // pacat, reading PCM on stdin
+    spCM m_decoder;                     // ogg123, writing a wav file
+                                        //   (guarded by m_cache_mutex)
+    boost::filesystem::path m_tmp_dir {"/dev/shm"};
+    unsigned m_latency_ms {50};         // sink buffering
+    unsigned m_sink_rate {44100};       // format the sink was started with
+    unsigned m_sink_channels {2};
+    //
+    std::mutex m_cache_mutex {};        // guards the decoder and cache
+    std::map<std::string,Cached> m_clips {};  // by pathname
+    size_t m_cache_bytes {0};
+    //
+    mutable std::mutex m_mutex {};      // guards the rest
+    std::condition_variable m_cv {};
+    std::thread m_feeder {};
+    spSource m_src {};
+    spPcm_clip m_clip {};               // being fed, or null
+    size_t m_fed {0};                   // bytes of m_clip written
+    bool m_paused {false};
+    bool m_writing {false};             // feeder is in write()
+    bool m_quit {false};
+    PlayerState m_state {PlayerState::Stopped};
+    std::chrono::steady_clock::time_point m_done_at {};  // clip heard by
+    std::chrono::steady_clock::time_point m_paused_at {};
+    //
+    bool decode( const std::string&, Pcm_clip& );
+    void feed();
+    void halt_feeder();
+    spPcm_clip load_clip( const spSource& );
+    void start_sink( unsigned, unsigned );
+public:
+    explicit Pcm_player( const char* );
+    virtual ~Pcm_player();
+    Pcm_player(const Pcm_player&) = delete;
+    void operator=(Pcm_player const&) = delete;
+    //
+    const std::string& name() const override { return m_name; }
+    bool completed() override;
+    bool currently_playing( spSource ) override;
+    void exit() override;
+    void initialize( Config&, bool ) override;
+    bool is_usable() override { return m_enabled and m_usable; }
+    void pause() override;
+    void play( spSource ) override;
+    void prepare( spSource ) override;
+    void resume() override;
+    PlayerState state() override;
+    void stop() override;
+    bool check() override;
+    bool is_enabled() const override { return m_enabled; }
+    bool set_enabled( bool e ) override { m_enabled = e; return true; }
+};
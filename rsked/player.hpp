@@ -16,13 +16,21 @@
  *   limitations under the License.
  */
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include "source.hpp"
 #include "playpref.hpp"
 
 class Config;
+class Child_mgr;
 
 
 /// Problem configuring player
@@ -50,6 +58,16 @@ struct Player_media_exception : public Player_exception {
     const char* what() const throw() { return "Player media exception"; }
 };
 
+/// An asynchronous player operation did not finish in time
+struct Player_timeout_exception : public Player_exception {
+    const char* what() const throw() { return "Player timeout exception"; }
+};
+
+/// An asynchronous player operation was cancelled
+struct Player_cancel_exception : public Player_exception {
+    const char* what() const throw() { return "Player cancel exception"; }
+};
+
 
 /**
  * Abstract Player interface. Real players inherit from this and define
@@ -67,7 +85,21 @@ public:
     virtual bool is_usable()=0;
     virtual void pause()=0;
     virtual void play( spSource )=0;
+    /// Get ready to play the source soon, e.g. by starting a child
+    /// process, without disturbing anything now playing. Optional.
+    virtual void prepare( spSource ) { }
     virtual void resume()=0;
+    /// Set the output level, as a percentage of the configured volume,
+    /// now and for later plays. Returns false if not supported.
+    virtual bool set_volume( unsigned ) { return false; }
+    /// Number of times the player has restarted itself mid-play.
+    virtual unsigned long restarts() const { return 0; }
+    /// Descriptor that becomes readable when the player has news for
+    /// handle_events(), e.g. that its media ended or failed, or -1 if
+    /// it has none.  Optional.
+    virtual int event_fd() const { return -1; }
+    /// Take in the news announced by event_fd(). Optional.
+    virtual void handle_events() { }
     virtual PlayerState state()=0;
     virtual void stop()=0;
     virtual bool check()=0;
@@ -93,9 +125,81 @@ private:
 protected:
     void add_cap( Medium, Encoding );
     void clear_caps();
+    static void configure_child( Config&, const char*, Child_mgr& );
 public:
     virtual bool has_cap( Medium, Encoding ) const;
     virtual void cap_string( std::string & ) const;
     virtual void install_caps( Player_prefs& ) const;
 };
 
+
+/// Progress of an operation submitted to an Async_player.
+///
+enum class Op_status { pending, running, done, failed, cancelled, timed_out };
+
+/**
+ * Handle on one operation submitted to an Async_player.  The owner may
+ * wait for it, up to its deadline, or cancel it.  An operation that is
+ * cancelled or times out before it starts never runs; one that is
+ * already running cannot be interrupted, but its outcome is ignored.
+ */
+class Player_op {
+    friend class Async_player;
+private:
+    std::string m_what;
+    std::function<void(Player&)> m_fn;
+    std::chrono::steady_clock::time_point m_deadline;
+    mutable std::mutex m_mutex {};
+    std::condition_variable m_cv {};
+    Op_status m_status {Op_status::pending};
+    std::exception_ptr m_error {};
+    //
+    bool finish( Op_status, std::exception_ptr );
+public:
+    void cancel();
+    bool finished() const;
+    void rethrow() const;
+    Op_status status() const;
+    bool wait_for( std::chrono::milliseconds );
+    const std::string& what() const { return m_what; }
+    //
+    Player_op( const char*, std::function<void(Player&)>,
+               std::chrono::milliseconds );
+    Player_op(const Player_op&) = delete;
+    void operator=(Player_op const&) = delete;
+};
+
+/// Shared pointer to a Player_op.
+using spPlayer_op = std::shared_ptr<Player_op>;
+
+
+/**
+ * Runs operations on one Player in a worker thread of its own, in the
+ * order submitted, so that the caller can go on handling events while
+ * the player is busy (e.g. starting a child process).  Players are not
+ * thread safe: while busy(), the player must not be used directly.
+ */
+class Async_player {
+private:
+    spPlayer m_player;
+    std::mutex m_mutex {};
+    std::condition_variable m_cv {};
+    std::deque<spPlayer_op> m_queue {};
+    bool m_quit {false};
+    std::thread m_worker {};
+    //
+    void run();
+public:
+    static bool busy( const Player* );
+    bool busy() const { return busy( m_player.get() ); }
+    spPlayer player() const { return m_player; }
+    spPlayer_op submit( const char*, std::function<void(Player&)>,
+                        std::chrono::milliseconds );
+    spPlayer_op play( spSource, std::chrono::milliseconds );
+    spPlayer_op stop( std::chrono::milliseconds );
+    //
+    explicit Async_player( spPlayer );
+    ~Async_player();
+    Async_player(const Async_player&) = delete;
+    void operator=(Async_player const&) = delete;
+};
@@ -21,17 +21,22 @@
  *   limitations under the License.
  */
 #include <algorithm>
+#include <fstream>
+#include <json/json.h>
 #include "version.h"
 #include "logging.hpp"
 #include "player.hpp"
+#include "childmgr.hpp"
 #include "playermgr.hpp"
 #include "schedule.hpp"
 #include "config.hpp"
+#include "configutil.hpp"
 
 ////////////////////////////////////////////////////////////////////////////
 /// *EXTEND*
 
 #include "oggplayer.hpp"
+#include "pcmplayer.hpp"
 #include "mp3player.hpp"
 #include "mpdplayer.hpp"
 #if WITH_NRSC5
@@ -81,6 +86,9 @@ Player::~Player() { }
 /// Name of the annunciator player
 constexpr const char *AnnName {"Annunciator"};
 
+/// Name of the player for scheduled announcements, streamed by ogg123
+constexpr const char *SkedAnnName {"Sked_annunciator"};
+
 
 
 /// The Inet_checker is a private static member of class Player_manager
@@ -88,6 +96,10 @@ constexpr const char *AnnName {"Annunciator"};
 ///
 Inet_checker Player_manager::c_ichecker {};
 
+/// Players may consult the Inet_checker from their worker threads.
+///
+static std::mutex InetMutex {};
+
 
 /// CTOR for Player_manager
 Player_manager::Player_manager()
@@ -96,6 +108,11 @@ Player_manager::Player_manager()
     spPlayer nplay = std::make_shared<Silent_player>();
     m_players[ nplay->name() ] = nplay;
     nplay->install_caps(m_prefs);
+    try {
+        m_events = std::make_unique<Event_loop>();
+    } catch (const Event_loop_exception&) {
+        LOG_WARNING(Lgr) << "Player_mgr: player events will not be watched";
+    }
 }
 
 /// DTOR for Player_manager
@@ -106,6 +123,7 @@ Player_manager::~Player_manager()
 ///
 bool Player_manager::inet_available()
 {
+    std::lock_guard<std::mutex> lock( InetMutex );
     return c_ichecker.inet_ready();
 }
 
@@ -116,12 +134,45 @@ void Player_manager::install_player( Config& config, spPlayer pp, bool testp )
 {
     if (pp) {
         pp->initialize(config, testp);
-        m_players[ pp->name() ] = pp;
+        auto &slot = m_players[ pp->name() ];
+        if (m_events and slot and (slot->event_fd() >= 0)) {
+            m_events->remove( slot->event_fd() );   // the player replaced
+        }
+        slot = pp;
+        if (m_events and (pp->event_fd() >= 0)) {
+            std::weak_ptr<Player> wp { pp };
+            try {
+                m_events->add( pp->event_fd(), [wp](uint32_t) {
+                        if (auto sp = wp.lock()) { sp->handle_events(); } } );
+            } catch (const Event_loop_exception&) {
+                LOG_WARNING(Lgr) << "Player_mgr: events of " << pp->name()
+                                 << " will not be watched";
+            }
+        }
     } else {
         LOG_ERROR(Lgr) << "Player_manager: attempt to install null player";
     }
 }
 
+/// Return a descriptor that becomes readable whenever some player has
+/// news for handle_events(), or -1 if there is none.
+///
+int Player_manager::events_fd() const
+{
+    return (m_events ? m_events->fd() : -1);
+}
+
+/// Let each player with news take it in.  Call this whenever
+/// events_fd() is readable.  (Players' handle_events do not throw.)
+/// * Will NOT throw
+///
+void Player_manager::handle_events()
+{
+    if (m_events) {
+        m_events->run_once( 0 );
+    }
+}
+
 /// Configure the player manager using the config object by creating
 /// and initializing new players. (The silent player is configured in
 /// the CTOR.)  N.b. rsked may continue to hold shared pointers to
@@ -129,21 +180,40 @@ void Player_manager::install_player( Config& config, spPlayer pp, bool testp )
 ///
 /// In addition to player configurations, it will also configure the
 /// Inet_checker. If argument testp is true, the configuration will
-/// avoid side effects on the system.
+/// avoid side effects on the system, including the player statistics
+/// file (General.player_stats).
 ///
 /// The annunciator is a player reserved for announcements and will never
-/// play normal programming...
+/// play normal programming...  It is the warm Pcm_player unless that is
+/// disabled or lacks its sink or decoder; then an ogg123 Ogg_player.
+/// Scheduled announcements, which may be long, always have an ogg123
+/// Ogg_player of their own, so they are streamed rather than decoded
+/// to memory.
 ///
 /// * May throw various player errors
 ///
 void Player_manager::configure( Config& config, bool testp )
 {
-    install_player( config, std::make_shared<Ogg_player>(AnnName,0),testp);
+    save_play_stats();          // from any previous configuration
+    auto warm = std::make_shared<Pcm_player>( AnnName );
+    install_player( config, warm, testp );
+    if (not warm->is_usable()) {
+        LOG_INFO(Lgr) << "Player_manager: annunciator will use ogg123";
+        install_player( config, std::make_shared<Ogg_player>(AnnName,0),testp);
+    }
+    install_player( config, std::make_shared<Ogg_player>(SkedAnnName,0), testp );
     INSTALL_PLAYERS
 #if WITH_NRSC5
     install_player( config, std::make_shared<Nrsc5_player>(), testp);
 #endif
     c_ichecker.configure( config );
+    config.get_unsigned("General","check_deadline_ms",m_check_ms);
+    config.get_unsigned("General","rank_shift",m_rank_shift);
+    m_stats_path.clear();
+    if (not testp) {
+        m_stats_path = expand_home( "~/.config/rsked/player_stats.json" );
+        config.get_pathname("General","player_stats",FileCond::NA,m_stats_path);
+    }
     configure_prefs( config );
     check_minimally_usable();
 }
@@ -221,6 +291,320 @@ void Player_manager::configure_prefs(Config& config)
             LOG_ERROR(Lgr) << "Player_mgr could not find player " << pn;
         }
     }
+    compile_dispatch();
+}
+
+/// Compile m_prefs into the dispatch table: for each Medium/Encoding,
+/// the indices (into m_ranked) of the capable players in priority order.
+///
+void Player_manager::compile_dispatch()
+{
+    m_ranked.clear();
+    for (std::size_t m=0; m < NumMedia; m++) {
+        for (std::size_t e=0; e < NumEncodings; e++) {
+            Medium medium = static_cast<Medium>(m);
+            Encoding encoding = static_cast<Encoding>(e);
+            Dispatch_row &row = m_dispatch[m][e];
+            row.count = 0;
+            unsigned np = m_prefs.player_count( medium, encoding );
+            for (unsigned j=0; j<np; j++) {
+                std::string pname;
+                if (not m_prefs.get_player( medium, encoding, j, pname )) {
+                    continue;
+                }
+                auto it = m_players.find( pname );
+                if ((it == m_players.end()) or not it->second) {
+                    continue;
+                }
+                if (row.count == MaxRanked) {
+                    LOG_ERROR(Lgr) << "Player_mgr: too many players for "
+                                   << media_name(medium) << ":"
+                                   << encoding_name(encoding);
+                    break;
+                }
+                std::size_t ix = rank_index( it->second.get() );
+                if (ix == m_ranked.size()) {
+                    m_ranked.push_back( it->second );
+                }
+                row.ix[row.count++] = static_cast<std::uint8_t>(ix);
+            }
+        }
+    }
+    m_seen_usable.assign( m_ranked.size(), true );
+    m_base = m_dispatch;
+    m_play_stats.assign( m_ranked.size(), {} );
+    m_playing.assign( m_ranked.size(), NumMedia*NumEncodings );
+    m_restarts_seen.clear();
+    for (const spPlayer &sp : m_ranked) {
+        m_restarts_seen.push_back( sp->restarts() );
+    }
+    load_play_stats();
+    log_dispatch();
+}
+
+/// Rules for reranking.  A player is judged only after MinSamples
+/// starts, and displaces a better-ranked one only if it costs at most
+/// RankMargin as much.  Each failure or restart costs FailMs.
+///
+constexpr unsigned long MinSamples { 3 };
+constexpr double RankMargin { 0.75 };
+constexpr double FailMs { 10'000.0 };
+
+/// Expected cost of starting a play, in ms, or negative if too few
+/// samples to say.
+///
+static double play_cost( const Play_stats &ps )
+{
+    unsigned long tries = ps.plays + ps.fails;
+    if (tries < MinSamples) {
+        return -1.0;
+    }
+    return ps.start_ms + FailMs * static_cast<double>(ps.fails + ps.restarts)
+        / static_cast<double>(tries);
+}
+
+/// Reorder the dispatch row for medium m, encoding e from its configured
+/// order (m_base) by play_cost, moving no player more than m_rank_shift
+/// places.  At each position the first player left in configured order
+/// is taken unless it is already as far down as allowed, or a player
+/// within reach above it costs sufficiently less.
+///
+void Player_manager::rerank( std::size_t m, std::size_t e )
+{
+    const Dispatch_row &base = m_base[m][e];
+    Dispatch_row &row = m_dispatch[m][e];
+    Dispatch_row old { row };
+    std::array<bool,MaxRanked> used {};
+    const std::size_t slot = m*NumEncodings + e;
+    for (unsigned k=0; k < base.count; k++) {
+        unsigned pick = 0;
+        while (used[pick]) { ++pick; }
+        if (pick + m_rank_shift > k) {
+            double best = play_cost( m_play_stats[base.ix[pick]][slot] );
+            for (unsigned j=pick+1;
+                 (j < base.count) and (j <= k + m_rank_shift); j++) {
+                if (used[j]) continue;
+                double c = play_cost( m_play_stats[base.ix[j]][slot] );
+                if ((best >= 0.0) and (c >= 0.0) and (c < best*RankMargin)) {
+                    pick = j;
+                    best = c;
+                }
+            }
+        }
+        used[pick] = true;
+        row.ix[k] = base.ix[pick];
+    }
+    row.count = base.count;
+    if (old.ix != row.ix) {
+        std::string line {};
+        for (unsigned k=0; k < row.count; k++) {
+            line += " ";
+            line += m_ranked[row.ix[k]]->name();
+        }
+        LOG_INFO(Lgr) << "Player_mgr: rerank "
+                      << media_name(static_cast<Medium>(m)) << ":"
+                      << encoding_name(static_cast<Encoding>(e))
+                      << " ->" << line;
+    }
+}
+
+/// Record a start of src on player taking ms milliseconds, successful
+/// or not (ok), and rerank the players for src's medium and encoding.
+/// * Will NOT throw
+///
+void Player_manager::note_play( const spPlayer &player, const spSource &src,
+                                double ms, bool ok )
+{
+    std::size_t ix = rank_index( player.get() );
+    if (not src or (ix == m_ranked.size())) {
+        return;
+    }
+    auto m = static_cast<std::size_t>( src->medium() );
+    auto e = static_cast<std::size_t>( src->encoding() );
+    const std::size_t slot = m*NumEncodings + e;
+    Play_stats &ps = m_play_stats[ix][slot];
+    if (ok) {
+        ps.start_ms = (0 == ps.plays) ? ms : (0.8*ps.start_ms + 0.2*ms);
+        ++ps.plays;
+        m_playing[ix] = slot;
+    } else {
+        ++ps.fails;
+        m_playing[ix] = NumMedia*NumEncodings;
+    }
+    m_stats_dirty = true;
+    rerank( m, e );
+}
+
+/// Charge any restarts the players have made since last asked to the
+/// medium and encoding each was last started on.
+///
+void Player_manager::note_restarts()
+{
+    for (std::size_t ix=0; ix < m_ranked.size(); ix++) {
+        unsigned long n = m_ranked[ix]->restarts();
+        if (n == m_restarts_seen[ix]) continue;
+        std::size_t slot = m_playing[ix];
+        if (slot < NumMedia*NumEncodings) {
+            m_play_stats[ix][slot].restarts += (n - m_restarts_seen[ix]);
+            m_stats_dirty = true;
+            rerank( slot / NumEncodings, slot % NumEncodings );
+        }
+        m_restarts_seen[ix] = n;
+    }
+}
+
+/// Return the start statistics of player name on medium m, encoding e.
+///
+Play_stats Player_manager::play_stats( const std::string &name,
+                                       Medium m, Encoding e ) const
+{
+    for (std::size_t ix=0; ix < m_ranked.size(); ix++) {
+        if (m_ranked[ix]->name() == name) {
+            return m_play_stats[ix][static_cast<std::size_t>(m)*NumEncodings
+                                    + static_cast<std::size_t>(e)];
+        }
+    }
+    return Play_stats{};
+}
+
+/// Read saved statistics from m_stats_path, if any, and rerank every
+/// row accordingly.  Format:  player > "medium:encoding" > stats
+/// * Will NOT throw
+///
+void Player_manager::load_play_stats()
+{
+    if (m_stats_path.empty() or not boost::filesystem::exists(m_stats_path)) {
+        return;
+    }
+    try {
+        std::ifstream in( m_stats_path.c_str() );
+        Json::Value root;
+        Json::CharReaderBuilder builder;
+        std::string errs;
+        if (not Json::parseFromStream( builder, in, &root, &errs )
+            or not root.isObject()) {
+            LOG_WARNING(Lgr) << "Player_mgr: ignoring defective "
+                             << m_stats_path << " " << errs;
+            return;
+        }
+        for (std::size_t ix=0; ix < m_ranked.size(); ix++) {
+            const Json::Value &jp = root[ m_ranked[ix]->name() ];
+            if (not jp.isObject()) continue;
+            for (std::size_t slot=0; slot < NumMedia*NumEncodings; slot++) {
+                std::string key { media_name(static_cast<Medium>(slot/NumEncodings)) };
+                key += ":";
+                key += encoding_name(static_cast<Encoding>(slot%NumEncodings));
+                const Json::Value &js = jp[key];
+                if (not js.isObject()) continue;
+                Play_stats &ps = m_play_stats[ix][slot];
+                ps.plays = js.get("plays",0).asUInt64();
+                ps.fails = js.get("fails",0).asUInt64();
+                ps.restarts = js.get("restarts",0).asUInt64();
+                ps.start_ms = js.get("start_ms",0.0).asDouble();
+            }
+        }
+        LOG_INFO(Lgr) << "Player_mgr: loaded player statistics from "
+                      << m_stats_path;
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Player_mgr: cannot load " << m_stats_path
+                         << ": " << ex.what();
+        return;
+    }
+    for (std::size_t m=0; m < NumMedia; m++) {
+        for (std::size_t e=0; e < NumEncodings; e++) {
+            rerank( m, e );
+        }
+    }
+}
+
+/// Write the statistics to m_stats_path if they have changed.
+/// * Will NOT throw
+///
+void Player_manager::save_play_stats()
+{
+    if (m_stats_path.empty() or not m_stats_dirty) {
+        return;
+    }
+    try {
+        Json::Value root { Json::objectValue };
+        for (std::size_t ix=0; ix < m_ranked.size(); ix++) {
+            for (std::size_t slot=0; slot < NumMedia*NumEncodings; slot++) {
+                const Play_stats &ps = m_play_stats[ix][slot];
+                if (0 == (ps.plays + ps.fails)) continue;
+                std::string key { media_name(static_cast<Medium>(slot/NumEncodings)) };
+                key += ":";
+                key += encoding_name(static_cast<Encoding>(slot%NumEncodings));
+                Json::Value &js = root[ m_ranked[ix]->name() ][ key ];
+                js["plays"] = Json::UInt64( ps.plays );
+                js["fails"] = Json::UInt64( ps.fails );
+                js["restarts"] = Json::UInt64( ps.restarts );
+                js["start_ms"] = ps.start_ms;
+            }
+        }
+        boost::filesystem::path tmp { m_stats_path };
+        tmp += ".tmp";
+        {
+            std::ofstream out( tmp.c_str(), std::ios::trunc );
+            Json::StreamWriterBuilder builder;
+            out << Json::writeString( builder, root ) << "\n";
+            if (not out) {
+                LOG_WARNING(Lgr) << "Player_mgr: cannot write " << tmp;
+                boost::filesystem::remove( tmp );
+                return;
+            }
+        }
+        boost::filesystem::rename( tmp, m_stats_path );
+        m_stats_dirty = false;
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Player_mgr: cannot save " << m_stats_path
+                         << ": " << ex.what();
+    }
+}
+
+/// Index of player p in m_ranked, or m_ranked.size() if absent.
+///
+std::size_t Player_manager::rank_index( const Player *p ) const
+{
+    std::size_t ix = 0;
+    while ((ix < m_ranked.size()) and (m_ranked[ix].get() != p)) {
+        ++ix;
+    }
+    return ix;
+}
+
+/// Record usability u of the ranked player at index ix, as seen at
+/// selection or health check; changes are logged.
+///
+void Player_manager::note_usable( std::size_t ix, bool u )
+{
+    if ((ix < m_seen_usable.size()) and (m_seen_usable[ix] != u)) {
+        m_seen_usable[ix] = u;
+        LOG_INFO(Lgr) << "Player_mgr: " << m_ranked[ix]->name()
+                      << (u ? " is now usable" : " is now unusable");
+    }
+}
+
+/// Log the dispatch table, one line per Medium/Encoding that has any
+/// players. Players last seen unusable are marked with '!'.
+///
+void Player_manager::log_dispatch() const
+{
+    for (std::size_t m=0; m < NumMedia; m++) {
+        for (std::size_t e=0; e < NumEncodings; e++) {
+            const Dispatch_row &row = m_dispatch[m][e];
+            if (0 == row.count) continue;
+            std::string line { media_name(static_cast<Medium>(m)) };
+            line += ":";
+            line += encoding_name(static_cast<Encoding>(e));
+            line += " ->";
+            for (unsigned k=0; k < row.count; k++) {
+                line += " ";
+                if (not m_seen_usable[row.ix[k]]) line += "!";
+                line += m_ranked[row.ix[k]]->name();
+            }
+            LOG_INFO(Lgr) << "Player dispatch " << line;
+        }
+    }
 }
 
 
@@ -244,14 +628,34 @@ spPlayer Player_manager::get_annunciator()
     return m_players[ SilentName ];
 }
 
+/// Retrieve the player for scheduled announcements, an ogg123
+/// Ogg_player apart from the annunciator.  If it is unusable, returns
+/// the annunciator (see get_annunciator).
+///
+spPlayer Player_manager::get_sked_annunciator()
+{
+    spPlayer pp = m_players[ SkedAnnName ];
+    if (pp and pp->is_usable()) {
+        return pp;
+    }
+    return get_annunciator();
+}
+
 
 /// Retrieve the best available player for the source src.
 ///
 /// If the src argument is null, or the src medium is "Off" then
 /// return the silent player.
 ///
-/// If no suitable player can be determined, or none is
-/// usable, then return a *null* shared pointer.
+/// If no suitable player can be determined, or none is usable, then
+/// return a *null* shared pointer.  A player busy with an asynchronous
+/// operation (e.g. preparing this very source) cannot be asked, so is
+/// judged by the usability last seen; the caller's play will queue
+/// behind the operation.
+///
+/// Candidates come from the dispatch table compiled by configure_prefs,
+/// so the lookup allocates nothing; each player still decides its own
+/// usability, since that can change without the manager's knowledge.
 ///
 /// Will precheck network sources.  This assumes that Internet is
 /// required and might preclude playing fully functional LAN
@@ -274,18 +678,24 @@ Player_manager::get_player( spSource src )
                           "stream "   << src->name();
             return pp;
     }
-    unsigned np = m_prefs.player_count(medium,encoding);
-    //LOG_DEBUG(Lgr) << np << " player options available";
-    for (unsigned j=0; j<np; j++) {
-        std::string pname;
-        if (m_prefs.get_player(medium, encoding, j, pname )) {
-            pp = m_players[ pname ];
-            if (pp and pp->is_usable()) {
-                return pp;
+    const Dispatch_row &row = m_dispatch[static_cast<std::size_t>(medium)]
+                                        [static_cast<std::size_t>(encoding)];
+    for (unsigned k=0; k < row.count; k++) {
+        const spPlayer &cand = m_ranked[ row.ix[k] ];
+        if (Async_player::busy(cand.get())) {
+            if (m_seen_usable[ row.ix[k] ]) {
+                LOG_DEBUG(Lgr) << "Player_mgr: " << cand->name()
+                               << " is busy--play will wait for it";
+                return cand;
             }
+            continue;
+        }
+        bool usable = cand->is_usable();
+        note_usable( row.ix[k], usable );
+        if (usable) {
+            return cand;
         }
     }
-    pp.reset();
     LOG_ERROR(Lgr) << "No usable players for " << media_name(medium)
                    << ":" << encoding_name(encoding);
     return pp;
@@ -330,32 +740,80 @@ void Player_manager::check_minimally_usable()
 /// before that source is marked as "failed" (making it taboo for a while).
 /// In some cases the player itself may be marked as defective.
 ///
+/// The checks run concurrently, each on its player's Async_player, and
+/// are waited for until m_check_ms after the start of the cycle.  The
+/// status of a player whose check is late, or that was already busy,
+/// is unknown this cycle; it is left alone until its worker is idle.
+/// Each check's latency is recorded (see check_stats) and logged hourly.
+///
 /// Typically called for side effects, but returns true iff all
-/// players check out okay.
+/// players with a known status check out okay.
 ///
 bool Player_manager::check_players()
 {
+    using namespace std::chrono;
     check_inet(); // players may invoke Player_manager::inet_available()
-    unsigned nc=0, ngood=0, nplaying=0;
+    Child_mgr::sample_all(); // resource use, and enforce any soft limits
+    auto deadline = steady_clock::now() + milliseconds(m_check_ms);
+    struct Pending {
+        std::string name;
+        spPlayer sp;
+        spPlayer_op op;
+        std::shared_ptr<bool> ok;
+    };
+    std::vector<Pending> pending {};
+    unsigned nc=0, ngood=0, nplaying=0, nunknown=0;
     for ( auto pair : m_players ) {
         spPlayer sp = pair.second;
-        if (sp) {
-            nc++;
-            if (sp->check()) {
-                ngood++;
-            } else {
-                if (sp->is_enabled()) {
-                    LOG_DEBUG(Lgr) << "Player_manager: check fails for "
-                                   << pair.first;
-                }
-            }
-            if (sp->state() ==  PlayerState::Playing) {
-                nplaying++;
-            }
+        if (not sp) {
+            continue;
+        }
+        if (Async_player::busy(sp.get())) {
+            LOG_DEBUG(Lgr) << "Player_manager: " << pair.first
+                           << " is busy--status unknown";
+            ++nunknown;
+            continue;
+        }
+        auto ok = std::make_shared<bool>(false);
+        std::string name { pair.first };
+        auto op = async_player(sp).submit( "check",
+            [this,ok,name,deadline](Player &p) {
+                auto t0 = steady_clock::now();
+                *ok = p.check();
+                auto t1 = steady_clock::now();
+                note_check( name, duration<double,std::milli>(t1-t0).count(),
+                            (t1 > deadline) );
+            },
+            duration_cast<milliseconds>(deadline - steady_clock::now()) );
+        pending.push_back( Pending{ name, sp, op, ok } );
+    }
+    for ( auto &pc : pending ) {
+        pc.op->wait_for( milliseconds(m_check_ms) ); // returns by deadline
+        if (Op_status::done != pc.op->status()) {
+            LOG_WARNING(Lgr) << "Player_manager: check of " << pc.name
+                             << " is late--status unknown";
+            ++nunknown;
+            continue;
+        }
+        nc++;
+        note_usable( rank_index(pc.sp.get()), (*pc.ok and pc.sp->is_enabled()) );
+        if (*pc.ok) {
+            ngood++;
+        } else if (pc.sp->is_enabled()) {
+            LOG_DEBUG(Lgr) << "Player_manager: check fails for " << pc.name;
+        }
+        if (pc.sp->state() ==  PlayerState::Playing) {
+            nplaying++;
         }
     }
     LOG_DEBUG(Lgr) << "Player_manager: " << ngood << "/" << nc
-                   << " players okay, " << nplaying << " playing";
+                   << " players okay, " << nplaying << " playing, "
+                   << nunknown << " unknown";
+    note_restarts();
+    if ((steady_clock::now() - m_stats_logged) >= hours(1)) {
+        log_check_stats();
+        save_play_stats();
+    }
     //
     if (nplaying > 1) {         // this really shouldn't happen...
         return fix_contention( nplaying );
@@ -363,6 +821,59 @@ bool Player_manager::check_players()
     return (nc == ngood);
 }
 
+/// Record that the check of player name took ms milliseconds, and
+/// whether it finished after its cycle's deadline. Called from the
+/// players' worker threads.
+///
+void Player_manager::note_check( const std::string &name, double ms, bool late )
+{
+    std::lock_guard<std::mutex> lock( m_stats_mutex );
+    Check_stats &cs = m_check_stats[name];
+    ++cs.count;
+    if (late) { ++cs.late; }
+    cs.last_ms = ms;
+    cs.max_ms = std::max( cs.max_ms, ms );
+    cs.total_ms += ms;
+}
+
+/// Return the check latency statistics for player name.
+///
+Check_stats Player_manager::check_stats( const std::string &name ) const
+{
+    std::lock_guard<std::mutex> lock( m_stats_mutex );
+    auto it = m_check_stats.find( name );
+    return (it == m_check_stats.end()) ? Check_stats{} : it->second;
+}
+
+/// Log the check latency of every player that has been checked.
+///
+void Player_manager::log_check_stats()
+{
+    m_stats_logged = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock( m_stats_mutex );
+    for ( const auto &pair : m_check_stats ) {
+        const Check_stats &cs = pair.second;
+        if (0 == cs.count) continue;
+        LOG_INFO(Lgr) << "Check latency " << pair.first << ": "
+                      << cs.count << " checks, mean "
+                      << (cs.total_ms / static_cast<double>(cs.count))
+                      << " ms, max " << cs.max_ms << " ms, "
+                      << cs.late << " late";
+    }
+}
+
+/// Return the Async_player that runs operations for player, creating
+/// it if need be.
+///
+Async_player& Player_manager::async_player( const spPlayer &player )
+{
+    auto &ap = m_async[ player.get() ];
+    if (not ap) {
+        ap = std::make_unique<Async_player>( player );
+    }
+    return *ap;
+}
+
 
 /// This is called in the unlikely event that more than one player
 /// thinks it should be playing at the current time(!).
@@ -372,7 +883,7 @@ bool Player_manager::fix_contention( unsigned np )
     LOG_WARNING(Lgr) << np << " players are nominally playing";
     for ( auto pair : m_players ) {
         spPlayer sp = pair.second;
-        if (sp) {
+        if (sp and not Async_player::busy(sp.get())) {
             if (sp->state() ==  PlayerState::Playing) {
                 LOG_WARNING(Lgr) << " - " << sp->name()
                                << " thinks it is playing";
@@ -389,7 +900,7 @@ bool Player_manager::check_inet()
 {
     time_t warn_repeat_secs = 3600; // hourly
     bool previously_working = m_inet_ready;
-    m_inet_ready = c_ichecker.inet_ready();
+    m_inet_ready = inet_available();
     //
     if (not m_inet_ready) {
         time_t tt=time(0);
@@ -410,6 +921,8 @@ bool Player_manager::check_inet()
 ///
 void Player_manager::exit_players()
 {
+    m_async.clear();    // wait for operations in progress
+    save_play_stats();
     for ( auto sp : m_players ) {
         if (sp.second) {
             sp.second->exit();
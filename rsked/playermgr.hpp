@@ -22,11 +22,64 @@
  */
 
 
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "evloop.hpp"
 #include "player.hpp"
 #include "inetcheck.hpp"
 
+
+/// Health check latency of one player.
+///
+struct Check_stats {
+    unsigned long count {0};    // checks completed
+    unsigned long late {0};     // ...of which after the cycle deadline
+    double last_ms {0};
+    double max_ms {0};
+    double total_ms {0};
+};
+
+/// Dimensions of the player dispatch table.
+///
+constexpr std::size_t NumMedia { static_cast<std::size_t>(Medium::playlist)+1 };
+constexpr std::size_t NumEncodings { static_cast<std::size_t>(Encoding::mixed)+1 };
+constexpr std::size_t MaxRanked { 8 };  // most players for any one pair
+
+/// The players able to play one Medium/Encoding pair, best first, as
+/// indices into Player_manager::m_ranked.
+///
+struct Dispatch_row {
+    std::array<std::uint8_t,MaxRanked> ix {};
+    std::uint8_t count {0};
+};
+
+/// Observed performance of one player on one Medium/Encoding, which
+/// may promote or demote it in the dispatch table.
+///
+struct Play_stats {
+    unsigned long plays {0};     // successful starts
+    unsigned long fails {0};     // starts that failed or timed out
+    unsigned long restarts {0};  // restarts needed while playing
+    double start_ms {0};         // smoothed time to start playing
+};
+
 /// This object will retrieve/create a player for any given source.
-/// It also keeps an eye on internet availability.
+/// It also keeps an eye on internet availability, and checks the
+/// health of the players concurrently, each on its Async_player.
+/// Within a bound set by the user, players are reranked by how fast
+/// and reliably they have started and kept playing each medium and
+/// encoding; these statistics are kept in a small state file.
+/// Players with news to push (see Player::event_fd) are watched by a
+/// private event loop whose descriptor, events_fd(), an outer event
+/// loop should watch, calling handle_events() whenever it is readable.
 ///
 class Player_manager {
 private:
@@ -34,22 +87,56 @@ private:
     time_t m_last_inet_warning {0};
     bool m_inet_ready {false};
     std::unordered_map<std::string,spPlayer> m_players {};
+    std::vector<spPlayer> m_ranked {};      // players in the dispatch table
+    std::vector<bool> m_seen_usable {};     // last usability seen, by index
+    std::array<std::array<Dispatch_row,NumEncodings>,NumMedia> m_dispatch {};
+    std::array<std::array<Dispatch_row,NumEncodings>,NumMedia> m_base {};
+    std::vector<std::array<Play_stats,NumMedia*NumEncodings>> m_play_stats {};
+    std::vector<std::size_t> m_playing {};  // stats slot now playing, by index
+    std::vector<unsigned long> m_restarts_seen {};  // by index
+    unsigned m_rank_shift {1};      // most places a player may move
+    boost::filesystem::path m_stats_path {};
+    bool m_stats_dirty {false};
+    unsigned m_check_ms {2000};     // deadline for a cycle of checks
+    mutable std::mutex m_stats_mutex {};
+    std::unordered_map<std::string,Check_stats> m_check_stats {};
+    std::chrono::steady_clock::time_point m_stats_logged {
+        std::chrono::steady_clock::now() };      // first log an hour on
+    std::unordered_map<const Player*,std::unique_ptr<Async_player>> m_async {};
+    std::unique_ptr<Event_loop> m_events {};   // watches player event_fd()s
+    void compile_dispatch();
     void install_player( Config&, spPlayer, bool /*testp*/ );
     void load_json_prefs( Config& );
+    void load_play_stats();
+    void log_check_stats();
+    void note_restarts();
+    void note_check( const std::string&, double, bool );
+    void note_usable( std::size_t, bool );
+    std::size_t rank_index( const Player* ) const;
+    void rerank( std::size_t, std::size_t );
+    void save_play_stats();
     static Inet_checker c_ichecker;
 public:
     Player_manager();
     ~Player_manager();
     //
+    Async_player& async_player( const spPlayer& );
     bool check_inet();
     void check_minimally_usable();
     void configure( Config&, bool /* testp */); 
     void configure_prefs(Config&);
     bool check_players();
+    Check_stats check_stats( const std::string& ) const;
     void exit_players();
+    void handle_events();
     bool fix_contention(unsigned);
+    int events_fd() const;
     spPlayer get_annunciator();
+    spPlayer get_sked_annunciator();
     spPlayer get_player( spSource );
+    void log_dispatch() const;
+    void note_play( const spPlayer&, const spSource&, double, bool );
+    Play_stats play_stats( const std::string&, Medium, Encoding ) const;
     static bool inet_available();
 };
 
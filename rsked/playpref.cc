@@ -23,7 +23,10 @@
  */
 
 #include <algorithm>
+#include "logging.hpp"
 #include "player.hpp"
+#include "childmgr.hpp"
+#include "config.hpp"
 
 
 //////////////////////////////////////////////////////////////////////////////
@@ -154,6 +157,76 @@ void Player_with_caps::clear_caps()
 }
 
 
+/// Configure the child process managed by cm from config section.
+/// All settings are optional:
+///  - soft resource limits: "max_cpu_pct" (percent of one core) and
+///    "max_rss_mb" (resident megabytes);
+///  - "capture_kb", how much of the child's output to keep, 0 for none;
+///  - scheduling: "nice" (-20..19), "rt_priority" (SCHED_RR, 1..99),
+///    "cpu_affinity" (array of cpu numbers), "io_class" ("realtime",
+///    "best-effort" or "idle") and "io_level" (0..7).
+/// Values out of range are logged and ignored.
+/// * May throw if the values are malformed.
+///
+void Player_with_caps::configure_child( Config &cfg, const char *section,
+                                        Child_mgr &cm )
+{
+    double max_cpu_pct {0};
+    unsigned max_rss_mb {0};
+    cfg.get_double( section, "max_cpu_pct", max_cpu_pct );
+    cfg.get_unsigned( section, "max_rss_mb", max_rss_mb );
+    cm.set_limits( max_cpu_pct, 1024UL * max_rss_mb );
+    unsigned capture_kb {0};
+    if (cfg.get_unsigned( section, "capture_kb", capture_kb )) {
+        cm.enable_capture( 1024UL * capture_kb );
+    }
+    //
+    Child_policy pol {};
+    if (cfg.get_int( section, "nice", pol.nice )) {
+        pol.set_nice = ((pol.nice >= -20) and (pol.nice <= 19));
+        if (not pol.set_nice) {
+            LOG_WARNING(Lgr) << section << ".nice out of range -20..19, ignored";
+        }
+    }
+    if (cfg.get_unsigned( section, "rt_priority", pol.rt_priority )
+        and (pol.rt_priority > 99)) {
+        LOG_WARNING(Lgr) << section << ".rt_priority out of range 1..99, ignored";
+        pol.rt_priority = 0;
+    }
+    Json::Value cpus {};
+    if (cfg.get_jvalue( section, "cpu_affinity", cpus )) {
+        for (const auto &c : cpus) {
+            unsigned n = c.asUInt();
+            if (n < 8*sizeof(pol.cpu_mask)) {
+                pol.cpu_mask |= (1UL << n);
+            } else {
+                LOG_WARNING(Lgr) << section << ".cpu_affinity: cpu " << n
+                                 << " ignored";
+            }
+        }
+    }
+    std::string io_class {};
+    if (cfg.get_string( section, "io_class", io_class )) {
+        if ("realtime" == io_class) {
+            pol.io_class = 1;
+        } else if ("best-effort" == io_class) {
+            pol.io_class = 2;
+        } else if ("idle" == io_class) {
+            pol.io_class = 3;
+        } else {
+            LOG_WARNING(Lgr) << section << ".io_class '" << io_class
+                             << "' unknown, ignored";
+        }
+    }
+    if (cfg.get_int( section, "io_level", pol.io_level )
+        and ((pol.io_level < 0) or (pol.io_level > 7))) {
+        LOG_WARNING(Lgr) << section << ".io_level out of range 0..7, using 4";
+        pol.io_level = 4;
+    }
+    cm.set_policy( pol );
+}
+
+
 /// Implements Player API
 bool Player_with_caps::has_cap(Medium m, Encoding e) const
 {
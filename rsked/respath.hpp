@@ -22,6 +22,7 @@
 ///
 class ResPathSpec {
     using path=boost::filesystem::path;
+    friend class Schedule;      // restores resolved paths from a .skedc
 private:
     std::string m_home {""};      // HOME directory (used in defaults)
     path m_library_path {};       // Music Library
@@ -16,6 +16,7 @@
  *   limitations under the License.
  */
 
+#include <algorithm>
 #include <memory>
 
 #include "logging.hpp"
@@ -26,6 +27,9 @@
 #include "schedule.hpp"
 #include "status.h"
 #include "vurunner.hpp"
+#include "childmgr.hpp"
+#include "evloop.hpp"
+#include "clock.hpp"
 
 
 /// >> ----------  Default paths------------ <<
@@ -42,6 +46,9 @@ const boost::filesystem::path DefaultMotdPath
 
 namespace po = boost::program_options;
 
+/// Interval between volume steps of a crossfade.
+constexpr struct timespec FadeStep { 0, 250'000'000 };
+
 /// CTOR
 /// @arg key  status out shared memory key passed from command line
 ///
@@ -52,7 +59,8 @@ Rsked::Rsked(key_t status_key, bool test)
       m_pmgr( std::make_unique<Player_manager>() ),
       m_schedpath( expand_home(DefaultSchedulePath) ),
       m_shmkey(status_key),
-      m_test(test)
+      m_test(test),
+      m_start_tp( std::chrono::steady_clock::now() )
 {
     spSource src {};      // null will get the silent player
     m_cur_player = m_pmgr->get_player( src );
@@ -85,6 +93,9 @@ Rsked::~Rsked()
     if (m_shm_word) {
         shmdt((const void*) m_shm_word);
     }
+    if (IPC_PRIVATE == m_shmkey and m_shm_id > 0) {
+        shmctl(m_shm_id, IPC_RMID, nullptr); // nobody else can find it
+    }
 }
 
 /// Configure the application from a file indicated by p with
@@ -130,7 +141,30 @@ void Rsked::configure(const std::string& p, const po::variables_map &vm)
         m_config->get_pathname(GSection,"sched_path",FileCond::MustExist,
                            m_schedpath);
     }
-    m_sched->load( m_schedpath );
+    m_config->get_bool(GSection,"sched_cache",m_sked_cache);
+    load_schedule( *m_sched );
+
+    // Schedule tracking: poll every m_rest, or (reactor) sleep until
+    // something happens and check the players every m_health_secs.
+    m_config->get_bool(GSection,"reactor",m_reactor);
+    m_config->get_unsigned(GSection,"health_check_secs",m_health_secs);
+    if (m_health_secs < 1) {
+        LOG_ERROR(Lgr) << "health_check_secs must be at least 1 in " << p;
+        throw Config_error();
+    }
+
+    // Prepare the source of the next slot this many seconds ahead.
+    m_config->get_unsigned(GSection,"lookahead_secs",m_lookahead_secs);
+
+    // Start the new player this long before stopping the old one, 0=off.
+    m_config->get_unsigned(GSection,"crossfade_secs",m_crossfade_secs);
+
+    // Give up on a player that takes longer than this to start.
+    m_config->get_unsigned(GSection,"player_start_secs",m_start_secs);
+    if (m_start_secs < 1) {
+        LOG_ERROR(Lgr) << "player_start_secs must be at least 1 in " << p;
+        throw Config_error();
+    }
 
     // load player configurations
     m_pmgr->configure( *m_config, m_test );
@@ -139,10 +173,56 @@ void Rsked::configure(const std::string& p, const po::variables_map &vm)
     m_vu_runner->configure( *m_config, m_test );
 }
 
+/// Load sched from m_schedpath.  If enabled, restore it from the
+/// compiled schedule file when that is up to date, and otherwise
+/// (re)write the compiled file after loading the JSON.  The elapsed
+/// time is logged.
+///
+/// * May throw Schedule_error
+///
+void Rsked::load_schedule( Schedule &sched )
+{
+    using namespace std::chrono;
+    auto t0 = steady_clock::now();
+    const boost::filesystem::path skedc { Schedule::compiled_path(m_schedpath) };
+    bool compiled = (m_sked_cache and sched.load_compiled(m_schedpath, skedc));
+    if (not compiled) {
+        sched.load( m_schedpath );
+        if (m_sked_cache and not m_test) {
+            sched.save_compiled( m_schedpath, skedc );
+        }
+    }
+    LOG_INFO(Lgr) << "Schedule loaded from "
+                  << (compiled ? "compiled file" : "JSON") << " in "
+                  << duration_cast<microseconds>(steady_clock::now()-t0).count()
+                  << " usec";
+}
+
+/// Log, once, how long it took from startup until the first audible
+/// source src began to play.
+///
+void Rsked::note_audio_start( const spSource &src )
+{
+    if (m_audio_started or not src or Medium::off == src->medium()) {
+        return;
+    }
+    m_audio_started = true;
+    using namespace std::chrono;
+    auto ms = duration_cast<milliseconds>(steady_clock::now()-m_start_tp).count();
+    struct timespec up {};
+    clock_gettime( CLOCK_BOOTTIME, &up );
+    LOG_INFO(Lgr) << "Time to audio: " << ms << " ms after rsked start, "
+                  << up.tv_sec << " s after boot, source {"
+                  << src->name() << "}";
+}
+
 /// Attempt to replace the Schedule with a new one loaded from the
-/// configured path, m_sched. On success, it stops the current player
-/// if any, and zeroes out the current slot. On failure, the previous
-/// schedule is retained.
+/// configured path, m_sched. On success, the new schedule inherits
+/// failure marks and completed announcements from the old one.  If
+/// the slot in effect now resolves to the very source being played,
+/// the current player simply continues; otherwise it is stopped and
+/// the current slot zeroed out. On failure, the previous schedule is
+/// retained.
 /// * Will not throw
 ///
 void Rsked::reload_schedule()
@@ -150,17 +230,37 @@ void Rsked::reload_schedule()
     Main::ReloadReq = false;
     LOG_INFO(Lgr) << "Rsked:: reloading schedule on signal";
     //
-    std::unique_ptr<Schedule> psched = std::make_unique<Schedule>();
+    std::unique_ptr<Schedule> psched   // sharing the old resource watcher
+        = std::make_unique<Schedule>( m_sched ? m_sched->resource_watcher()
+                                      : nullptr );
     try {
-        psched->load(m_schedpath);
+        load_schedule( *psched );
         if (! psched->valid()) {
             LOG_ERROR(Lgr) << "Reload of schedule failed--invalid schedule.";
             return;
         }
+        if (m_sched) {
+            psched->carry_over( *m_sched );
+        }
         m_sched = std::move(psched); // install new schedule
+        m_prepared_for = 0;          // its next slot may differ
+        prepare_announcements();     // their files may differ too
+        if (m_cur_slot and m_cur_player and not m_susp_slot
+            and not m_cur_slot->is_announcement()) {
+            spPlay_slot now_slot = m_sched->play_now();
+            if (not now_slot->is_announcement()
+                and now_slot->source() == m_cur_slot->source()) {
+                LOG_INFO(Lgr) << "Reload: continue playing {"
+                              << now_slot->source()->name() << "}";
+                m_cur_slot = now_slot;
+                return;
+            }
+        }
         m_cur_slot.reset();
         if (m_cur_player) {
-            m_cur_player->play(nullptr);
+            finish_fade();
+            use_player( m_cur_player, "stop",
+                        [](Player &p) { p.play(nullptr); } );
         }
     } catch(...) {
         LOG_ERROR(Lgr) << "Reload of schedule failed--keep current schedule.";
@@ -194,7 +294,7 @@ void Rsked::update_status(uint32_t s)
 ///
 bool Rsked::snoozep()
 {
-    return ( m_snooze_until && (time(0) < m_snooze_until) );
+    return ( m_snooze_until && (Clock::now() < m_snooze_until) );
 }
 
 /// Start snooze for prescribed period. The current player, if any
@@ -205,12 +305,13 @@ bool Rsked::snoozep()
 void Rsked::enter_snooze()
 {
     try {
-        m_snooze_until = time(0) + m_snooze_secs;
+        m_snooze_until = Clock::now() + m_snooze_secs;
         update_status(RSK_PAUSED);
         // pause current player if any; eat any sigchild event
-        if (m_cur_player) {
-            m_cur_player->pause();
-            sleep(1); // may return immediately if child dies
+        finish_fade();
+        if (m_cur_player and use_player( m_cur_player, "pause",
+                                         [](Player &p) { p.pause(); } )) {
+            Clock::rest({1,0}); // may return early if child dies
         }
         LOG_INFO(Lgr) << "Rsked: Snooze for " <<
             (m_snooze_secs/60) << " minutes";
@@ -285,13 +386,14 @@ bool Rsked::check_playback_level()
     if (m_snoozing or !m_cur_player or !cur_src) return true;  // in snooze
     if (cur_src->medium() == Medium::off) return true; // off: silence expected
     if (cur_src->may_be_quiet()) return true;          // dead-air okay this src
-    if (time(0) < m_check_enabled_time) return true;   // too soon
+    if (Clock::now() < m_check_enabled_time) return true;   // too soon
     //
     if (m_vu_runner->too_quiet()) {
         // problem detected
         LOG_WARNING(Lgr) << "Current source {" << cur_src->name()
                          << "} is too quiet";
         cur_src->mark_failed(true);
+        finish_fade();
         if (m_cur_player) {
             LOG_WARNING(Lgr) << "Stop player " << m_cur_player->name();
             try {
@@ -329,11 +431,10 @@ void Rsked::play_announcement( const char* sname )
             return;
         }
         // Check for a waking hour--suppress announcement if outside bounds.
-        time_t tnow = time(0);
-        struct tm *ptm = localtime(&tnow);
-        if (ptm and
-            ((ptm->tm_hour < Earliest_announcement_hr)
-             or (ptm->tm_hour >= Latest_announcement_hr))) {
+        struct tm ltm;
+        Clock::local( ltm );
+        if ((ltm.tm_hour < Earliest_announcement_hr)
+            or (ltm.tm_hour >= Latest_announcement_hr)) {
             LOG_WARNING(Lgr) << "Announcement {" << sname
                              << "} suppressed at this time of day";
             return;
@@ -350,13 +451,42 @@ void Rsked::play_announcement( const char* sname )
     } catch (...) {
         LOG_ERROR(Lgr) << "play_announcement(" << sname << ") failed.";
     }
-    try {   // exit the announcement player on failure
+    try {   // stop the announcement player (it may stay warm)
         if (player) {
-            player->exit();
+            use_player( player, "stop", [](Player &p) { p.stop(); } );
         }
     } catch(...) {};
 }
 
+/// Have the annunciator decode the snooze button announcements ahead
+/// of time, so that feedback follows a press within tens of ms. The
+/// work is queued on the annunciator's worker and not awaited.
+///
+/// * Will not throw
+///
+void Rsked::prepare_announcements()
+{
+    if (not m_sched) {
+        return;
+    }
+    try {
+        spPlayer player = m_pmgr->get_annunciator();
+        if (not player or not player->is_usable()) {
+            return;
+        }
+        Async_player &ap = m_pmgr->async_player( player );
+        for (const char *sname : {"%snooze1", "%resume"}) {
+            spSource src = m_sched->find_viable_source( sname );
+            if (src) {
+                ap.submit( "prepare", [src](Player &p) { p.prepare(src); },
+                           std::chrono::seconds(m_start_secs) );
+            }
+        }
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Failed to prepare announcements: " << ex.what();
+    }
+}
+
 /// Play a *scheduled* announcement given the schedule slot, if the
 /// announcement source is available.  The slot is marked as completed.
 /// Any currently playing program is paused while the announcement plays
@@ -403,12 +533,13 @@ void Rsked::play_announcement( spPlay_slot slot )
     }
     // Okay, we have a playable announcement that is not currently
     // playing.  Suspend the current player, and make the annunciator
-    // the current player.
+    // for scheduled announcements, which streams them, the current
+    // player.  Like any other play, this is done on its worker thread.
     suspend_play();
     //
-    m_cur_player = m_pmgr->get_annunciator();
+    m_cur_player = m_pmgr->get_sked_annunciator();
     m_cur_slot = slot;
-    m_cur_player->play( m_cur_slot->source() );
+    async_play( m_cur_player, m_cur_slot->source() );
 }
 
 /// Suspend (pause) the current player, if any.  Its state is cached in
@@ -418,6 +549,7 @@ void Rsked::play_announcement( spPlay_slot slot )
 void Rsked::suspend_play()
 {
     LOG_INFO(Lgr) << "Suspending regularly scheduled programming";
+    finish_fade();
     if (m_cur_player) {
         PlayerState ps = m_cur_player->state();
         if (ps == PlayerState::Playing) { m_cur_player->pause(); }
@@ -455,9 +587,28 @@ void Rsked::resume_play()
 }
 
 
+/// Do fn to player p now, or if p is busy in its worker, queue fn there
+/// (named what) after the work in hand, without waiting for it.
+/// Returns true if fn was done now.
+///
+/// * May throw whatever fn throws
+///
+bool Rsked::use_player( const spPlayer &p, const char *what,
+                        std::function<void(Player&)> fn )
+{
+    if (Async_player::busy( p.get() )) {
+        LOG_DEBUG(Lgr) << p->name() << " is busy--queue " << what;
+        m_pmgr->async_player( p ).submit( what, std::move(fn),
+                                          std::chrono::seconds(m_start_secs) );
+        return false;
+    }
+    fn( *p );
+    return true;
+}
+
 /// Play the source on the player (which is typically the
-/// annunciator), waiting for completion up to n_secs seconds. The
-/// player is always stopped prior to return.
+/// annunciator), waiting for completion up to n_secs seconds, checking
+/// every 100 ms. The player is always stopped prior to return.
 ///
 /// * May throw a Player exception
 ///
@@ -467,11 +618,15 @@ void Rsked::time_limited_play( spPlayer player, spSource src, time_t n_secs )
         LOG_WARNING(Lgr) << "Time limited play--invalid argument";
         return;
     }
-    time_t start = time(0);
-    player->play( src );
+    time_t start = Clock::now();
+    async_play( player, src );
+    note_audio_start( src );
     do {
-        sleep(1);
-        if ((time(0) - start) > n_secs) {
+        Clock::rest({0,100'000'000});
+        if (m_service) { m_service(); }
+        if (Main::Terminate) { break; }
+        Child_mgr::refresh();
+        if ((Clock::now() - start) > n_secs) {
             LOG_WARNING(Lgr) << "Exceded time limit playing " << src->name();
             break;
         }
@@ -487,24 +642,22 @@ void Rsked::time_limited_play( spPlayer player, spSource src, time_t n_secs )
 ///
 void Rsked::play_greeting()
 {
-    time_t tnow = time(0);
-    struct tm *ptm = localtime(&tnow);
-    if (ptm) {
-        int h= ptm->tm_hour;
-        if (h < 12 and h > 5) {
-            LOG_DEBUG(Lgr) << "Play startup announcement for hour=" << h;
-            play_announcement("%goodam");
-        }
-        else if (h >= 12 and h < 18) {
-            LOG_DEBUG(Lgr) << "Play startup announcement for hour=" << h;
-            play_announcement("%goodaf");
-        }
-        else if (h >=18 and h < 22) {
-            LOG_DEBUG(Lgr) << "Play startup announcement for hour=" << h;
-            play_announcement("%goodev");
-        } else {
-            LOG_INFO(Lgr) << "Suppress startup announcement hour=" << h;
-        }
+    struct tm ltm;
+    Clock::local( ltm );
+    int h= ltm.tm_hour;
+    if (h < 12 and h > 5) {
+        LOG_DEBUG(Lgr) << "Play startup announcement for hour=" << h;
+        play_announcement("%goodam");
+    }
+    else if (h >= 12 and h < 18) {
+        LOG_DEBUG(Lgr) << "Play startup announcement for hour=" << h;
+        play_announcement("%goodaf");
+    }
+    else if (h >=18 and h < 22) {
+        LOG_DEBUG(Lgr) << "Play startup announcement for hour=" << h;
+        play_announcement("%goodev");
+    } else {
+        LOG_INFO(Lgr) << "Suppress startup announcement hour=" << h;
     }
 }
 
@@ -522,45 +675,204 @@ void Rsked::track_schedule()
 {
     update_status(RSK_PLAYING);
     play_greeting();
+    prepare_announcements();
     // m_sched->debug(true);  // debug the schedule
 
     // Run forever, tracking schedule.
     LOG_INFO(Lgr) << "Tracking schedule.";
 
+    if (m_reactor and not Clock::is_virtual()) {
+        try {
+            track_events();
+            return;
+        } catch (const Event_loop_exception&) {
+            LOG_ERROR(Lgr) << "Reactor unavailable--falling back to polling";
+        }
+    }
+    track_polling();
+}
+
+/// Track the schedule, waking every m_rest to do a step().  Signals
+/// (blocked by main for the reactor) are unblocked in this thread, so
+/// that its handler sees them and cuts the rest short.  During a
+/// crossfade it wakes every FadeStep to step the fade instead.
+///
+void Rsked::track_polling()
+{
+    Main::block_signals(false);
     for (;;) {
         if (Main::Terminate) { break; } // must exit rsked
-        if ( nanosleep( &m_rest, nullptr) ) {
+        if (m_fade.from) {
+            Clock::rest( FadeStep );
+            fade_step( 1 );
+            continue;
+        }
+        if (not Clock::rest( m_rest )) {
             LOG_INFO(Lgr) << "Sleep interrupted";
         }
         if (Main::Terminate) { break; } // must exit rsked
+        step();
+    }
+    finish_fade();
+}
 
-        m_pmgr->check_players();   // check all player processes
+/// Track the schedule, sleeping until something could require action:
+/// the next slot starts (or snooze ends), a signal arrives, a child
+/// process changes state, a player has news (e.g. its media failed),
+/// a local resource appears or vanishes, or it is time for a periodic
+/// health check.
+/// Each wakeup does one step(), except one that only steps a crossfade.
+///
+/// * May throw Event_loop_exception during setup
+///
+void Rsked::track_events()
+{
+    Event_loop loop {};
+    Signal_fd sigs { SIGTERM, SIGINT, SIGQUIT, SIGUSR1, SIGHUP };
+    Timer_fd slot_timer { CLOCK_REALTIME };
+    Timer_fd health_timer { CLOCK_MONOTONIC };
+    Timer_fd fade_timer { CLOCK_MONOTONIC };
+    unsigned fade_wakes {0};
 
-        if (Main::ReloadReq or not m_sched) {
-            reload_schedule();
-            continue;
-        }
-        if (Main::Button1) {
-            LOG_INFO(Lgr) << "Snooze button pressed.";
-            Main::Button1 = false;
-            toggle_snooze();    // might enter or exit snooze mode
+    loop.add( sigs.fd(), [&sigs](uint32_t) {
+            for (int s=sigs.next(); s; s=sigs.next()) {
+                Main::note_signal(s);
+            } } );
+    loop.add( slot_timer.fd(), [&slot_timer](uint32_t) {
+            slot_timer.consume(); } );
+    loop.add( health_timer.fd(), [&health_timer](uint32_t) {
+            health_timer.consume(); } );
+    loop.add( fade_timer.fd(), [this,&fade_timer,&fade_wakes](uint32_t) {
+            ++fade_wakes;
+            fade_step( static_cast<unsigned>( fade_timer.consume() ) ); } );
+    if (Child_mgr::event_fd() >= 0) {
+        loop.add( Child_mgr::event_fd(), [](uint32_t) {
+                Child_mgr::clear_events(); } );
+    }
+    if (Child_mgr::capture_fd() >= 0) {
+        loop.add( Child_mgr::capture_fd(), [](uint32_t) {
+                Child_mgr::drain_captures(); } );
+    }
+    if (m_pmgr->events_fd() >= 0) {
+        loop.add( m_pmgr->events_fd(), [this](uint32_t) {
+                m_pmgr->handle_events(); } );
+    }
+    if (m_sched and m_sched->resources_fd() >= 0) {   // kept across reloads
+        loop.add( m_sched->resources_fd(), [this](uint32_t) {
+                if (m_sched) { m_sched->refresh_resources(); } } );
+    }
+    if (m_sched and m_sched->mounts_fd() >= 0) {
+        loop.add( m_sched->mounts_fd(), [this](uint32_t) {
+                if (m_sched) { m_sched->refresh_resources(true); } },
+            EPOLLPRI );
+    }
+    m_service = [&loop] { loop.run_once(0); };   // while a player is busy
+    m_fade_ticks = [&fade_timer](bool on) {
+        if (on) {
+            fade_timer.arm_periodic( FadeStep );
+        } else {
+            fade_timer.disarm();
+        } };
+    health_timer.arm_periodic( static_cast<time_t>(m_health_secs) );
+    LOG_INFO(Lgr) << "Reactor mode, health checks every "
+                  << m_health_secs << " secs";
+    step();
+    for (;;) {
+        if (Main::Terminate) { break; } // must exit rsked
+        slot_timer.arm_at( next_wakeup() );
+        fade_wakes = 0;
+        unsigned nready = loop.run_once( -1 );
+        if (Main::Terminate) { break; } // must exit rsked
+        if (fade_wakes and (nready == fade_wakes)) {
+            continue;   // only the crossfade needed attention
         }
-        if (snoozep()) {        // true: we should be snoozing...
-            m_snoozing = true;
-            continue;
+        if (not step()) {
+            step();     // just reloaded: start the new schedule now
         }
-        if (m_snoozing) {       // but snoozep() is false: stop snoozing
-            exit_snooze();
-            play_announcement("%resume");
+    }
+    finish_fade();
+    m_service = nullptr;
+    m_fade_ticks = nullptr;
+}
+
+/// Return the wall clock time at which the schedule next needs
+/// attention: the start of the next slot, or the end of snooze if
+/// that comes sooner.  Falls back to a short rest on any problem.
+///
+/// * Will not throw
+///
+time_t Rsked::next_wakeup()
+{
+    time_t now = Clock::now();
+    time_t wake = now + m_rest.tv_sec;
+    try {
+        if (m_sched) {
+            struct tm ltm;
+            localtime_r( &now, &ltm );
+            wake = now + m_sched->secs_to_transition( &ltm );
         }
-        if (!m_sched) {         // need a schedule for the following
-            LOG_WARNING(Lgr) << "Schedule is missing!";
-            continue;
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Cannot find next transition: " << ex.what();
+    }
+    // wake early enough to prepare for that slot
+    if (m_lookahead_secs and m_prepared_for < wake) {
+        time_t early = wake - static_cast<time_t>(m_lookahead_secs);
+        if (early > now) {
+            wake = early;
         }
-        maybe_start_playing();
-        check_playback_level(); // may mark cur source as defective
-        Main::log_banner(false);
     }
+    if (m_snooze_until > now and m_snooze_until < wake) {
+        wake = m_snooze_until;
+    }
+    return wake;
+}
+
+/// One pass of schedule tracking: handle reload requests and the
+/// button, check the players (unless the button was just pressed),
+/// then start whatever the schedule wants now and check that it is
+/// audible.  Returns false if the pass ended early after reloading the
+/// schedule.  While the current player is busy (e.g. with a late
+/// health check) only the work that needs it waits for a later pass.
+///
+bool Rsked::step()
+{
+    if (Main::Terminate) {
+        return true;        // the caller will exit
+    }
+    Child_mgr::refresh();   // players will consult their children
+    if (Main::ReloadReq or not m_sched) {
+        reload_schedule();
+        return false;
+    }
+    if (Main::Button1) {    // a press is answered before health checks
+        LOG_INFO(Lgr) << "Snooze button pressed.";
+        Main::Button1 = false;
+        toggle_snooze();    // might enter or exit snooze mode
+    } else {
+        m_pmgr->check_players();   // check all player processes
+    }
+    if (snoozep()) {        // true: we should be snoozing...
+        m_snoozing = true;
+        return true;
+    }
+    if (m_snoozing) {       // but snoozep() is false: stop snoozing
+        exit_snooze();
+        play_announcement("%resume");
+    }
+    if (!m_sched) {         // need a schedule for the following
+        LOG_WARNING(Lgr) << "Schedule is missing!";
+        return true;
+    }
+    if (m_cur_player and Async_player::busy( m_cur_player.get() )) {
+        LOG_DEBUG(Lgr) << m_cur_player->name() << " is busy--check again later";
+        prepare_next();
+        return true;
+    }
+    maybe_start_playing();
+    prepare_next();
+    check_playback_level(); // may mark cur source as defective
+    Main::log_banner(false);
+    return true;
 }
 
 /// Pick a slot from the schedule and start the appropriate player,
@@ -598,6 +910,236 @@ void Rsked::maybe_start_playing()
     }
 }
 
+/// Is the finished, unsuccessful play op the fault of the player?  A
+/// timeout, or a failure to start the player (its process included)
+/// or to talk to it, counts against the player.  A cancellation does
+/// not, nor does a media failure, which is blamed on the Source (see
+/// maybe_start_playing), nor any other error.
+///
+/// * Will not throw
+///
+static bool blames_player( const Player_op &op )
+{
+    if (Op_status::timed_out == op.status()) {
+        return true;
+    }
+    if (Op_status::failed != op.status()) {
+        return false;
+    }
+    try {
+        op.rethrow();
+    } catch (const Player_startup_exception&) {
+        return true;
+    } catch (const Player_comm_exception&) {
+        return true;
+    } catch (const CM_exception&) {
+        return true;
+    } catch (...) {
+    }
+    return false;
+}
+
+/// Have player play src in its worker thread, handling events
+/// (signals, child exits) every 100 ms meanwhile.  Gives up after
+/// m_start_secs (twice that if the play must queue behind an earlier
+/// operation, such as preparing src), or at once if rsked must
+/// terminate; should the player still be busy with the abandoned
+/// play, a stop is queued after it.  On failure, rethrow what play()
+/// threw, or a Player_timeout_exception or Player_cancel_exception.
+/// The time taken and outcome of all but cancelled plays are reported
+/// to the player manager for ranking, except failures that are not the
+/// player's fault (see blames_player).
+///
+/// * May throw Player_exception or CM_exception
+///
+void Rsked::async_play( const spPlayer &player, const spSource &src )
+{
+    Async_player &ap = m_pmgr->async_player( player );
+    auto t0 = std::chrono::steady_clock::now();
+    unsigned waits { ap.busy() ? 2U : 1U };
+    spPlayer_op op = ap.play( src, std::chrono::seconds(waits*m_start_secs) );
+    while (not op->wait_for( std::chrono::milliseconds(100) )) {
+        if (m_service) { m_service(); }
+        if (Main::Terminate) {
+            op->cancel();
+        }
+    }
+    if ((Op_status::done == op->status()) or blames_player( *op )) {
+        m_pmgr->note_play( player, src,
+                           std::chrono::duration<double,std::milli>(
+                               std::chrono::steady_clock::now() - t0 ).count(),
+                           (Op_status::done == op->status()) );
+    }
+    if ((Op_status::timed_out == op->status()
+         or Op_status::cancelled == op->status()) and ap.busy()) {
+        ap.stop( std::chrono::seconds(m_start_secs) );
+    }
+    op->rethrow();
+}
+
+/// Set player p, unless it is busy, to pct percent of its configured
+/// volume.  Returns false if that cannot be done.
+///
+/// * Will not throw
+///
+static bool set_level( const spPlayer &p, unsigned pct )
+{
+    try {
+        return (not Async_player::busy( p.get() )) and p->set_volume( pct );
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Cannot set volume of " << p->name() << ": "
+                         << ex.what();
+        return false;
+    }
+}
+
+/// Hand over from player from, still playing, to player to, which has
+/// just started at zero volume.  Both can set their volume.  Over
+/// m_crossfade_secs the volumes are ramped a FadeStep at a time by
+/// fade_step, driven by the event loop (or the polling loop), so that
+/// signals and the button are not held up.  Prepared describes the
+/// source of to, for the boundary log.
+///
+/// * Will not throw
+///
+void Rsked::crossfade( const spPlayer &from, const spPlayer &to,
+                       const char *prepared )
+{
+    finish_fade();
+    m_fade.from = from;
+    m_fade.to = to;
+    m_fade.step = 0;
+    m_fade.steps = std::max( 1U, 4*m_crossfade_secs );
+    m_fade.began = std::chrono::steady_clock::now();
+    m_fade.prepared = prepared;
+    LOG_INFO(Lgr) << "Crossfade " << from->name() << " to "
+                  << to->name() << " over " << m_crossfade_secs << " secs";
+    try {
+        if (m_fade_ticks) { m_fade_ticks(true); }
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Crossfade failed: " << ex.what();
+        finish_fade();
+    }
+}
+
+/// Advance the crossfade under way by n steps, finishing it after the
+/// last.  A player that is busy (e.g. with a late health check) keeps
+/// its level until the next step.
+///
+/// * Will not throw
+///
+void Rsked::fade_step( unsigned n )
+{
+    if (not m_fade.from) {
+        return;
+    }
+    m_fade.step += n;
+    if (m_fade.step >= m_fade.steps) {
+        finish_fade();
+        return;
+    }
+    unsigned pct = (100*m_fade.step)/m_fade.steps;
+    try {
+        if (not Async_player::busy( m_fade.to.get() )) {
+            m_fade.to->set_volume( pct );
+        }
+        if (not Async_player::busy( m_fade.from.get() )) {
+            m_fade.from->set_volume( 100 - pct );
+        }
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Crossfade failed: " << ex.what();
+        finish_fade();
+    }
+}
+
+/// End any crossfade under way, at once: the new player is set to full
+/// volume and the old one stopped, on their workers.  The boundary
+/// overlap is logged once the old player has actually stopped.
+///
+/// * Will not throw
+///
+void Rsked::finish_fade()
+{
+    if (not m_fade.from) {
+        return;
+    }
+    Fade fade { std::move(m_fade) };
+    m_fade = Fade {};
+    try {
+        if (m_fade_ticks) { m_fade_ticks(false); }
+        auto timeout = std::chrono::seconds( m_start_secs );
+        m_pmgr->async_player( fade.to ).submit( "level", [](Player &p) {
+                p.set_volume(100); }, timeout );
+        LOG_INFO(Lgr) << "Stop player " << fade.from->name();
+        m_pmgr->async_player( fade.from ).submit( "stop", [fade](Player &p) {
+                p.stop();
+                using namespace std::chrono;
+                LOG_INFO(Lgr) << "Boundary overlap "
+                              << duration_cast<milliseconds>(
+                                  steady_clock::now()-fade.began).count()
+                              << " ms (" << fade.prepared << ")";
+                p.set_volume(100);
+            }, timeout );
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Failed to finish crossfade: " << ex.what();
+    }
+}
+
+/// If a slot starts within m_lookahead_secs, ask the player that will
+/// probably play it to prepare its source, so that little remains to
+/// be done at the boundary itself.  Each boundary is prepared once.
+/// Nothing is done if the current player is already playing the source.
+/// The work (which may block, e.g. on DNS) is queued on the player's
+/// worker and not awaited; a failure is only logged.
+///
+/// * Will not throw
+///
+void Rsked::prepare_next()
+{
+    time_t now = Clock::now();
+    if (0 == m_lookahead_secs or m_prepared_for > now) {
+        return;
+    }
+    try {
+        time_t start {0};
+        spSource src = m_sched->peek_next( now, m_lookahead_secs, start );
+        if (not src) {          // look again once the next slot is near
+            time_t early = start - static_cast<time_t>(m_lookahead_secs);
+            m_prepared_for = (early > now) ? early : start;
+            return;
+        }
+        m_prepared_for = start;
+        m_prepared_src.reset();
+        if (Medium::off == src->medium()
+            or (m_cur_player and not Async_player::busy( m_cur_player.get() )
+                and m_cur_player->currently_playing(src))) {
+            return;
+        }
+        spPlayer player = m_pmgr->get_player( src );
+        if (not player) {
+            return;
+        }
+        LOG_INFO(Lgr) << "Prepare " << player->name() << " for {"
+                      << src->name() << "} due in " << (start - now) << " secs";
+        m_pmgr->async_player( player ).submit( "prepare", [src](Player &p) {
+                using namespace std::chrono;
+                auto t0 = steady_clock::now();
+                try {
+                    p.prepare( src );
+                } catch (const std::exception &ex) {
+                    LOG_WARNING(Lgr) << p.name() << " failed to prepare {"
+                                     << src->name() << "}: " << ex.what();
+                    throw;
+                }
+                LOG_DEBUG(Lgr) << "Prepared in " << duration_cast<milliseconds>(
+                    steady_clock::now()-t0).count() << " ms";
+            }, std::chrono::seconds(m_start_secs) );
+        m_prepared_src = src;
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Failed to prepare next source: " << ex.what();
+    }
+}
+
 /// Attempt to play spslot, a non-announcement--will occupy m_cur_slot.
 /// If the current player is already playing the slot's Source, allow
 /// it to continue.
@@ -625,21 +1167,54 @@ void Rsked::play_current_slot(spPlay_slot spslot)
                 << "Source may be quiet for extended periods.";
         }
     }
-    // If the current player is not playing the chosen source, stop the
-    // current player and forget it.
-    if (m_cur_player) {
-        LOG_INFO(Lgr) << "Stop player " << m_cur_player->name();
-        m_cur_player->stop();
-        m_cur_player.reset();
-    }
-    // Ask the player mgr for the right player for the source.
+    // Ask the player mgr for the right player for the source.  If the
+    // current player is not playing the chosen source, stop it and
+    // forget it--but in overlap mode, only once the new player has
+    // started, and only if both players can set their volume.  Time
+    // the switch: from the old player stopping to the new one started
+    // is the gap in audio at the slot boundary.
+    finish_fade();
+    using namespace std::chrono;
+    spPlayer old_player { m_cur_player };
     m_cur_player = m_pmgr->get_player( cur_src );
+    bool overlap = (m_crossfade_secs and old_player and m_cur_player
+                    and (old_player != m_cur_player)
+                    and set_level( old_player, 100 )
+                    and set_level( m_cur_player, 0 ));
+    auto t_stopped = steady_clock::now();
+    if (old_player and not overlap) {
+        LOG_INFO(Lgr) << "Stop player " << old_player->name();
+        old_player->stop();
+        t_stopped = steady_clock::now();
+    }
     if (m_cur_player) {
         LOG_INFO(Lgr) << "Selected player " << m_cur_player->name();
-        m_cur_player->play( cur_src );
+        try {
+            async_play( m_cur_player, cur_src );
+        } catch (...) {
+            if (overlap) {
+                LOG_INFO(Lgr) << "Stop player " << old_player->name();
+                old_player->stop();
+                m_pmgr->async_player( m_cur_player ).submit( "level",
+                    [](Player &p) { p.set_volume(100); },
+                    std::chrono::seconds(m_start_secs) );
+            }
+            throw;
+        }
+        const char *prepared { (cur_src and cur_src == m_prepared_src)
+                               ? "prepared" : "unprepared" };
+        if (overlap) {
+            crossfade( old_player, m_cur_player, prepared );
+        } else if (old_player) {
+            LOG_INFO(Lgr) << "Boundary gap "
+                          << duration_cast<milliseconds>(steady_clock::now()
+                                                         -t_stopped).count()
+                          << " ms (" << prepared << ")";
+        }
+        note_audio_start( cur_src );
         update_status((Medium::off==cur_src->medium())
                       ? RSK_OFF : RSK_PLAYING);
-        m_check_enabled_time = (time(0) + m_vu_delay);
+        m_check_enabled_time = (Clock::now() + m_vu_delay);
         return;  // success
     } else {
         if (cur_src) {
@@ -19,6 +19,8 @@
 #include <sys/types.h>
 #include <sys/shm.h>
 
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <string.h>
 
@@ -52,6 +54,14 @@ enum {
 ///
 class Rsked {
 private:
+    struct Fade {                    // crossfade under way, see fade_step
+        spPlayer from {};            // old player, fading out
+        spPlayer to {};              // new player, fading in
+        unsigned step {0};
+        unsigned steps {0};
+        std::chrono::steady_clock::time_point began {};  // to started
+        const char *prepared {""};   // for the boundary log
+    };
     std::unique_ptr<Config> m_config; // current configuration object
     std::unique_ptr<Schedule> m_sched; // current schedule object
     std::unique_ptr<VU_runner> m_vu_runner;
@@ -62,6 +72,19 @@ private:
     int   m_shm_id {0};              // id of shared memory
     uint32_t  *m_shm_word {nullptr}; // address of shared memory word
     struct timespec m_rest = {2,0};  // {sec, nsec}
+    bool m_reactor {false};          // true: wake on events, not m_rest
+    unsigned m_health_secs {10};     // reactor: player check interval
+    bool m_sked_cache {true};        // use compiled schedule (.skedc)
+    std::chrono::steady_clock::time_point m_start_tp; // construction time
+    bool m_audio_started {false};    // time to audio has been logged
+    unsigned m_lookahead_secs {30};  // prepare sources this far ahead, 0=off
+    time_t m_prepared_for {0};       // boundary prepared, or time to look again
+    spSource m_prepared_src {};      // source prepared for that boundary
+    unsigned m_crossfade_secs {0};   // overlap old and new players, 0=off
+    unsigned m_start_secs {30};      // longest wait for a player to start
+    std::function<void()> m_service {}; // handle pending events, if set
+    std::function<void(bool)> m_fade_ticks {}; // reactor: tick fade or stop
+    Fade m_fade {};
     //
     spPlay_slot m_cur_slot {};       // current slot
     spPlayer m_cur_player {};        // current player
@@ -75,21 +98,35 @@ private:
     time_t m_vu_delay { 24 };        // max windup time for src to be audible
     std::string m_cfgversion {"?"};  // config file's version
     //
+    void async_play( const spPlayer&, const spSource& );
     bool check_playback_level();
+    void crossfade( const spPlayer&, const spPlayer&, const char* );
     void enter_snooze();
     void exit_snooze();
+    void fade_step( unsigned );
+    void finish_fade();
+    void load_schedule( Schedule& );
     void maybe_start_playing();
+    void note_audio_start( const spSource& );
+    time_t next_wakeup();
     void play_announcement( spPlay_slot );
     void play_announcement( const char* );
     void play_current_slot( spPlay_slot );
     void play_greeting();
+    void prepare_announcements();
+    void prepare_next();
     void reload_schedule();
     void resume_play();
     bool snoozep();
+    bool step();
     void suspend_play();
     void time_limited_play( spPlayer, spSource, time_t);
     void toggle_snooze();
+    void track_events();
+    void track_polling();
     void update_status(uint32_t);
+    bool use_player( const spPlayer&, const char*,
+                     std::function<void(Player&)> );
     //
 public:
     Rsked(key_t k, bool test);
@@ -22,12 +22,15 @@
 #include <fstream>
 #include <json/json.h>      /* apt install libjsoncpp-dev */
 #include <initializer_list>
+#include <algorithm>
 
 
 #include <time.h>
 
 #include "schedule.hpp"
 #include "configutil.hpp"
+#include "clock.hpp"
+#include "reswatch.hpp"
 
 
 /////////////////////////////////////////////////////////////////////////
@@ -154,11 +157,18 @@ void Play_slot::clear()
     m_complete = (-1);
 }
 
+/// Counts changes to the completion day of any Play_slot.
+///
+unsigned long Play_slot::c_complete_epoch {0};
+
 /// Mark the slot as played on the given day of year (0..365).
 ///
 void Play_slot::set_complete(int doy)
 {
-    m_complete = doy;
+    if (m_complete != doy) {
+        m_complete = doy;
+        ++c_complete_epoch;
+    }
 }
 
 /// Mark slot as played today (todays day of year).
@@ -166,9 +176,8 @@ void Play_slot::set_complete(int doy)
 void Play_slot::set_complete()
 {
     struct tm now_tm;
-    time_t now = time(nullptr);
-    localtime_r( &now, &now_tm );
-    m_complete = now_tm.tm_yday;
+    Clock::local( now_tm );
+    set_complete( now_tm.tm_yday );
     LOG_DEBUG(Lgr) << "Setting play slot " << m_name
                    << "(" <<  this << ")"
                    << " complete for day " << m_complete;
@@ -187,8 +196,7 @@ bool Play_slot::is_complete(int doy) const
 bool Play_slot::is_complete() const
 {
     struct tm now_tm;
-    time_t now = time(nullptr);
-    localtime_r( &now, &now_tm );
+    Clock::local( now_tm );
     return (m_complete == now_tm.tm_yday);
 }
 
@@ -200,7 +208,17 @@ bool Play_slot::is_complete() const
 ///
 void Play_slot::resolve_source( Schedule &schedule )
 {
-    m_source = schedule.find_viable_source( m_name );
+    m_source = schedule.find_viable_source( m_source_id );
+}
+
+/// Does slot o start at the same time and name the same source in the
+/// same role (program or announcement) as this slot?
+///
+bool Play_slot::same_as( const Play_slot &o ) const
+{
+    return (m_start_day_sec == o.m_start_day_sec)
+        and (m_announce == o.m_announce)
+        and (m_name == o.m_name);
 }
 
 /// One line description of a play_slot to the log.
@@ -222,12 +240,82 @@ void Play_slot::describe() const
 }
 
 
+//////////////////////////// Week_timeline //////////////////////////////
+
+/// Rebuild the index from the day programs. Slots within a day are
+/// already strictly increasing and days are visited in order, so the
+/// marks come out sorted without further work.
+///
+void Week_timeline::build( const std::array<Day_program,DaysPerWeek> &progs )
+{
+    m_marks.clear();
+    for (unsigned d=Sun; d<DaysPerWeek; d++) {
+        const auto &slots = progs[d].m_slots;
+        for (unsigned u=0; u < slots.size(); u++) {
+            m_marks.push_back(
+                Mark{ d*SecsPerDay + slots[u]->start_day_sec(), d, u } );
+        }
+    }
+    m_marks.shrink_to_fit();
+}
+
+/// Return the mark in effect at week second wsec: the last one starting
+/// at or before wsec.  If wsec precedes every mark (no Sunday program)
+/// the last mark of the week is still in effect.
+///
+/// * May throw: std::out_of_range if the timeline is empty
+///
+const Week_timeline::Mark& Week_timeline::at( unsigned wsec ) const
+{
+    if (m_marks.empty()) {
+        throw std::out_of_range("Week_timeline: empty");
+    }
+    auto it = std::upper_bound( m_marks.begin(), m_marks.end(), wsec,
+                                [](unsigned ws, const Mark &m) {
+                                    return ws < m.week_sec; } );
+    if (it == m_marks.begin()) {
+        return m_marks.back();
+    }
+    return *(--it);
+}
+
+/// Return the week second of the first slot start strictly after
+/// wsec. If that lies in the following week the result is offset by
+/// SecsPerWeek, so it always exceeds wsec. The timeline must not be
+/// empty.
+///
+unsigned Week_timeline::next_transition( unsigned wsec ) const
+{
+    auto it = std::upper_bound( m_marks.begin(), m_marks.end(), wsec,
+                                [](unsigned ws, const Mark &m) {
+                                    return ws < m.week_sec; } );
+    if (it == m_marks.end()) {
+        return m_marks.front().week_sec + SecsPerWeek;
+    }
+    return it->week_sec;
+}
+
+
 //////////////////////////// Schedule ///////////////////////////////////
 
+/// Seconds between checks of the resource watcher by play_now().
+///
+constexpr time_t ResCheckSecs { 10 };
+
 /// CTOR
 ///
 Schedule::Schedule()
-    : m_rps( std::make_shared<ResPathSpec>() )
+    : Schedule( nullptr )
+{
+}
+
+/// CTOR sharing the resource watcher rw, e.g. that of a schedule this
+/// one will replace, so that loading primes its warm cache instead of
+/// a new one (see carry_over).  A null rw gets a watcher of its own.
+///
+Schedule::Schedule( std::shared_ptr<Res_watcher> rw )
+    : m_rps( std::make_shared<ResPathSpec>() ),
+      m_watcher( rw ? std::move(rw) : std::make_shared<Res_watcher>() )
 {
     // initialize the Day_programs:
     for (unsigned d=Sun; d<DaysPerWeek; d++) {
@@ -258,7 +346,8 @@ void Schedule::load_rps(Json::Value &root)
 }
 
 
-/// Read the sources into m_sources map. Note that duplicate keys are
+/// Read the sources into m_sources, interning each name as a Source_id
+/// (OFF first, so it is OffSourceId). Note that duplicate keys are
 /// allowed in JSON, and cannot be trapped here, so be careful that a
 /// source is defined only once!  Do some basic checking of fields.
 ///
@@ -269,9 +358,10 @@ void Schedule::load_sources(Json::Value &root)
     const Json::Value jsrcs = root["sources"];
 
     // add an OFF source that implements off-mode
-    m_sources[OFF_SOURCE] = std::make_shared<Source>( OFF_SOURCE );
+    clear_sources();
+    add_source( std::make_shared<Source>( OFF_SOURCE ) );
     if (m_debug) {
-        m_sources[OFF_SOURCE]->describe();
+        m_sources[OffSourceId]->describe();
     }
 
     // For each key/val in sources, create a Source and add to map
@@ -289,22 +379,18 @@ void Schedule::load_sources(Json::Value &root)
         //     LOG_ERROR(Lgr) << "Schedule has duplicate source name " << name;
         //     throw Schedule_error();
         // }
-        m_sources[name] = std::make_shared<Source>(name);
-        m_sources[name]->load( jsrcs[name] );
+        auto sp = std::make_shared<Source>(name);
+        sp->load( jsrcs[name] );
+        add_source( sp );
         if (m_debug) {
-            m_sources[name]->describe();
+            sp->describe();
         }
     }
     // Check that the alternates defined by each source are actually
-    // defined in the source map.  Validate source pathnames.
+    // defined, and lead to OFF.  Validate source pathnames.
     //
-    for (auto&& [sname,sp] : m_sources) {
-        if (not has_source( sp->alternate()) ) {
-            LOG_ERROR(Lgr) << "Schedule: Alternate for source '" << sname
-                           << "', '" << sp->alternate() << "', "
-                              "has not been defined.";
-            throw Schedule_error();
-        }
+    link_sources();
+    for (const spSource &sp : m_sources) {
         sp->validate( *m_rps );  // may throw Schedule_error
     }
 }
@@ -401,11 +487,89 @@ void Schedule::load(const boost::filesystem::path &fname)
     load_rps(root);
     load_sources(root);
     load_dayprograms(root);
+    finish_load();
+}
+
+/// Final step of loading, from JSON or compiled form: index the slots
+/// and declare the schedule valid.
+///
+void Schedule::finish_load()
+{
+    m_timeline.build( m_programs );
+    // Look up (and so start watching) the local resources now, rather
+    // than on the first tick that needs them.
+    m_watcher->exists( m_rps->get_libpath() );
+    m_watcher->exists( m_rps->get_playlistpath() );
+    m_watcher->exists( m_rps->get_announcepath() );
+    for (const spSource &src : m_sources) {
+        if (src->localp() and not src->dynamic()) {
+            boost::filesystem::path p;
+            src->res_path( p, m_watcher.get() );
+        }
+    }
     LOG_INFO(Lgr) << "Valid schedule, version <" << m_version 
                   << "> loaded from " << m_fname;
     m_valid = true;
 }
 
+/// Carry state over from a previous schedule, old, that this one is
+/// replacing.  Each source equivalent to one in the old schedule is
+/// replaced by the old Source object itself, so its failure mark
+/// survives and players still recognize it as the source they are
+/// playing.  Each play slot that matches one in the old day program
+/// (same start, name and role) inherits its completion state, and the
+/// old resource watcher is kept.  A summary of the differences is
+/// logged.
+///
+/// * Will not throw
+///
+void Schedule::carry_over( const Schedule &old )
+{
+    unsigned kept=0, changed=0, added=0, removed=0;
+    for (spSource &sp : m_sources) {
+        Source_id oid;
+        if (not old.source_id( sp->name(), oid )) {
+            ++added;
+        } else if (old.m_sources[oid]->equivalent(*sp)) {
+            sp = old.m_sources[oid];
+            ++kept;
+        } else {
+            ++changed;
+            LOG_INFO(Lgr) << "Reload: source {" << sp->name() << "} changed";
+        }
+    }
+    for (const spSource &osp : old.m_sources) {
+        if (not has_source( osp->name() )) { ++removed; }
+    }
+    unsigned days_changed=0;
+    for (unsigned d=Sun; d<DaysPerWeek; d++) {
+        const auto &oslots = old.m_programs[d].m_slots;
+        auto &nslots = m_programs[d].m_slots;
+        bool same_day = (oslots.size() == nslots.size());
+        // both slot vectors are sorted by start time: merge
+        size_t i=0, j=0;
+        while (i < oslots.size() and j < nslots.size()) {
+            unsigned os = oslots[i]->start_day_sec();
+            unsigned ns = nslots[j]->start_day_sec();
+            if (os < ns) { ++i; same_day = false; continue; }
+            if (ns < os) { ++j; same_day = false; continue; }
+            if (nslots[j]->same_as(*oslots[i])) {
+                nslots[j]->set_complete( oslots[i]->get_complete() );
+            } else {
+                same_day = false;
+            }
+            ++i; ++j;
+        }
+        if (not same_day) {
+            ++days_changed;
+        }
+    }
+    LOG_INFO(Lgr) << "Reload: sources kept " << kept << ", changed "
+                  << changed << ", added " << added << ", removed "
+                  << removed << "; day programs changed " << days_changed;
+    m_watcher = old.m_watcher;  // keep its warm cache and descriptors
+}
+
 /// Access the schedule's ResPathSpec via shared ptr.
 /// Will be the default until m_rps is initialized by configuration.
 ///
@@ -417,9 +581,92 @@ Schedule::get_respathspec() const
 
 /// Is there a source of the given name?
 ///
-bool Schedule::has_source( const std::string &sn )
+bool Schedule::has_source( const std::string &sn ) const
 {
-    return (m_sources.count(sn) > 0);
+    return (m_source_ids.count(sn) > 0);
+}
+
+/// Set id to the Source_id of the source named sn. Return false if
+/// there is no such source.
+///
+bool Schedule::source_id( const std::string &sn, Source_id &id ) const
+{
+    auto it = m_source_ids.find( sn );
+    if (it == m_source_ids.end()) {
+        return false;
+    }
+    id = it->second;
+    return true;
+}
+
+/// Intern source sp under the next Source_id, which is returned. Its
+/// alternate is linked later by link_sources().
+///
+/// * May throw: Schedule_error if the name is already taken
+///
+Source_id Schedule::add_source( const spSource &sp )
+{
+    Source_id id = static_cast<Source_id>( m_sources.size() );
+    if (not m_source_ids.emplace( sp->name(), id ).second) {
+        LOG_ERROR(Lgr) << "Schedule has duplicate source name " << sp->name();
+        throw Schedule_error();
+    }
+    m_sources.push_back( sp );
+    m_alternates.push_back( OffSourceId );
+    return id;
+}
+
+/// Remove all sources.
+///
+void Schedule::clear_sources()
+{
+    m_sources.clear();
+    m_alternates.clear();
+    m_source_ids.clear();
+}
+
+/// Resolve the alternate of every source to its Source_id, and check
+/// that following alternates from any source always ends at OFF.  A
+/// chain that loops back on itself would leave no source of last
+/// resort, so it is rejected here, once, rather than cut short on
+/// every lookup.
+///
+/// * May throw: Schedule_error
+///
+void Schedule::link_sources()
+{
+    if (m_sources.empty() or m_sources[OffSourceId]->name() != OFF_SOURCE) {
+        LOG_ERROR(Lgr) << "Schedule: " << OFF_SOURCE << " source missing";
+        throw Schedule_error();
+    }
+    for (Source_id id=0; id < m_sources.size(); id++) {
+        const spSource &sp = m_sources[id];
+        if (not source_id( sp->alternate(), m_alternates[id] )) {
+            LOG_ERROR(Lgr) << "Schedule: Alternate for source '" << sp->name()
+                           << "', '" << sp->alternate() << "', "
+                              "has not been defined.";
+            throw Schedule_error();
+        }
+    }
+    m_alternates[OffSourceId] = OffSourceId;
+    // 0: unvisited, 1: on the chain being followed, 2: reaches OFF
+    std::vector<uint8_t> mark( m_sources.size(), 0 );
+    mark[OffSourceId] = 2;
+    for (Source_id start=0; start < m_sources.size(); start++) {
+        Source_id id = start;
+        while (0 == mark[id]) {
+            mark[id] = 1;
+            id = m_alternates[id];
+        }
+        if (1 == mark[id]) {
+            LOG_ERROR(Lgr) << "Schedule: alternates of source '"
+                           << m_sources[id]->name() << "' form a cycle";
+            throw Schedule_error();
+        }
+        for (id = start; 1 == mark[id]; id = m_alternates[id]) {
+            mark[id] = 2;
+        }
+    }
 }
 
 /// Create a play slot from a JSON value.
@@ -440,7 +687,7 @@ spPlay_slot Schedule::make_slot(unsigned ix, const Json::Value& slot,
                        << ps->start_day_sec() << " <= " << last_time;
         throw Schedule_error();
     }
-    if (!has_source(ps->name())) {
+    if (not source_id( ps->name(), ps->m_source_id )) {
         LOG_ERROR(Lgr) << "Unknown source: '" << ps->name();
         throw Schedule_error();
     }
@@ -453,17 +700,20 @@ spPlay_slot Schedule::make_slot(unsigned ix, const Json::Value& slot,
 
 /// Retrieve the (Source) program that should be played right now.
 /// If for some reason it cannot obtain the current time, a midnight
-/// start date/time will be used instead.
+/// start date/time will be used instead.  The choice is memoized: until
+/// the memo expires or is invalidated (see memo_valid) the same slot is
+/// returned without consulting the calendar, the sources or the disk.
 /// May throw std::invalid_argument (unlikely).
 ///
 spPlay_slot Schedule::play_now()
 {
+    time_t now = Clock::now();
+    if (memo_valid( now )) {
+        return m_memo.slot;
+    }
     struct tm ltm;
-    time_t now = time(0);
-    if (now == time_t(-1)) {    // unlikely
+    if ((now == time_t(-1)) or not localtime_r( &now, &ltm )) { // unlikely
         explicit_bzero(&ltm,sizeof(ltm));
-    } else {
-        localtime_r(&now,&ltm);
     }
     if (m_debug) {
         LOG_DEBUG(Lgr) << "localtime "
@@ -471,7 +721,90 @@ spPlay_slot Schedule::play_now()
                   << ":" << std::setfill('0') << std::setw(2) << ltm.tm_min
                   << ":" << std::setfill('0') << std::setw(2) << ltm.tm_sec;
     }
-    return play_daytime( &ltm );
+    spPlay_slot slot = play_daytime( &ltm );
+    memoize( slot, now, ltm );
+    return slot;
+}
+
+/// May the memoized play_now() result be returned at time now?  Only if
+/// now is within the memo's window and no source has been marked (or
+/// unmarked) failed, no slot marked complete, and no watched local
+/// resource appeared or vanished since it was made.  The resource
+/// watcher is consulted at most every ResCheckSecs.
+///
+bool Schedule::memo_valid( time_t now )
+{
+    if (not m_memo.slot
+        or (now < m_memo.from) or (now >= m_memo.until)
+        or (m_memo.fail_epoch != Source::fail_epoch())
+        or (m_memo.complete_epoch != Play_slot::complete_epoch())) {
+        return false;
+    }
+    if ((now - m_memo.res_checked) >= ResCheckSecs) {
+        m_memo.res_checked = now;
+        return (m_memo.res_changes == m_watcher->changes());
+    }
+    return true;
+}
+
+/// Remember slot as the choice at time now (local time ltm). It stays
+/// valid until the soonest of: the next slot start, the next top of
+/// the hour (so a daylight saving shift is noticed), or the time that
+/// a failed source becomes eligible for retry.
+///
+void Schedule::memoize( const spPlay_slot &slot, time_t now,
+                        const struct tm &ltm )
+{
+    ++m_resolutions;
+    time_t until = now + 3600 - (60*ltm.tm_min + ltm.tm_sec);
+    try {
+        until = std::min( until, now + secs_to_transition( &ltm ) );
+    } catch (const std::exception&) {
+        until = now + 1;
+    }
+    for (const spSource &src : m_sources) {
+        if (src->failedp()) {
+            until = std::min( until, src->retry_time() + 1 );
+        }
+    }
+    m_memo.slot = slot;
+    m_memo.from = now;
+    m_memo.until = std::max( until, now + 1 );
+    m_memo.fail_epoch = Source::fail_epoch();
+    m_memo.complete_epoch = Play_slot::complete_epoch();
+    m_memo.res_changes = m_watcher->changes();
+    m_memo.res_checked = now;
+}
+
+/// Descriptor that becomes readable when a watched local resource may
+/// have changed (call refresh_resources), or -1 if there is none.
+///
+int Schedule::resources_fd() const
+{
+    return m_watcher->fd();
+}
+
+/// Descriptor that signals (EPOLLPRI) a mount or unmount, after which
+/// call refresh_resources(true); or -1 if there is none.
+///
+int Schedule::mounts_fd() const
+{
+    return m_watcher->mounts_fd();
+}
+
+/// Take note of any changes to local resources; the next play_now()
+/// will then resolve sources again if necessary.  Pass mounts true
+/// when mounts_fd() has signalled: polling it consumes the signal, so
+/// the watcher would not see it again.
+/// * Will NOT throw
+///
+void Schedule::refresh_resources( bool mounts )
+{
+    if (mounts) {
+        m_watcher->mounts_changed();
+    }
+    m_watcher->drain();
+    m_memo.res_checked = 0;     // check the memo against it right away
 }
 
 /// Convert a struct tm to seconds within a day. Additionally, it will
@@ -528,44 +861,35 @@ spPlay_slot Schedule::play_daytime( const struct tm *loc_tm )
     int yday  { loc_tm->tm_yday };
     std::vector<spPlay_slot> &the_pslots = m_programs[wd].m_slots;
 
-    // Scan the slots until we get to a start time past the current
-    // time.  The current slot will be the previous one in the list.
-    // However, announcements are handled specially: If the indicated
-    // slot for a time is an *announcement* and that slot is marked as
-    // *completed* for today, then the nearest slot before it that is
-    // not a completed announcement is selected.
+    // The timeline yields the slot whose start time most recently
+    // passed. Since every day program begins at 00:00, that slot is
+    // always in today's program.  However, announcements are handled
+    // specially: If the indicated slot for a time is an *announcement*
+    // and that slot is marked as *completed* for today, then the
+    // nearest slot before it that is not an announcement is selected.
 
     auto nps = the_pslots.size();
-    if (0==nps) {
+    if (0==nps or m_timeline.empty()) {
         LOG_ERROR(Lgr) << "No play slots available today!";
         throw Schedule_error();
     }
-    auto u = 0U;          // the index of the to-be-selected play slot
-    if (nps > 1) {        // (if there is just one slot, use it regardless)
-        while (u < nps) { // otherwise search forward from slot 0
-            if (sec_of_day < the_pslots[u]->start_day_sec()) {
-                if (u > 0) { 
-                    --u;
-                } else {
-                    LOG_ERROR(Lgr) << "play_daytime: no playable slots";
-                    throw Schedule_error();
-                }
-                if ( the_pslots[u]->is_compann(yday) ) {
-                    // Back up to the last non-announcement, marking as
-                    // complete any earlier announcements
-                    while( the_pslots[--u]->is_announcement() ) {
-                        the_pslots[u]->set_complete(yday);
-                    }
-                }
-                break;
-            }
-            u++;
-        }
+    const Week_timeline::Mark &mark
+        = m_timeline.at( static_cast<unsigned>(wd)*SecsPerDay + sec_of_day );
+    if (mark.day != wd or mark.slot >= nps) {
+        LOG_ERROR(Lgr) << "play_daytime: no playable slots";
+        throw Schedule_error();
+    }
+    auto u = mark.slot;   // the index of the to-be-selected play slot
+    if (u+1 == nps) {
         // Past the last slot. Backup, marking all announcements.
-        if (u >= nps) {
-            while( u and the_pslots[--u]->is_announcement() ) {
-                the_pslots[u]->set_complete(yday);
-            }
+        while( the_pslots[u]->is_announcement() ) {
+            the_pslots[u--]->set_complete(yday);
+        }
+    } else if ( the_pslots[u]->is_compann(yday) ) {
+        // Back up to the last non-announcement, marking as
+        // complete any earlier announcements
+        while( the_pslots[--u]->is_announcement() ) {
+            the_pslots[u]->set_complete(yday);
         }
     }
     LOG_DEBUG(Lgr) << "Selected slot " << u << ", " << the_pslots[u]->name()
@@ -578,6 +902,65 @@ spPlay_slot Schedule::play_daytime( const struct tm *loc_tm )
 }
 
 
+/// Return the number of seconds from the given local time until the
+/// start of the next play slot, wrapping around the end of the week.
+/// Result is always at least 1.
+///
+/// * May throw: std::invalid_argument, Schedule_error
+///
+unsigned Schedule::secs_to_transition( const struct tm *loc_tm ) const
+{
+    unsigned wsec = static_cast<unsigned>(loc_tm->tm_wday)*SecsPerDay
+        + tm_to_day_sec(loc_tm);
+    if (m_timeline.empty()) {
+        LOG_ERROR(Lgr) << "secs_to_transition: empty schedule";
+        throw Schedule_error();
+    }
+    return m_timeline.next_transition(wsec) - wsec;
+}
+
+
+/// Look ahead from time now: set start to the start time of the next
+/// slot, and if it is a program (not announcement) slot starting
+/// within horizon seconds, return the source it would most likely
+/// play. Otherwise return null.  Unlike play_now() this changes nothing: no failure
+/// marks are cleared, no announcements marked complete, no memo made.
+/// A failed source counts as viable if it will be due for retry by
+/// start.
+///
+/// * May throw: std::invalid_argument, Schedule_error
+///
+spSource Schedule::peek_next( time_t now, unsigned horizon, time_t &start )
+{
+    struct tm ltm;
+    if (not localtime_r( &now, &ltm )) {
+        return nullptr;
+    }
+    unsigned secs = secs_to_transition( &ltm );
+    start = now + secs;
+    if (secs > horizon) {
+        return nullptr;
+    }
+    unsigned wsec = (static_cast<unsigned>(ltm.tm_wday)*SecsPerDay
+                     + tm_to_day_sec( &ltm ) + secs) % SecsPerWeek;
+    const Week_timeline::Mark &mark = m_timeline.at( wsec );
+    const spPlay_slot &slot = m_programs.at(mark.day).m_slots.at(mark.slot);
+    if (slot->is_announcement()) {
+        return nullptr;
+    }
+    Source_id id = slot->source_id();
+    while (id != OffSourceId) {
+        const spSource &src = m_sources[id];
+        boost::filesystem::path eff_path;
+        if ((not src->failedp() or src->retry_time() < start)
+            and (not src->localp() or src->res_path( eff_path, m_watcher.get() ))) {
+            return src;
+        }
+        id = m_alternates[id];
+    }
+    return m_sources.at( OffSourceId );
+}
+
 
 /// Return a shared pointer to the source given its name; if that
 /// source is marked as failed, return its alternate; if the alternate
@@ -589,24 +972,29 @@ spPlay_slot Schedule::play_daytime( const struct tm *loc_tm )
 spSource
 Schedule::find_viable_source( const std::string& sn )
 {
-    unsigned maxit=4;   // avoid circular reference chains.
-    spSource src = m_sources[ sn ];
-    if (nullptr==src) {
+    Source_id id;
+    if (not source_id( sn, id )) {
         LOG_ERROR(Lgr) << "Missing source: '" << sn <<"'";
-        return m_sources[OFF_SOURCE];
-    }
-    bool viablep;
-    while (src and maxit) {
-        viablep = src->viable();
-        if (viablep) break;
-        src = m_sources[ src->alternate() ];
-        --maxit;
+        return m_sources.at( OffSourceId );
     }
-    if (src and viablep and maxit) {
-        return src;
+    return find_viable_source( id );
+}
+
+/// As above, given the Source_id.  Alternate chains were checked at
+/// load time to end at OFF, so the walk always terminates.
+///
+spSource
+Schedule::find_viable_source( Source_id id )
+{
+    while (id != OffSourceId) {
+        const spSource &src = m_sources[id];
+        if (src->viable( m_watcher.get() )) {
+            return src;
+        }
+        id = m_alternates[id];
     }
     LOG_ERROR(Lgr) << "Schedule: Fallback to OFF mode";
-    return m_sources[OFF_SOURCE];
+    return m_sources[OffSourceId];
 }
 
 ///////////////////////////////////////////////////////////////////////
@@ -19,6 +19,7 @@
 #include <time.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <array>
 #include <stdexcept>
 #include <iomanip>
@@ -33,23 +34,35 @@ enum Day { Sun=0, Mon, Tue, Wed, Thu, Fri, Sat, DaysPerWeek };
 extern const char* DayNames[];
 unsigned daynameToIndex( const std::string& );
 
+/// Seconds in a day and in a week
+constexpr unsigned SecsPerDay { 24*60*60 };
+constexpr unsigned SecsPerWeek { DaysPerWeek*SecsPerDay };
+
 class Schedule;
 
+/// Dense index of a Source within one Schedule, assigned at load.
+using Source_id = unsigned;
+constexpr Source_id OffSourceId { 0 };   // OFF is always interned first
+
 /**
  * Indicates the source starting at a particular time of day
  * expressed as a non-negative offset in seconds from midnight.
  */
 class Play_slot {
+    friend class Schedule;      // restores slots from a .skedc
 private:
     unsigned m_start_day_sec {0}; // seconds from 00:00
     std::string m_name {"OFF"};   // name of the primary source
+    Source_id m_source_id {OffSourceId}; // its id in the owning Schedule
     spSource m_source {};         // shared pointer to actual source
     bool m_announce { false };    // if true, this is an announcement
     int m_complete { -1 };        // played completed this day of year
     bool m_valid { true };
+    static unsigned long c_complete_epoch; // bumped when any m_complete changes
 public:
     //
     void clear();
+    static unsigned long complete_epoch() { return c_complete_epoch; }
     void describe() const;
     int get_complete() const { return m_complete; }
     bool is_announcement() const { return m_announce; }
@@ -58,9 +71,11 @@ public:
     bool is_compann(int y) const {
         return is_announcement() and is_complete(y); }
     void resolve_source( Schedule &);
+    bool same_as( const Play_slot& ) const;
     void set_complete(int);
     void set_complete();  // today
     spSource source() const { return m_source; }
+    Source_id source_id() const { return m_source_id; }
     const std::string& name() const { return m_name; }
     unsigned start_day_sec() const { return m_start_day_sec; }
     bool valid() const { return m_valid; }
@@ -82,39 +97,114 @@ struct Day_program {
 };
 
 
+/**
+ * Flat index of every play slot start in the week, sorted by
+ * week-second (seconds since Sunday 00:00). It is built once when a
+ * schedule is loaded and never modified afterwards, so the slot in
+ * effect at any moment and the next transition are found by binary
+ * search rather than by scanning a day program.
+ */
+class Week_timeline {
+public:
+    struct Mark {
+        unsigned week_sec;  // start, seconds since Sunday 00:00
+        unsigned day;       // day index per tm_wday
+        unsigned slot;      // index into that day's m_slots
+    };
+private:
+    std::vector<Mark> m_marks {};
+public:
+    const Mark& at( unsigned ) const;
+    void build( const std::array<Day_program,DaysPerWeek>& );
+    void clear() { m_marks.clear(); }
+    bool empty() const { return m_marks.empty(); }
+    unsigned next_transition( unsigned ) const;
+    std::size_t size() const { return m_marks.size(); }
+};
+
+
+/**
+ * The slot (with its resolved source) that play_now() last chose, and
+ * the conditions under which that choice remains correct: the time
+ * has not left [from,until), and no source failure mark, slot
+ * completion or local resource has changed since.
+ */
+struct Slot_memo {
+    spPlay_slot slot {};
+    time_t from {0};
+    time_t until {0};
+    unsigned long fail_epoch {0};
+    unsigned long complete_epoch {0};
+    unsigned long res_changes {0};
+    time_t res_checked {0};
+};
+
+
 /**
  * Map from time to item to play. This object reflects the structure of
  * the json schedule file.
- *  m_programs:  day_index_int -> Day_program
- *  m_sources:   source name -> spSource
+ *  m_programs:   day_index_int -> Day_program
+ *  m_sources:    Source_id -> spSource
+ *  m_alternates: Source_id -> Source_id of its alternate
+ *  m_source_ids: source name -> Source_id
  */
 class Schedule {
 private:
     bool m_valid {false};
     bool m_debug {false};
     std::string m_version {};
-    std::array<Day_program,7> m_programs {};
-    std::map<std::string,spSource> m_sources {};
+    std::array<Day_program,DaysPerWeek> m_programs {};
+    Week_timeline m_timeline {};
+    Slot_memo m_memo {};
+    unsigned long m_resolutions {0};
+    std::vector<spSource> m_sources {};
+    std::vector<Source_id> m_alternates {};
+    std::unordered_map<std::string,Source_id> m_source_ids {};
     boost::filesystem::path m_fname {};
     std::shared_ptr<ResPathSpec> m_rps;
+    std::shared_ptr<Res_watcher> m_watcher; // local resource existence
     //
-    bool has_source( const std::string& );
+    Source_id add_source( const spSource& );
+    void clear_sources();
+    bool has_source( const std::string& ) const;
+    void link_sources();
     void load_a_dayprogram( const std::string &, const Json::Value &);
     void load_dayprograms(Json::Value&);
     void load_rps(Json::Value&);
     void load_sources(Json::Value&);
+    void finish_load();
     spPlay_slot make_slot( unsigned, const Json::Value&, unsigned);
+    bool memo_valid( time_t );
+    void memoize( const spPlay_slot&, time_t, const struct tm& );
     unsigned tm_to_day_sec( const struct tm* ) const;
 
 public:
+    void carry_over( const Schedule& );
     void debug(bool p) { m_debug = p; }
+    const Day_program& day_program( unsigned d ) const { return m_programs.at(d); }
     spSource find_viable_source( const std::string& );
+    spSource find_viable_source( Source_id );
     std::shared_ptr<ResPathSpec> get_respathspec() const;
     void load( const boost::filesystem::path& );
+    bool load_compiled( const boost::filesystem::path&,
+                        const boost::filesystem::path& );
+    void save_compiled( const boost::filesystem::path&,
+                        const boost::filesystem::path& ) const;
+    static boost::filesystem::path compiled_path( const boost::filesystem::path& );
     spPlay_slot play_daytime(const struct tm*);
     spPlay_slot play_now();
+    int mounts_fd() const;
+    unsigned long resolutions() const { return m_resolutions; }
+    void refresh_resources( bool mounts=false );
+    spSource peek_next( time_t, unsigned, time_t& );
+    int resources_fd() const;
+    std::shared_ptr<Res_watcher> resource_watcher() const { return m_watcher; }
+    unsigned secs_to_transition( const struct tm* ) const;
+    bool source_id( const std::string&, Source_id& ) const;
+    const Week_timeline& timeline() const { return m_timeline; }
     bool valid() const { return m_valid; }
     //
     Schedule();
+    explicit Schedule( std::shared_ptr<Res_watcher> );
 };
 
@@ -224,6 +224,7 @@ void Sdr_player::initialize( Config& cfg, bool /* testp */ )
     boost::filesystem::path binpath { Gqrx_bin_path };
     cfg.get_pathname(myname,"bin_path", FileCond::MustExist, binpath);
     m_cm->set_binary( binpath );
+    configure_child( cfg, myname, *m_cm );
     //
     // Note: the working config file will be created by copying the gold file
     //  each time gqrx is started. This gets around the policy of gqrx to
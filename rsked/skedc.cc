@@ -0,0 +1,405 @@
+/**
+ * Compiled schedules: a binary image (.skedc) of a loaded and validated
+ * Schedule, written next to the JSON schedule. At startup it is mapped
+ * and restored directly, skipping JSON parsing and resource validation,
+ * as long as it still matches the JSON file's mtime, size and hash.
+ */
+
+/*   Part of the rsked package.
+ *   Copyright 2020 Steven A. Harp   farlies(at)gmail.com
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "schedule.hpp"
+
+
+namespace {
+
+/// File layout: header, source records, slot records, string pool.
+/// All records are fixed size, 8-byte aligned, in host byte order;
+/// the file is only meaningful on the machine that wrote it.  Source
+/// records are in Source_id order (version 2), starting with OFF.
+///
+constexpr char SkedcMagic[8] { 'R','S','K','E','D','C','\n','\0' };
+constexpr uint32_t SkedcVersion { 2 };
+
+struct Str_ref {
+    uint32_t off;               // offset in string pool
+    uint32_t len;               // bytes
+};
+
+struct Skedc_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;       // sizeof(Skedc_header)
+    int64_t  json_mtime;        // st_mtime of the JSON schedule
+    uint64_t json_size;         // st_size of the JSON schedule
+    uint64_t json_hash;         // FNV-1a of the JSON schedule bytes
+    Str_ref  sched_version;
+    Str_ref  lib_path;
+    Str_ref  ann_path;
+    Str_ref  pl_path;
+    uint32_t n_sources;
+    uint32_t n_slots;
+    uint64_t sources_off;
+    uint64_t slots_off;
+    uint64_t strings_off;
+    uint64_t strings_len;
+};
+
+enum : uint8_t { SF_Announce=1, SF_Quiet=2, SF_Repeat=4, SF_Dynamic=8 };
+
+struct Skedc_source {
+    Str_ref  name;
+    Str_ref  alternate;
+    Str_ref  resource;
+    Str_ref  res_path;
+    Str_ref  text;
+    double   duration;
+    uint64_t freq_hz;
+    uint8_t  medium;
+    uint8_t  encoding;
+    uint8_t  flags;             // SF_*
+    uint8_t  pad[5];
+};
+
+struct Skedc_slot {
+    Str_ref  name;
+    uint32_t start_day_sec;
+    uint8_t  day;
+    uint8_t  announce;
+    uint8_t  pad[2];
+};
+
+/// 64 bit FNV-1a hash of a byte string
+///
+uint64_t fnv1a( const std::string &bytes )
+{
+    uint64_t h { 14695981039346656037ULL };
+    for (unsigned char c : bytes) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/// Read the whole file at p into bytes. Return false on failure.
+///
+bool slurp( const boost::filesystem::path &p, std::string &bytes )
+{
+    std::ifstream in( p.c_str(), std::ios::binary );
+    if (not in) return false;
+    bytes.assign( std::istreambuf_iterator<char>(in),
+                  std::istreambuf_iterator<char>() );
+    return not in.bad();
+}
+
+/// Accumulates the string pool while writing.
+///
+class String_pool {
+    std::string m_bytes {};
+public:
+    Str_ref add( const std::string &s ) {
+        Str_ref r { static_cast<uint32_t>(m_bytes.size()),
+                    static_cast<uint32_t>(s.size()) };
+        m_bytes += s;
+        return r;
+    }
+    const std::string& bytes() const { return m_bytes; }
+};
+
+/// A read-only private mapping of a whole file.
+///
+class Mapped_file {
+    void *m_addr { MAP_FAILED };
+    size_t m_size { 0 };
+public:
+    explicit Mapped_file( const boost::filesystem::path &p ) {
+        int fd = open( p.c_str(), O_RDONLY|O_CLOEXEC );
+        if (fd < 0) return;
+        struct stat st;
+        if (0 == fstat(fd, &st) and st.st_size > 0) {
+            m_size = static_cast<size_t>(st.st_size);
+            m_addr = mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        }
+        close(fd);
+    }
+    ~Mapped_file() {
+        if (m_addr != MAP_FAILED) { munmap( m_addr, m_size ); }
+    }
+    Mapped_file(const Mapped_file&) = delete;
+    void operator=(const Mapped_file&) = delete;
+    const char* data() const {
+        return (m_addr == MAP_FAILED) ? nullptr
+                                      : static_cast<const char*>(m_addr); }
+    size_t size() const { return m_size; }
+};
+
+} // namespace
+
+
+/// Return the compiled schedule path for a JSON schedule path,
+/// e.g. schedule.json => schedule.skedc
+///
+boost::filesystem::path
+Schedule::compiled_path( const boost::filesystem::path &json )
+{
+    boost::filesystem::path p { json };
+    return p.replace_extension(".skedc");
+}
+
+/// Write this (valid) schedule, loaded from json, in compiled form to
+/// file skedc.  The file is written under a temporary name and renamed
+/// into place, so readers never see a partial file.
+///
+/// * Will not throw
+///
+void Schedule::save_compiled( const boost::filesystem::path &json,
+                              const boost::filesystem::path &skedc ) const
+{
+    if (not m_valid) return;
+    try {
+        struct stat jst;
+        std::string jbytes;
+        if (stat(json.c_str(), &jst) or not slurp(json, jbytes)) {
+            LOG_WARNING(Lgr) << "Cannot compile schedule: " << json
+                             << " unreadable";
+            return;
+        }
+        String_pool pool {};
+        std::vector<Skedc_source> srcs {};
+        for (const spSource &sp : m_sources) {     // in Source_id order
+            const Source &src { *sp };
+            Skedc_source rec {};
+            rec.name = pool.add( src.m_name );
+            rec.alternate = pool.add( src.m_alternate );
+            rec.resource = pool.add( src.m_resource );
+            rec.res_path = pool.add( src.m_res_path.string() );
+            rec.text = pool.add( src.m_text );
+            rec.duration = src.m_duration;
+            rec.freq_hz = src.m_freq_hz;
+            rec.medium = static_cast<uint8_t>(src.m_medium);
+            rec.encoding = static_cast<uint8_t>(src.m_encoding);
+            rec.flags = static_cast<uint8_t>(
+                (src.m_announcementp ? SF_Announce : 0)
+                | (src.m_quiet_okay ? SF_Quiet : 0)
+                | (src.m_repeatp ? SF_Repeat : 0)
+                | (src.m_dynamic ? SF_Dynamic : 0) );
+            srcs.push_back( rec );
+        }
+        std::vector<Skedc_slot> slots {};
+        for (unsigned d=Sun; d<DaysPerWeek; d++) {
+            for (const spPlay_slot &ps : m_programs[d].m_slots) {
+                Skedc_slot rec {};
+                rec.name = pool.add( ps->m_name );
+                rec.start_day_sec = ps->m_start_day_sec;
+                rec.day = static_cast<uint8_t>(d);
+                rec.announce = (ps->m_announce ? 1 : 0);
+                slots.push_back( rec );
+            }
+        }
+        Skedc_header hdr {};
+        memcpy( hdr.magic, SkedcMagic, sizeof(hdr.magic) );
+        hdr.version = SkedcVersion;
+        hdr.header_size = sizeof(Skedc_header);
+        hdr.json_mtime = static_cast<int64_t>(jst.st_mtime);
+        hdr.json_size = static_cast<uint64_t>(jst.st_size);
+        hdr.json_hash = fnv1a( jbytes );
+        hdr.sched_version = pool.add( m_version );
+        hdr.lib_path = pool.add( m_rps->m_library_path.string() );
+        hdr.ann_path = pool.add( m_rps->m_announcement_path.string() );
+        hdr.pl_path = pool.add( m_rps->m_playlist_path.string() );
+        hdr.n_sources = static_cast<uint32_t>(srcs.size());
+        hdr.n_slots = static_cast<uint32_t>(slots.size());
+        hdr.sources_off = sizeof(Skedc_header);
+        hdr.slots_off = hdr.sources_off + srcs.size()*sizeof(Skedc_source);
+        hdr.strings_off = hdr.slots_off + slots.size()*sizeof(Skedc_slot);
+        hdr.strings_len = pool.bytes().size();
+
+        boost::filesystem::path tmp { skedc };
+        tmp += ".tmp";
+        {
+            std::ofstream out( tmp.c_str(), std::ios::binary|std::ios::trunc );
+            out.write( reinterpret_cast<const char*>(&hdr), sizeof(hdr) );
+            out.write( reinterpret_cast<const char*>(srcs.data()),
+                       static_cast<std::streamsize>(srcs.size()*sizeof(Skedc_source)) );
+            out.write( reinterpret_cast<const char*>(slots.data()),
+                       static_cast<std::streamsize>(slots.size()*sizeof(Skedc_slot)) );
+            out.write( pool.bytes().data(),
+                       static_cast<std::streamsize>(pool.bytes().size()) );
+            if (not out) {
+                LOG_WARNING(Lgr) << "Cannot write compiled schedule " << tmp;
+                boost::filesystem::remove( tmp );
+                return;
+            }
+        }
+        boost::filesystem::rename( tmp, skedc );
+        LOG_INFO(Lgr) << "Wrote compiled schedule " << skedc;
+    } catch (const std::exception &ex) {
+        LOG_WARNING(Lgr) << "Cannot write compiled schedule " << skedc
+                         << ": " << ex.what();
+    }
+}
+
+/// Attempt to restore the schedule from compiled file skedc, which must
+/// have been made from the current contents of JSON file json (same
+/// mtime, size and hash).  Return true if the schedule was restored
+/// and is valid. Return false if the compiled file is missing, stale
+/// or damaged; the schedule is then empty and load() should be used.
+///
+/// * Will not throw
+///
+bool Schedule::load_compiled( const boost::filesystem::path &json,
+                              const boost::filesystem::path &skedc )
+{
+    m_valid = false;
+    struct stat jst;
+    if (stat(json.c_str(), &jst)) {
+        return false;
+    }
+    Mapped_file mf { skedc };
+    const char *base = mf.data();
+    if (not base) {
+        LOG_INFO(Lgr) << "No compiled schedule " << skedc;
+        return false;
+    }
+    Skedc_header hdr {};
+    if (mf.size() < sizeof(hdr)) {
+        LOG_WARNING(Lgr) << "Compiled schedule " << skedc << " is truncated";
+        return false;
+    }
+    memcpy( &hdr, base, sizeof(hdr) );
+    if (memcmp(hdr.magic, SkedcMagic, sizeof(hdr.magic))
+        or hdr.version != SkedcVersion
+        or hdr.header_size != sizeof(Skedc_header)) {
+        LOG_WARNING(Lgr) << "Compiled schedule " << skedc
+                         << " has the wrong format";
+        return false;
+    }
+    if (hdr.json_mtime != static_cast<int64_t>(jst.st_mtime)
+        or hdr.json_size != static_cast<uint64_t>(jst.st_size)) {
+        LOG_INFO(Lgr) << "Compiled schedule " << skedc << " is stale";
+        return false;
+    }
+    std::string jbytes;
+    if (not slurp(json, jbytes) or fnv1a(jbytes) != hdr.json_hash) {
+        LOG_INFO(Lgr) << "Compiled schedule " << skedc << " is stale";
+        return false;
+    }
+    const uint64_t fsize = mf.size();
+    if (hdr.sources_off > fsize
+        or hdr.n_sources > (fsize - hdr.sources_off)/sizeof(Skedc_source)
+        or hdr.slots_off > fsize
+        or hdr.n_slots > (fsize - hdr.slots_off)/sizeof(Skedc_slot)
+        or hdr.strings_off > fsize
+        or hdr.strings_len > fsize - hdr.strings_off) {
+        LOG_WARNING(Lgr) << "Compiled schedule " << skedc << " is damaged";
+        return false;
+    }
+    const char *pool = base + hdr.strings_off;
+    bool ok = true;
+    auto str = [&](const Str_ref &r) -> std::string {
+        if (r.off > hdr.strings_len or r.len > hdr.strings_len - r.off) {
+            ok = false;
+            return std::string();
+        }
+        return std::string( pool + r.off, r.len );
+    };
+
+    clear_sources();
+    for (auto &dp : m_programs) {
+        dp.m_slots.clear();
+    }
+    m_version = str( hdr.sched_version );
+    m_rps->m_library_path = str( hdr.lib_path );
+    m_rps->m_announcement_path = str( hdr.ann_path );
+    m_rps->m_playlist_path = str( hdr.pl_path );
+
+    for (uint32_t i=0; ok and i < hdr.n_sources; i++) {
+        Skedc_source rec;
+        memcpy( &rec, base + hdr.sources_off + i*sizeof(rec), sizeof(rec) );
+        if (rec.medium > static_cast<uint8_t>(Medium::playlist)
+            or rec.encoding > static_cast<uint8_t>(Encoding::mixed)) {
+            ok = false;
+            break;
+        }
+        auto sp = std::make_shared<Source>( str(rec.name) );
+        sp->m_alternate = str( rec.alternate );
+        sp->m_resource = str( rec.resource );
+        sp->m_res_path = str( rec.res_path );
+        sp->m_text = str( rec.text );
+        sp->m_duration = rec.duration;
+        sp->m_freq_hz = static_cast<freq_t>(rec.freq_hz);
+        sp->m_medium = static_cast<Medium>(rec.medium);
+        sp->m_encoding = static_cast<Encoding>(rec.encoding);
+        sp->m_announcementp = (rec.flags & SF_Announce);
+        sp->m_quiet_okay = (rec.flags & SF_Quiet);
+        sp->m_repeatp = (rec.flags & SF_Repeat);
+        sp->m_dynamic = (rec.flags & SF_Dynamic);
+        if (has_source( sp->m_name )) {
+            ok = false;
+            break;
+        }
+        add_source( sp );
+    }
+    try {
+        if (ok) { link_sources(); }
+    } catch (const Schedule_error&) {
+        ok = false;
+    }
+    for (uint32_t i=0; ok and i < hdr.n_slots; i++) {
+        Skedc_slot rec;
+        memcpy( &rec, base + hdr.slots_off + i*sizeof(rec), sizeof(rec) );
+        if (rec.day >= DaysPerWeek or rec.start_day_sec >= SecsPerDay) {
+            ok = false;
+            break;
+        }
+        auto ps = std::make_shared<Play_slot>();
+        ps->m_name = str( rec.name );
+        ps->m_start_day_sec = rec.start_day_sec;
+        ps->m_announce = (rec.announce != 0);
+        // Preserve the invariants the JSON loader guarantees
+        auto &slots = m_programs[rec.day].m_slots;
+        if ((slots.empty() and (ps->m_start_day_sec or ps->m_announce))
+            or (not slots.empty()
+                and slots.back()->m_start_day_sec >= ps->m_start_day_sec)
+            or not source_id( ps->m_name, ps->m_source_id )) {
+            ok = false;
+            break;
+        }
+        slots.push_back( ps );
+    }
+    if (not ok) {
+        LOG_WARNING(Lgr) << "Compiled schedule " << skedc << " is damaged";
+        clear_sources();
+        for (auto &dp : m_programs) {
+            dp.m_slots.clear();
+        }
+        return false;
+    }
+    m_fname = json;
+    finish_load();
+    return true;
+}
@@ -18,10 +18,13 @@
  *   limitations under the License.
  */
 
+#include <mutex>
 #include <json/json.h>  /* jsoncpp */
 #include "source.hpp"
 #include "logging.hpp"
 #include "configutil.hpp"
+#include "clock.hpp"
+#include "reswatch.hpp"
 
 namespace fs = boost::filesystem;
 
@@ -139,6 +142,17 @@ static bool get_bool_option( const Json::Value &bval, bool dflt )
 
 //////////////////////////// Source ////////////////////////////////////
 
+/// Counts changes to the failure mark of any Source, so that cached
+/// resolutions of the schedule can tell when they may be stale.
+///
+std::atomic<unsigned long> Source::c_fail_epoch {0};
+
+/// Guards the failure mark (m_failedp, m_last_fail) of every Source:
+/// players may mark their source failed from their worker threads
+/// (e.g. during a check) while the main thread consults the schedule.
+///
+static std::mutex FailMutex {};
+
 /// CTOR for Source
 ///  special instance named OFF_SOURCE is always quiet
 ///
@@ -169,39 +183,60 @@ bool Source::localp() const
 ///
 void Source::mark_failed(bool fp)
 {
+    std::lock_guard<std::mutex> lock( FailMutex );
     if (fp) {
+        ++c_fail_epoch;
         m_failedp = true;
-        m_last_fail = time(0);
+        m_last_fail = Clock::now();
         LOG_WARNING(Lgr) << "Source {" << m_name
                          << "} being marked as faulty";
     } else {
         if (m_failedp) {
             LOG_WARNING(Lgr) << "Faulty flag cleared for Source {" << m_name
                           << "}";
+            ++c_fail_epoch;
             m_failedp = false;
         }
     }
 }
 
+/// Is the source marked failed?
+///
+bool Source::failedp() const
+{
+    std::lock_guard<std::mutex> lock( FailMutex );
+    return m_failedp;
+}
+
+/// Time the source was last marked failed, or 0.
+///
+time_t Source::last_fail() const
+{
+    std::lock_guard<std::mutex> lock( FailMutex );
+    return m_last_fail;
+}
+
 /// A source is viable if it is not failed, and any resource it needs
 /// is currently locatable.  Moreover, if it was marked failed more
-/// than m_src_retry_secs ago its failure mark is cleared.
+/// than m_src_retry_secs ago its failure mark is cleared.  If a
+/// resource watcher rw is given, local resources are looked up in it
+/// rather than on disk.
 ///
-bool Source::viable()
+bool Source::viable( Res_watcher *rw )
 {
-    if (m_failedp) {
-        time_t dt = (time(0) - last_fail());
+    if (failedp()) {
+        time_t dt = (Clock::now() - last_fail());
         if (dt > m_src_retry_secs) {
             LOG_INFO(Lgr) << "Schedule: time has passed...retry source {"
                           << m_name << "}";
             mark_failed(false);  // give it another chance
         }
     }
-    if (m_failedp) return false;
+    if (failedp()) return false;
     // resource pre-check (currently only for local files)
     if (localp()) {
         boost::filesystem::path eff_path;
-        if (not res_path(eff_path)) {
+        if (not res_path(eff_path, rw)) {
             return false;
         }
     }
@@ -210,13 +245,37 @@ bool Source::viable()
 }
 
 
+/// Would this source play exactly the same thing as source o?  True if
+/// the two agree on everything read from the schedule: resource,
+/// medium, encoding, alternate and the remaining properties. Failure
+/// marks are not compared.
+///
+bool Source::equivalent( const Source &o ) const
+{
+    return (m_name == o.m_name)
+        and (m_medium == o.m_medium)
+        and (m_encoding == o.m_encoding)
+        and (m_resource == o.m_resource)
+        and (m_res_path == o.m_res_path)
+        and (m_alternate == o.m_alternate)
+        and (m_freq_hz == o.m_freq_hz)
+        and (m_dynamic == o.m_dynamic)
+        and (m_repeatp == o.m_repeatp)
+        and (m_announcementp == o.m_announcementp)
+        and (m_quiet_okay == o.m_quiet_okay)
+        and (m_duration == o.m_duration)
+        and (m_text == o.m_text);
+}
+
 /// Describe the source in the log on a single line.
 ///
 void Source::describe() const
 {
     std::string ftime {""};
-    if (m_failedp) {
-        ftime = ctime(&m_last_fail);
+    time_t last = last_fail();
+    bool failed = failedp();
+    if (failed) {
+        ftime = ctime(&last);
         ftime.erase( ftime.end()-1, ftime.end() );
     }
     if (m_medium==Medium::radio) {     // Frequency
@@ -226,7 +285,7 @@ void Source::describe() const
                        << ", freq=" << static_cast<double>(m_freq_hz)/1000000.0
                        << ", alt='" << m_alternate
                        << "', ann=" << (m_announcementp ? 'y' : 'n')
-                       << ", failed=" << (m_failedp ? "y @ " : "n")
+                       << ", failed=" << (failed ? "y @ " : "n")
                        << ftime;
     }
     else if (m_medium==Medium::stream) { // URLs
@@ -238,7 +297,7 @@ void Source::describe() const
                        << "', repeat=" << (m_repeatp ? 'y' : 'n')
                        << ", dynamic=" << (m_dynamic ? 'y' : 'n')
                        << ", ann=" << (m_announcementp ? 'y' : 'n')
-                       << ", failed=" << (m_failedp ? "y @ " : "n")
+                       << ", failed=" << (failed ? "y @ " : "n")
                        << ftime;
     }
     else {
@@ -251,7 +310,7 @@ void Source::describe() const
                        << ", dur=" << m_duration
                        << ", dynamic=" << (m_dynamic ? 'y' : 'n')
                        << ", ann=" << (m_announcementp ? 'y' : 'n')
-                       << ", failed=" << (m_failedp ? "y @ " : "n")
+                       << ", failed=" << (failed ? "y @ " : "n")
                        << ftime;
     }
 }
@@ -295,11 +354,10 @@ const std::string& Source::resource() const
 ///
 bool uri_expand_time( const std::string &src, std::string &dst )
 {
-    time_t rawtime;
-    time(&rawtime);
-    tm *timeinfo = localtime(&rawtime);
+    tm timeinfo;
+    Clock::local( timeinfo );
     char timebuf[320] = {0};
-    if (strftime(timebuf,sizeof(timebuf)-1, src.c_str(), timeinfo)) {
+    if (strftime(timebuf,sizeof(timebuf)-1, src.c_str(), &timeinfo)) {
         dst = std::string(timebuf);
         return true;
     } else {
@@ -311,28 +369,28 @@ bool uri_expand_time( const std::string &src, std::string &dst )
 
 /// Set argument eff_path to the fully expanded pathname or URL.
 /// If dynamic we must expand any strftime symbols in the path
-/// If the resource is a local file, directory or playlist, check its existence.
+/// If the resource is a local file, directory or playlist, check its existence
+/// (asking resource watcher rw, if given, instead of the filesystem).
 /// Return false if we can show this path does not exist, else return true.
 ///
 /// * Will NOT throw.
 ///
-bool Source::res_path(boost::filesystem::path &eff_path)
+bool Source::res_path(boost::filesystem::path &eff_path, Res_watcher *rw)
 {
     bool pexists {true};
 
     if (not m_dynamic) {
         eff_path = m_res_path;  // '~' was already expanded to $HOME
     } else {
-        time_t rawtime;
-        time(&rawtime);
-        tm *timeinfo = localtime(&rawtime);
+        tm timeinfo;
+        Clock::local( timeinfo );
         char timebuf[256] = {0};
-        if (strftime(timebuf,sizeof(timebuf)-1, m_res_path.c_str(),timeinfo)) {
+        if (strftime(timebuf,sizeof(timebuf)-1, m_res_path.c_str(),&timeinfo)) {
             eff_path = boost::filesystem::path(timebuf);
         }
     }
     if (localp()) {    // check if local resource actually exists
-        pexists = exists( eff_path );
+        pexists = (rw ? rw->exists( eff_path ) : exists( eff_path ));
         if (not pexists) {
             LOG_WARNING(Lgr) << eff_path << " is not found";
         }
@@ -16,6 +16,7 @@
  *   limitations under the License.
  */
 
+#include <atomic>
 #include <string>
 #include <boost/filesystem.hpp>
 #include <memory>
@@ -57,6 +58,8 @@ public:
     }
 };
 
+class Res_watcher;
+
 /// foreshadow but do not include Json::Value
 namespace Json {
     class Value;
@@ -68,11 +71,12 @@ constexpr const char* OFF_SOURCE {"OFF"};
 /// Describe an audio source
 ///
 class Source {
+    friend class Schedule;      // restores sources from a .skedc
 private:
     std::string m_name;          // source name, e.g. "ksjn"
     std::string m_alternate {OFF_SOURCE};  // name of alternate source
-    bool m_failedp {false};      // last seen in a failed state?
-    time_t m_last_fail {0};      // time of last failure (or 0)
+    bool m_failedp {false};      // last seen in a failed state? (FailMutex)
+    time_t m_last_fail {0};      // time of last failure, or 0 (FailMutex)
     time_t m_src_retry_secs { 60*60 }; // delay before retries, 1 Hour
     // characteristics:
     Medium m_medium {Medium::off}; // how we get to it, e.g. radio
@@ -86,6 +90,7 @@ private:
     freq_t m_freq_hz {0};     // frequency in Hz for radio
     std::string m_resource {};  // filename, directory name, url, ...
     boost::filesystem::path m_res_path {};  // full expanded pathname
+    static std::atomic<unsigned long> c_fail_epoch; // bumped on any mark change
     //
     void extract_local_resource( const Json::Value& );
     void extract_required_props( const Json::Value& );
@@ -95,11 +100,14 @@ public:
     void clear();
     void describe() const;
     bool dynamic() const { return m_dynamic; }
+    double duration() const { return m_duration; }
     Encoding encoding() const { return m_encoding; }
-    bool failedp() const { return m_failedp; }
+    bool equivalent( const Source& ) const;
+    bool failedp() const;
     freq_t freq_hz() const { return m_freq_hz; }
     double freq_mhz() const { return (static_cast<double>(m_freq_hz) / 1.0e6); }
-    time_t last_fail() const { return m_last_fail; }
+    static unsigned long fail_epoch() { return c_fail_epoch; }
+    time_t last_fail() const;
     void load(const Json::Value &);
     bool localp() const;
     void mark_failed(bool fp=true);
@@ -107,11 +115,12 @@ public:
     Medium medium() const { return m_medium; };
     const std::string& name() const { return m_name; }
     bool repeatp() const {return m_repeatp; }
-    bool res_path(boost::filesystem::path&);
+    bool res_path(boost::filesystem::path&, Res_watcher* =nullptr);
+    time_t retry_time() const { return last_fail() + m_src_retry_secs; }
     const std::string& resource() const;
     void set_quiet_okay(bool q) { m_quiet_okay = q; }
     void validate(const ResPathSpec&);
-    bool viable();
+    bool viable( Res_watcher* =nullptr );
     //
     Source( const std::string& ); // name
 };
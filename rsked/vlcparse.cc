@@ -0,0 +1,227 @@
+/// Parsers for replies from the VLC 'cli' interface.
+///
+/// Each works through the reply a line at a time with string_views.
+/// They accept the same replies as the regular expressions they
+/// replaced (see test/tvlcparse.cc, which holds those for comparison).
+
+/*   Part of the rsked package.
+ *   Copyright 2020 Steven A. Harp   farlies(at)gmail.com
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <charconv>
+
+#include "logging.hpp"
+#include "vlcparse.hpp"
+
+using sv = std::string_view;
+
+
+/// Is c white space (as regex \s)?
+///
+static bool is_space( char c )
+{
+    return (' ' == c) or ('\t' == c) or ('\n' == c) or ('\r' == c)
+        or ('\f' == c) or ('\v' == c);
+}
+
+/// Is c a line separator?  Ptys end lines with "\r\n".
+///
+static bool is_eol( char c )
+{
+    return ('\n' == c) or ('\r' == c);
+}
+
+/// Call fn on each nonempty line of s, without its line separator,
+/// until fn returns true.  Returns true if some call did.
+///
+template <typename Fn>
+static bool any_line( sv s, Fn fn )
+{
+    size_t i = 0;
+    while (i < s.size()) {
+        size_t j = i;
+        while ((j < s.size()) and not is_eol( s[j] )) {
+            ++j;
+        }
+        if ((j > i) and fn( s.substr( i, j-i ) )) {
+            return true;
+        }
+        i = j + 1;
+    }
+    return false;
+}
+
+/// If s begins with word, remove it from s and return true.  A space
+/// in word stands for any single white space character.
+///
+static bool eat_word( sv &s, sv word )
+{
+    if (s.size() < word.size()) {
+        return false;
+    }
+    for (size_t i=0; i<word.size(); i++) {
+        if ((' ' == word[i]) ? not is_space( s[i] ) : (s[i] != word[i])) {
+            return false;
+        }
+    }
+    s.remove_prefix( word.size() );
+    return true;
+}
+
+/// Remove leading white space from s, returning how much there was.
+///
+static size_t eat_space( sv &s )
+{
+    size_t n = 0;
+    while ((n < s.size()) and is_space( s[n] )) {
+        ++n;
+    }
+    s.remove_prefix( n );
+    return n;
+}
+
+/// Remove trailing white space from s, returning how much there was.
+///
+static size_t trim_space( sv &s )
+{
+    size_t n = 0;
+    while ((n < s.size()) and is_space( s[s.size()-1-n] )) {
+        ++n;
+    }
+    s.remove_suffix( n );
+    return n;
+}
+
+/// Parse an unsigned decimal that is all of s into u.  Returns false
+/// if s is anything else, or too large.
+///
+static bool to_unsigned( sv s, unsigned long &u )
+{
+    unsigned long v {0};
+    auto [end, ec] = std::from_chars( s.data(), s.data()+s.size(), v );
+    if ((std::errc() != ec) or (end != s.data()+s.size())) {
+        return false;
+    }
+    u = v;
+    return true;
+}
+
+
+/// Look for any of the known error strings from the (English language)
+/// vlc cli response in string resp: a line that begins with "Error" or
+/// "error", or "filesystem stream error" or "access stream error"
+/// anywhere. Return true iff an error is detected.
+///
+bool vlc_detect_error( sv resp )
+{
+    if (any_line( resp, [](sv line) {
+                return (line.size() >= 5) and (('E' == line[0]) or ('e' == line[0]))
+                    and (line.substr(1,4) == "rror"); } )) {
+        return true;
+    }
+    for (size_t i = resp.find("stream"); i != sv::npos; i = resp.find("stream",i+1)) {
+        sv after = resp.substr( i + 6 );
+        if ((i < 1) or not is_space( resp[i-1] )
+            or not eat_word( after, " error" )) {
+            continue;
+        }
+        sv before = resp.substr( 0, i-1 );
+        for (sv what : { sv("filesystem"), sv("access") }) {
+            if ((before.size() >= what.size())
+                and (before.substr( before.size()-what.size() ) == what)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// Takes apart the status response into volume and resource: each
+/// line of the form "( key: value )" where key is one of "audio volume",
+/// "new input" or "state".  A volume that is not a number is logged
+/// and ignored.  The state (e.g. "playing") is recognized but not
+/// used--it has never been, and vlc's transient states (such as
+/// "opening") would not map to a PlayerState.  Returns true if any
+/// line of status is parsed, otherwise false.
+///
+/// * Will NOT throw
+///
+bool vlc_parse_status( sv resp, unsigned &obsvol, std::string &resource )
+{
+    enum class Key { state, volume, input };
+    sv input {};
+    bool has_input {false};
+    bool parsedp {false};
+    any_line( resp, [&](sv line) {
+            if (not eat_word( line, "(" )) {
+                return false;
+            }
+            eat_space( line );
+            Key key { Key::state };
+            if (eat_word( line, "state" )) {
+                key = Key::state;
+            } else if (eat_word( line, "audio volume" )) {
+                key = Key::volume;
+            } else if (eat_word( line, "new input" )) {
+                key = Key::input;
+            } else {
+                return false;
+            }
+            while (eat_word( line, ":" )) { }
+            if ((0 == eat_space( line )) or line.empty() or (')' != line.back())) {
+                return false;
+            }
+            line.remove_suffix( 1 );
+            if ((0 == trim_space( line )) or line.empty()
+                or (sv::npos != line.find(')'))) {
+                return false;
+            }
+            if (Key::volume == key) {  // leading digits, as std::stoul
+                unsigned long u {0};
+                auto [end, ec] = std::from_chars( line.data(),
+                                                  line.data()+line.size(), u );
+                if (std::errc() == ec) {
+                    obsvol = static_cast<unsigned>( u );
+                } else {
+                    LOG_WARNING(Lgr) << "Vlc reports odd volume: " << line;
+                }
+            } else if (Key::input == key) {
+                input = line;
+                has_input = true;
+            }
+            parsedp = true;
+            return false;           // on to the next line
+        } );
+    if (has_input) {
+        resource.assign( input.data(), input.size() );
+    }
+    return parsedp;
+}
+
+/// Extract an unsigned integer appearing on a line by itself.
+/// Sets parameter u to the parsed integer and return true on success.
+/// If more than one integer is present, only the first will be parsed.
+/// Returns false if no integer was found (or it is too large).
+///
+/// * Will NOT throw
+///
+bool vlc_parse_unsigned( sv resp, unsigned long &u )
+{
+    return any_line( resp, [&u](sv line) {
+            eat_space( line );
+            trim_space( line );
+            return not line.empty() and to_unsigned( line, u );
+        } );
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/// Parsers for replies from the VLC 'cli' interface.  These scan the
+/// reply in place, a line at a time, and do not allocate (except as
+/// the resource string may need to grow).
+
+#include <string>
+#include <string_view>
+
+
+bool vlc_detect_error( std::string_view );
+bool vlc_parse_status( std::string_view, unsigned&, std::string& );
+bool vlc_parse_unsigned( std::string_view, unsigned long& );
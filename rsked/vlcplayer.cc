@@ -6,6 +6,7 @@
 /// - enabled  (true|false)
 /// - bin_path "/usr/bin/vlc"
 /// - debug    (true|false)
+/// - wait_us, prompt_framing, prompt_wait_us  (see do_command)
 ///
 /// * * *
 /// This implementation uses the textual 'cli' interface to VLC.
@@ -32,6 +33,7 @@
 #include "configutil.hpp"
 #include "config.hpp"
 #include "vlcplayer.hpp"
+#include "vlcparse.hpp"
 #include "playermgr.hpp"
 
 #ifdef BOOST_TEST_DYN_LINK
@@ -40,9 +42,9 @@
   #include "rsked.hpp"
 #endif
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <boost/asio.hpp>
-#include <boost/regex.hpp>
 
 namespace fs = boost::filesystem;
 
@@ -91,99 +93,6 @@ static void really_sleep( long usecs )
 }
 
 
-/// this is used to parse vlc status messages from cli interface
-///
-static boost::regex Status_regex(R"*(
-^ \( \s* (state|(?:audio \s volume)|(?:new \s input)) [:]* \s+
-  ( [^)]+ ) \s+ \) $)*",  boost::regex::mod_x);
-
-/// look for an unsigned decimal number on a line by itself:
-///
-static boost::regex
-Unsigned_regex(R"*( ^ \s* (\d+) \s* $ )*", boost::regex::mod_x);
-
-
-/// Extract an unsigned integer appearing on a line by itself.
-/// Sets parameter u to the parsed integer and return true on success.
-/// If more than one integer is present, only the first will be parsed.
-/// Returns false if no integer was found.
-///
-/// * May throw  std::runtime_error in very rare circumstances
-///
-static bool parse_unsigned( const std::string &resp, unsigned long &u )
-{
-   boost::match_results<std::string::const_iterator> what;
-   boost::match_flag_type flags = boost::match_default;
-
-   if (regex_search(resp.begin(),resp.end(),what,Unsigned_regex,flags))
-   {
-       std::string snumber(what[1].first, what[1].second);
-       try {
-           u = std::stoul( snumber ); // can throw std::invalid_argument
-       }
-       catch( std::invalid_argument & ) { // unlikely
-           LOG_DEBUG(Lgr) << "parse_unsigned: invalid int '"
-                          << snumber << "'";
-           return false;
-       }
-       return true;
-   }
-   // LOG_DEBUG(Lgr) << "parse_unsigned: no match for:" << resp;
-   return false;
-}
-
-
-/// Takes apart the status response into state, volume and resource
-///  'stopped' : PlayerState::Stopped
-///  'playing' : PlayerState::Playing
-///  'paused'  : PlayerState::Paused
-/// Returns true if a normal status response is parsed, othewise false.
-///
-/// * May throw std::runtime_error in VERY rare circumstances
-///
-static bool
-parse_status( const std::string &sresp1, PlayerState &pstate,
-                   unsigned &obsvol, std::string &resource)
-{
-   std::string::const_iterator start, end;
-   start = sresp1.begin();
-   end = sresp1.end();
-   boost::match_results<std::string::const_iterator> what;
-   boost::match_flag_type flags = boost::match_default;
-   bool parsedp {false};
-
-   while(regex_search(start, end, what, Status_regex, flags))
-   {
-       std::string skey(what[1].first, what[1].second);
-       std::string sval(what[2].first, what[2].second);
-       parsedp = true;
-       if (skey == "audio volume") {
-           try {
-               obsvol = static_cast<unsigned>( std::stoul(sval) );
-               // can throw std::invalid_argument
-           } catch(...) {
-               LOG_WARNING(Lgr) << "Vlc reports odd volume: " << sval;
-           }
-       }
-       else if (skey == "status") {
-           if ("stopped" == sval) { pstate = PlayerState::Stopped; }
-           else if ("playing" == sval) { pstate = PlayerState::Playing; }
-           else if ("paused" == sval) { pstate = PlayerState::Paused; }
-           else {
-               LOG_ERROR(Lgr) << "VLC unexpected status: '" << sval << "'";
-               pstate=PlayerState::Broken;
-           }
-       }
-       else if (skey == "new input") {
-           resource = sval;   // TODO: maybe trim any file:// prefix?
-       }
-       start = what[0].second;  // move to the next sexpr
-       flags |= boost::match_prev_avail;
-       flags |= boost::match_not_bob;
-   }
-   return parsedp;
-}
-
 ///////////////////////////////////////////////////////////////////////////
 
 /// Establish baseline capabilities. Shared by all ctors.
@@ -260,23 +169,12 @@ Vlc_player::~Vlc_player()
 ////////////////////////////// Private Methods //////////////////////////////
 
 
-/// Look for any of the known error strings from the (English language)
-/// vlc cli response in string resp. Return true iff an error id detected.
-///
-static bool detect_vlc_error( const std::string &resp )
-{
-    static boost::regex
-        err_regex(R"*( ^ [E|e]rror | (filesystem|access) \s stream \s error )*",
-                  boost::regex::mod_x);
-    boost::match_results<std::string::const_iterator> what;
-    boost::match_flag_type flags = boost::match_default;
-
-    return regex_search( resp.begin(), resp.end(), what, err_regex, flags );
-}
-
-
 /// Runs the command in cmd. Note: cmd must end in exactly one '\n'!
-/// Retrieve the resuts in m_last_resp.
+/// Retrieve the resuts in m_last_resp.  If framed, the response is
+/// complete once the cli prompt follows it, and any stale output is
+/// discarded first; otherwise it is whatever arrives before vlc falls
+/// quiet for m_iowait_us.  Should the prompt go missing several times
+/// in a row, framing is abandoned.
 /// Check if there is an error message, and throw if so.
 /// If the 'log_errors" argument is true, then log an error.
 /// * Can throw Player_ops_exception
@@ -303,16 +201,28 @@ void Vlc_player::do_command( const std::string& cmd, bool log_errors )
         cmdx.pop_back();
         LOG_DEBUG(Lgr) << "Tell vlc: " << cmdx;
     }
+    if (m_framed) {
+        m_cm->pty_discard();    // any late reply to an earlier command
+    }
     m_cm->pty_write_nb( cmd );
     if (m_debug) {
         LOG_DEBUG(Lgr) << "command was written, now wait for response";
     }
     m_last_resp.clear();
-    m_cm->pty_read_nb( m_last_resp, MaxResponse );
+    if (not m_framed) {
+        m_cm->pty_read_nb( m_last_resp, MaxResponse );
+    } else if (m_cm->pty_read_until( m_last_resp, MaxResponse,
+                                     m_prompt, m_prompt_us )) {
+        m_prompt_misses = 0;
+    } else if (++m_prompt_misses >= MaxPromptMisses) {
+        LOG_WARNING(Lgr) << m_name << " never sees the vlc prompt '"
+                         << m_prompt << "'--reverting to unframed reads";
+        m_framed = false;
+    }
     if (m_debug) {
         LOG_DEBUG(Lgr) << "Vlc responds: " << m_last_resp;
     }
-    if ( detect_vlc_error(m_last_resp) ) {
+    if ( vlc_detect_error(m_last_resp) ) {
         if (log_errors) {
             std::string cmdx = cmd;
             cmdx.pop_back();
@@ -341,7 +251,7 @@ void Vlc_player::assure_running()
     }
 }
 
-/// Sets the vlc internal volume level to m_volume (%).
+/// Sets the vlc internal volume level to m_level% of m_volume (%).
 /// This should be done once after starting the child process.
 /// Does nothing if the vlc child is not running.
 ///
@@ -353,7 +263,7 @@ void Vlc_player::set_volume()
         LOG_WARNING(Lgr) << m_name << " set volume cmd skipped: not running.";
         return;
     }
-    unsigned vol = (m_volume * VlcMaxVol / 100);
+    unsigned vol = (m_volume * m_level / 100 * VlcMaxVol / 100);
     std::string svol { std::to_string( vol ) };
     std::string set_vol_cmd { "volume " };
     set_vol_cmd += svol;
@@ -362,6 +272,21 @@ void Vlc_player::set_volume()
     do_command( set_vol_cmd, true );
 }
 
+/// Set the level to pct (at most 100) percent of the configured volume.
+/// It takes effect at once if vlc is running, and otherwise when it
+/// is started.
+///
+/// * May throw a Player_exception or CM_exception.
+///
+bool Vlc_player::set_volume( unsigned pct )
+{
+    m_level = std::min( pct, 100U );
+    if (not m_testmode and m_cm->running()) {
+        set_volume();
+    }
+    return true;
+}
+
 /// We might need to wait up to m_iowait_us for I/O. Pass this
 /// member value on the ChildMgr pty. Value required varies from
 /// one machine to another.  Currently the same for read and write.
@@ -433,7 +358,8 @@ bool Vlc_player::check_status()
 }
 
 /// Performs a "status" command on the VLc player, setting members:
-///    m_last_resp, m_state, m_obsvol, m_obsuri
+///    m_last_resp, m_obsvol, m_obsuri
+/// (m_state is as the commands we issued left it; see vlc_parse_status)
 ///
 /// Returns one of the Vlc_player::CmdRes values:
 /// - completed
@@ -466,7 +392,7 @@ Vlc_player::CmdRes Vlc_player::do_status()
         return CmdRes::misc_error;
     }
     m_obsuri = "";
-    if (parse_status( m_last_resp, m_state, m_obsvol, m_obsuri )) {
+    if (vlc_parse_status( m_last_resp, m_obsvol, m_obsuri )) {
         return CmdRes::completed;
     }
     return CmdRes::bad_parse;
@@ -526,7 +452,7 @@ void Vlc_player::check_not_stalled()
     try {
         do_command("get_time\n",true);
         unsigned long u {0};
-        if (not parse_unsigned(m_last_resp,u)) { // no number returned
+        if (not vlc_parse_unsigned(m_last_resp,u)) { // no number returned
             // LOG_DEBUG(Lgr) << m_name << " no progress reported...maybe stalled";
             u = m_last_elapsed_secs;
         } else {
@@ -593,7 +519,7 @@ bool Vlc_player::completed()
 bool Vlc_player::currently_playing( spSource src )
 {
     if (!src or !m_src) { return false; }
-    assure_running();     // This sets m_state and m_obsuri
+    assure_running();     // This sets m_obsuri
     if (m_src->name() != src->name()) { // had been on a different source
         return false;
     }
@@ -722,12 +648,25 @@ void Vlc_player::initialize( Config &cfg, bool testp )
                          << " is implausible, using " << m_iowait_us;
     }
     //
+    // Optional framing: responses end at the prompt, so no read timeout
+    cfg.get_bool(m_name.c_str(),"prompt_framing",m_framed);
+    long pwait = m_prompt_us;
+    cfg.get_long(m_name.c_str(),"prompt_wait_us",pwait);
+    if ((pwait > 0) and (pwait < 10'000'000)) {
+        m_prompt_us = pwait;
+    } else {
+        LOG_WARNING(Lgr) << m_name << " prompt_wait_us:=" << pwait
+                         << " is implausible, using " << m_prompt_us;
+    }
+    m_prompt_misses = 0;
+    //
     m_bin_path = Default_vlc_bin;
     if (m_enabled) {
         cfg.get_pathname(m_name.c_str(),"bin_path",
                          FileCond::MustExist, m_bin_path);
         m_cm->set_binary( m_bin_path );
         m_cm->set_name( m_name );
+        configure_child( cfg, m_name.c_str(), *m_cm );
     }
     //
     if (m_enabled) {
@@ -890,6 +829,24 @@ void Vlc_player::play( spSource src )
 }
 
 
+/// Get ready to play src at an upcoming slot boundary: make sure the
+/// VLC process is up, and for a network stream look up the host now,
+/// so that play() has less to do when the time comes.
+/// Anything now playing is left alone.
+///
+/// * May throw Player_exception or CM_exception
+///
+void Vlc_player::prepare( spSource src )
+{
+    if (not m_enabled or m_testmode or not src) {
+        return;
+    }
+    assure_running();
+    if (Medium::stream == src->medium() and Player_manager::inet_available()) {
+        prefetch_host( src->resource() );
+    }
+}
+
 /// Resume play after pause.  Should *only* be invoked after pause!
 /// * May throw Player_exception
 ///
@@ -34,13 +34,14 @@
 ///
 class Vlc_player : public Player_with_caps {
 private:
-    enum { MaxResponse=4000, RecheckSecs=2*60*60 };
+    enum { MaxResponse=4000, RecheckSecs=2*60*60, MaxPromptMisses=3 };
     enum class CmdRes { completed, not_running, no_pty,
             bad_parse, unresponsive, misc_error };
     std::string m_name; // user friendly name of player
     spSource m_src {};  // store the source we are playing
     PlayerState m_state { PlayerState::Stopped };
     unsigned m_volume;     // as a percentage [0-100]
+    unsigned m_level {100}; // percent of m_volume to play at
     unsigned m_obsvol {0};  // observed playback volume
     boost::filesystem::path m_library_path {}; // music library location
     std::string m_library_uri {"file://"}; // music library location
@@ -51,6 +52,10 @@ private:
     bool m_debug {false};
     bool m_testmode {false};
     long m_iowait_us { 40'000 };  // microseconds to wait on pty I/O
+    bool m_framed {false};        // replies end at the cli prompt
+    std::string m_prompt {"> "};  // cli prompt that ends each reply
+    long m_prompt_us { 1'000'000 }; // uS to wait for the prompt
+    unsigned m_prompt_misses {0}; // consecutive replies lacking it
     long m_kill_us { 50'000 };   // uS to wait for child process exit
     unsigned m_stall_counter {0};
     unsigned m_stalls_max {7};
@@ -88,7 +93,9 @@ public:
     virtual bool is_usable();
     virtual void pause();
     virtual void play( spSource );
+    virtual void prepare( spSource );
     virtual void resume();
+    virtual bool set_volume( unsigned );
     virtual PlayerState state();
     virtual void stop();
     virtual bool check();
@@ -0,0 +1,72 @@
+/// Parser for wav images, as decoded by ogg123 for the Pcm_player.
+
+/*   Part of the rsked package.
+ *   Copyright 2020 Steven A. Harp   farlies(at)gmail.com
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "wavparse.hpp"
+
+
+/// Read a little-endian integer of n bytes at p.
+///
+static uint32_t le_uint( const char *p, unsigned n )
+{
+    uint32_t v = 0;
+    for (unsigned i=n; i>0; i--) {
+        v = (v << 8) | static_cast<unsigned char>(p[i-1]);
+    }
+    return v;
+}
+
+/// Extract the PCM from wav file image buf into clip. Only 16 bit PCM
+/// is accepted.  Returns false if buf is not such a wav.
+///
+bool parse_wav( const std::vector<char> &buf, Pcm_clip &clip )
+{
+    if ((buf.size() < 12) or std::string(buf.data(),4) != "RIFF"
+        or std::string(buf.data()+8,4) != "WAVE") {
+        return false;
+    }
+    size_t pos = 12;
+    bool have_fmt = false;
+    while (pos + 8 <= buf.size()) {
+        std::string id { buf.data()+pos, 4 };
+        size_t len = le_uint( buf.data()+pos+4, 4 );
+        size_t body = pos + 8;
+        len = std::min( len, buf.size() - body );   // unfinished header
+        if ("fmt " == id and len >= 16) {
+            unsigned tag = le_uint( buf.data()+body, 2 );
+            clip.channels = le_uint( buf.data()+body+2, 2 );
+            clip.rate = le_uint( buf.data()+body+4, 4 );
+            unsigned bits = le_uint( buf.data()+body+14, 2 );
+            have_fmt = ((1 == tag) or (0xFFFE == tag)) and (16 == bits)
+                and clip.channels and clip.rate;
+        } else if ("data" == id) {
+            if (not have_fmt) {
+                return false;
+            }
+            len -= len % (2*clip.channels);       // whole frames
+            clip.pcm.assign( buf.begin() + static_cast<long>(body),
+                             buf.begin() + static_cast<long>(body + len) );
+            return true;
+        }
+        pos = body + len + (len & 1);
+    }
+    return false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+/*   Part of the rsked package.
+ *   Copyright 2020 Steven A. Harp   farlies(at)gmail.com
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ */
+
+/// Parser for the wav images the Pcm_player decodes announcements to.
+
+#include <vector>
+
+
+/// One announcement, decoded to signed 16 bit little-endian PCM.
+///
+struct Pcm_clip {
+    unsigned rate {0};                  // frames per second
+    unsigned channels {0};
+    std::vector<char> pcm {};
+    double secs() const {
+        return (rate and channels)
+            ? static_cast<double>(pcm.size()) / (2.0 * rate * channels) : 0.0;
+    }
+};
+
+bool parse_wav( const std::vector<char>&, Pcm_clip& );
@@ -4,7 +4,8 @@
  * This is a "manual" test, and requires user interaction to listen for
  * the correct audio output. It does not use the boost test framework.
  *   1.  mpd must be running
- *   2.  you must provide a valid resource string as the sole argument
+ *   2.  you must provide a valid resource string as the first argument
+ *   3.  a second argument "batch" sends the setup as one command list
  */
 
 /*   Part of the rsked package.
@@ -45,6 +46,15 @@ namespace fs = boost::filesystem;
 /// playlist (.m3u) The .m3u will (must) be stripped for mpd.
 ///  mpdtest  "master.m3u"
 
+/// directory, with one round trip to set up and start play
+///  mpdtest  "Brian Eno/Another Green World"  batch
+
+/// missing resource or playlist in a batch: expect "could not access
+/// the resource", then the status printed and "MPD no error" as the
+/// connection recovers
+///  mpdtest  "No Such Artist/No Such Album"  batch
+///  mpdtest  "no_such_list.m3u"  batch
+
 ///////////////////////////////////////////////////////////////////////////////////
 
 void log_last_err( Mpd_client &client )
@@ -115,6 +125,40 @@ void testp( Mpd_client &client,  const std::string &plist )
     client.disconnect();
 }
 
+/// tests a track, directory or playlist with a single command list
+///
+void testb( Mpd_client &client,  const std::string &resource )
+{
+    fs::path rfile { resource };
+    client.connect();
+    auto trips = client.round_trips();
+    Mpd_batch batch {};
+    batch.stop().clear_queue().set_repeat_mode(false);
+    if (rfile.extension() == ".m3u") {
+        batch.enqueue_playlist( rfile.stem().native() );
+    } else {
+        batch.enqueue( resource );
+    }
+    try {
+        client.run_batch( batch.play() );
+    } catch (const Mpd_queue_exception &) {
+        LOG_ERROR(Lgr) << "Batch refused: " << resource;
+        log_last_err( client );
+        // the connection should still answer after MPD's ACK, leaving
+        // last_err clear for main to report
+        client.check_status(Mpd_opt::Print);
+        client.disconnect();
+        return;
+    }
+    LOG_INFO(Lgr) << batch.size() << " commands took "
+                  << (client.round_trips() - trips) << " round trip(s)";
+    client.check_status(Mpd_opt::Print);
+    sleep(10);
+    client.stop();
+    //
+    client.disconnect();
+}
+
 ////////////////////////////////////////////////////////////////////////////
 
 
@@ -132,7 +176,9 @@ int main(int argc, char* argv[])
 
     Mpd_client  client {};
     try {
-        if (filename.extension() == ".m3u") {
+        if ((argc > 2) and (std::string("batch") == argv[2])) {
+            testb( client, filestring ); // one command list
+        } else if (filename.extension() == ".m3u") {
             LOG_INFO(Lgr) << "(It seems to be a playlist.)";
             testp( client, filestring ); // playlist - handled differently
         } else {
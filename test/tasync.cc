@@ -0,0 +1,142 @@
+/// Test the Async_player and Player_op classes, run as:
+///
+///    tasync  --log_level=all
+
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/// Dynamically link boost test framework
+#define BOOST_TEST_MODULE async_test
+#ifndef BOOST_TEST_DYN_LINK
+#define BOOST_TEST_DYN_LINK 1
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+
+#include "logging.hpp"
+#include "player.hpp"
+
+using std::chrono::milliseconds;
+
+
+/// Simple test fixture that just handles logging setup/teardown.
+///
+struct LogFixture {
+    LogFixture() {
+        init_logging("tasync","tasync_%5N.log",LF_FILE|LF_DEBUG|LF_CONSOLE);
+    }
+    ~LogFixture() {
+        finish_logging();
+    }
+};
+
+BOOST_TEST_GLOBAL_FIXTURE(LogFixture);
+
+
+/// A player whose play() takes m_delay and fails if m_fail is set.
+///
+class Slow_player : public Player {
+private:
+    std::string m_name {"Slow_player"};
+public:
+    milliseconds m_delay {0};
+    bool m_fail {false};
+    std::atomic<unsigned> m_plays {0};
+    std::atomic<unsigned> m_stops {0};
+    //
+    const std::string& name() const override { return m_name; }
+    bool completed() override { return false; }
+    bool currently_playing( spSource ) override { return false; }
+    void exit() override { }
+    void initialize( Config&, bool ) override { }
+    bool is_usable() override { return true; }
+    void pause() override { }
+    void play( spSource ) override {
+        std::this_thread::sleep_for( m_delay );
+        if (m_fail) throw Player_media_exception();
+        ++m_plays;
+    }
+    void resume() override { }
+    PlayerState state() override { return PlayerState::Stopped; }
+    void stop() override { ++m_stops; }
+    bool check() override { return true; }
+    bool has_cap( Medium, Encoding ) const override { return true; }
+    void cap_string( std::string & ) const override { }
+    void install_caps( Player_prefs& ) const override { }
+    bool is_enabled() const override { return true; }
+    bool set_enabled( bool ) override { return true; }
+};
+
+/// proforma dtor
+Player::~Player() { }
+
+
+/// Operations run in order and report success or the exception thrown.
+///
+BOOST_AUTO_TEST_CASE( Run_in_order )
+{
+    auto sp = std::make_shared<Slow_player>();
+    sp->m_delay = milliseconds(20);
+    Async_player ap { sp };
+    spPlayer_op play = ap.play( nullptr, milliseconds(1000) );
+    spPlayer_op stop = ap.stop( milliseconds(1000) );
+    BOOST_TEST( ap.busy() );
+    BOOST_TEST( stop->wait_for( milliseconds(1000) ) );
+    BOOST_TEST( play->finished() );
+    BOOST_TEST( (play->status() == Op_status::done) );
+    BOOST_TEST( (stop->status() == Op_status::done) );
+    BOOST_TEST( sp->m_plays == 1U );
+    BOOST_TEST( sp->m_stops == 1U );
+    BOOST_TEST( not ap.busy() );
+
+    sp->m_fail = true;
+    spPlayer_op bad = ap.play( nullptr, milliseconds(1000) );
+    BOOST_TEST( bad->wait_for( milliseconds(1000) ) );
+    BOOST_TEST( (bad->status() == Op_status::failed) );
+    BOOST_CHECK_THROW( bad->rethrow(), Player_media_exception );
+}
+
+
+/// A slow operation times out at its deadline; the next one queued
+/// runs after it anyway, and a cancelled one never runs.
+///
+BOOST_AUTO_TEST_CASE( Timeout_and_cancel )
+{
+    auto sp = std::make_shared<Slow_player>();
+    sp->m_delay = milliseconds(300);
+    Async_player ap { sp };
+    auto t0 = std::chrono::steady_clock::now();
+    spPlayer_op play = ap.play( nullptr, milliseconds(50) );
+    spPlayer_op never = ap.play( nullptr, milliseconds(1000) );
+    spPlayer_op stop = ap.stop( milliseconds(1000) );
+    while (not play->wait_for( milliseconds(10) )) { }
+    auto ms = std::chrono::duration_cast<milliseconds>(
+        std::chrono::steady_clock::now() - t0 ).count();
+    BOOST_TEST( ms < 200 );
+    BOOST_TEST( (play->status() == Op_status::timed_out) );
+    BOOST_CHECK_THROW( play->rethrow(), Player_timeout_exception );
+    never->cancel();
+    BOOST_CHECK_THROW( never->rethrow(), Player_cancel_exception );
+    BOOST_TEST( stop->wait_for( milliseconds(1000) ) );
+    BOOST_TEST( (stop->status() == Op_status::done) );
+    BOOST_TEST( sp->m_plays == 1U );    // the abandoned one completed
+    BOOST_TEST( sp->m_stops == 1U );
+    BOOST_TEST( not Async_player::busy( sp.get() ) );
+}
@@ -0,0 +1,111 @@
+/// Test the Event_loop and event descriptor classes, run as:
+///
+///    tevloop  --log_level=all
+
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/// Dynamically link boost test framework
+#define BOOST_TEST_MODULE evloop_test
+#ifndef BOOST_TEST_DYN_LINK
+#define BOOST_TEST_DYN_LINK 1
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <unistd.h>
+
+#include "logging.hpp"
+#include "evloop.hpp"
+
+
+/// Simple test fixture that just handles logging setup/teardown.
+///
+struct LogFixture {
+    LogFixture() {
+        init_logging("tevloop","tevloop_%5N.log",LF_FILE|LF_DEBUG|LF_CONSOLE);
+    }
+    ~LogFixture() {
+        finish_logging();
+    }
+};
+
+BOOST_TEST_GLOBAL_FIXTURE(LogFixture);
+
+
+/// An eventfd bumped before the wait wakes the loop immediately.
+///
+BOOST_AUTO_TEST_CASE( Eventfd_wake )
+{
+    Event_loop loop {};
+    Event_fd efd {};
+    uint64_t count = 0;
+    loop.add( efd.fd(), [&](uint32_t) { count += efd.consume(); } );
+
+    BOOST_TEST( loop.run_once(0) == 0U );   // nothing ready yet
+    efd.notify();
+    efd.notify();
+    BOOST_TEST( loop.run_once(1000) == 1U );
+    BOOST_TEST( count == 2U );
+    loop.remove( efd.fd() );
+    efd.notify();
+    BOOST_TEST( loop.run_once(0) == 0U );   // no longer watched
+}
+
+
+/// A wall clock timer armed one second ahead expires in about a
+/// second, not at the end of a polling interval.
+///
+BOOST_AUTO_TEST_CASE( Timer_deadline )
+{
+    using Clock = std::chrono::steady_clock;
+    Event_loop loop {};
+    Timer_fd timer { CLOCK_REALTIME };
+    uint64_t expired = 0;
+    loop.add( timer.fd(), [&](uint32_t) { expired += timer.consume(); } );
+
+    auto t0 = Clock::now();
+    timer.arm_at( time(0) + 1 );
+    while (0 == expired) {
+        loop.run_once( 3000 );
+        BOOST_REQUIRE( (Clock::now() - t0) < std::chrono::seconds(3) );
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        Clock::now() - t0).count();
+    LOG_INFO(Lgr) << "Timer_deadline: expired after " << ms << " ms";
+    BOOST_TEST( expired == 1U );
+    BOOST_TEST( ms <= 1100 );
+}
+
+
+/// A signal raised while blocked is read from the signalfd.
+///
+BOOST_AUTO_TEST_CASE( Signal_read )
+{
+    Event_loop loop {};
+    int got = 0;
+    {
+        Signal_fd sigs { SIGUSR1, SIGHUP };
+        loop.add( sigs.fd(), [&](uint32_t) { got = sigs.next(); } );
+        kill( getpid(), SIGHUP );
+        BOOST_TEST( loop.run_once(1000) == 1U );
+        loop.remove( sigs.fd() );
+    }
+    BOOST_TEST( got == SIGHUP );
+}
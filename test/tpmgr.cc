@@ -31,7 +31,9 @@
 #include <boost/test/data/monomorphic.hpp>
 
 #include <cstring>
+#include <future>
 #include <memory>
+#include <thread>
 
 #include "logging.hpp"
 #include "playermgr.hpp"
@@ -159,6 +161,94 @@ BOOST_AUTO_TEST_CASE( config_pmgr_default )
 }
 
 
+//////////////////////////////////////////////////////////////////////////
+
+/// Players are reranked by observed start time and failures, moving
+/// at most one place (the default rank_shift).
+
+BOOST_AUTO_TEST_CASE( adaptive_rank )
+{
+    const char *confname = "../test/tpmgr.json";
+    Config cfg(confname);
+    cfg.read_config();      // might throw
+
+    Player_manager pmgr {};
+    pmgr.configure( cfg,  true ); // (testp) might throw
+
+    std::string test_src {"OggDirSrc"};
+    const char *src_json =
+        R"( {"encoding" : "ogg", "location" : "Herman's Hermits/Retrospective",
+             "medium": "directory", "repeat" : true, "duration": 3992.731} )";
+    spSource sp_src = std::make_shared<Source>(test_src);
+    BOOST_TEST( src_init( sp_src, src_json ) );
+
+    spPlayer ogg = pmgr.get_player(sp_src);
+    BOOST_REQUIRE( ogg );
+    BOOST_TEST( ogg->name() == "Ogg_player" );
+    ogg->set_enabled(false);
+    spPlayer vlc = pmgr.get_player(sp_src);
+    ogg->set_enabled(true);
+    BOOST_REQUIRE( vlc );
+    BOOST_TEST( vlc->name() == "Vlc_player" );
+
+    // 1. Too few samples: no change, however slow Ogg_player is.
+    pmgr.note_play( ogg, sp_src, 6000.0, true );
+    pmgr.note_play( vlc, sp_src, 100.0, true );
+    BOOST_TEST( pmgr.get_player(sp_src) == ogg );
+
+    // 2. Enough samples: the much faster Vlc_player moves up.
+    for (int i=0; i<2; i++) {
+        pmgr.note_play( ogg, sp_src, 6000.0, true );
+        pmgr.note_play( vlc, sp_src, 100.0, true );
+    }
+    BOOST_TEST( pmgr.get_player(sp_src) == vlc );
+    Play_stats ps = pmgr.play_stats( "Vlc_player", Medium::directory,
+                                     Encoding::ogg );
+    BOOST_TEST( ps.plays == 3UL );
+    BOOST_TEST( ps.fails == 0UL );
+
+    // 3. Failures cost it the place again.
+    for (int i=0; i<3; i++) {
+        pmgr.note_play( vlc, sp_src, 30000.0, false );
+    }
+    BOOST_TEST( pmgr.get_player(sp_src) == ogg );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+/// A player busy with an asynchronous operation (e.g. preparing the
+/// next source) is still chosen, as long as it was last seen usable.
+
+BOOST_AUTO_TEST_CASE( busy_player_chosen )
+{
+    const char *confname = "../test/tpmgr.json";
+    Config cfg(confname);
+    cfg.read_config();      // might throw
+
+    Player_manager pmgr {};
+    pmgr.configure( cfg,  true ); // (testp) might throw
+
+    const char *src_json =
+        R"( {"encoding" : "ogg", "location" : "Herman's Hermits/Retrospective",
+             "medium": "directory", "repeat" : true, "duration": 3992.731} )";
+    spSource sp_src = std::make_shared<Source>("OggDirSrc");
+    BOOST_TEST( src_init( sp_src, src_json ) );
+
+    spPlayer ogg = pmgr.get_player(sp_src);
+    BOOST_REQUIRE( ogg );
+    std::promise<void> release;
+    std::shared_future<void> released { release.get_future().share() };
+    auto op = pmgr.async_player( ogg ).submit( "prepare",
+        [released](Player&) { released.wait(); }, std::chrono::seconds(5) );
+    while (not Async_player::busy( ogg.get() )) {
+        std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+    }
+    BOOST_TEST( pmgr.get_player(sp_src) == ogg );
+    release.set_value();
+    op->wait_for( std::chrono::seconds(5) );
+    BOOST_TEST( (Op_status::done == op->status()) );
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 /// This has user preference customization.
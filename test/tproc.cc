@@ -1,5 +1,6 @@
 /* Test the Child_mgr:
  * - check_running features
+ * - launch latency, fork/exec versus posix_spawn (--bench)
  *
  *   Part of the rsked package.
  *
@@ -21,7 +22,9 @@
 
 
 #include <signal.h>
+#include <chrono>
 #include <iostream>
+#include <vector>
 #include "childmgr.hpp"
 #include <boost/program_options.hpp>
 
@@ -30,6 +33,7 @@
 const boost::filesystem::path BadBinaryPath {"/usr/local/bin/moggy_cat"};
 const boost::filesystem::path OggPlayerPath {"/usr/bin/ogg123"};
 const boost::filesystem::path NetcatPath { "/bin/nc" };
+const boost::filesystem::path TruePath { "/bin/true" };
 
 
 const boost::filesystem::path
@@ -119,6 +123,42 @@ spCM setup_child2( int port )
 }
 
 
+/// Compare the latency of launching children by fork/exec and by
+/// posix_spawn: start n short-lived children each way and report the
+/// time start_child() takes.  Resident ballast of mb megabytes makes
+/// the parent more like rsked, whose size is what fork has to copy.
+///
+int run_benchmark( unsigned n, unsigned mb )
+{
+    using namespace std::chrono;
+    std::vector<char> ballast( static_cast<size_t>(mb) << 20 );
+    for (size_t i=0; i < ballast.size(); i += 4096) {
+        ballast[i] = 1;         // make it resident
+    }
+    auto cm = Child_mgr::create( TruePath );
+    cm->set_name("true");
+    std::cout << "Launch " << n << " children each way, parent ballast "
+              << mb << " MB\n";
+    for (bool spawn : {false, true}) {
+        Child_mgr::set_spawn( spawn );
+        double total_us=0, max_us=0;
+        for (unsigned i=0; i<n; i++) {
+            auto t0 = steady_clock::now();
+            cm->start_child();
+            double us = duration<double,std::micro>(steady_clock::now()-t0).count();
+            total_us += us;
+            max_us = std::max( max_us, us );
+            cm->wait_for_phase( ChildPhase::gone, 1'000'000 );
+        }
+        std::cout << (spawn ? "posix_spawn: " : "fork/exec:   ")
+                  << "mean " << (total_us / std::max(n,1U)) << " us, max "
+                  << max_us << " us\n";
+    }
+    Child_mgr::kill_all();
+    return 0;
+}
+
+
 /// Run child processes and test child mgr capabilities.
 /// - cm1 : oggplayer will run until song is over or killed
 /// - cm2, cm3 : netcat listeners will run until killed or error out
@@ -128,12 +168,18 @@ int main(int ac, char **av)
     int POLL_SECS {2};
     int maxrun {0};
     int minrun {0};
+    unsigned nbench {0};
+    unsigned ballast {64};
     namespace po = boost::program_options;
     po::options_description desc("Allowed options");
     desc.add_options()
         ("help","option information")
         ("badarg","pass a bad argument to cm1 to make it die quickly")
         ("badbin","specify a bad binary for cm1 that won't execute")
+        ("bench",po::value<unsigned>(&nbench),
+         "just time this many launches, fork/exec versus posix_spawn")
+        ("ballast",po::value<unsigned>(&ballast),
+         "megabytes of resident memory for --bench (default 64)")
         ("minrun",po::value<int>(&minrun),"shortest run time for cm1")
         ("maxrun",po::value<int>(&maxrun),"longest run time for cm1");
 
@@ -146,6 +192,12 @@ int main(int ac, char **av)
         exit(0);
     }
 
+    if (nbench) {
+        init_logging("tproc","tproc_%2N.log",LF_FILE);
+        int rc = run_benchmark( nbench, ballast );
+        finish_logging();
+        return rc;
+    }
     init_logging("tproc","tproc_%2N.log",LF_CONSOLE|LF_DEBUG);
     LOG_INFO(Lgr) << "Create Player Child '" << OggPlayerPath << "'";
     setup_sigterm_handler();
@@ -11,8 +11,11 @@
 
 
 #include "util/chpty.hpp"
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <unistd.h>
+#include <sys/wait.h>
 
 
 const char* VlcBinary = "/usr/bin/vlc";
@@ -63,3 +66,56 @@ BOOST_AUTO_TEST_CASE( run_vlc_cli )
         do_parent(pty,pid);
     }
 }
+
+
+/// A shell loop stands in for the vlc cli, answering each line and
+/// then prompting. read_until() returns once the prompt arrives, while
+/// read_nb() always lingers for its read timeout.
+///
+BOOST_AUTO_TEST_CASE( read_until_prompt )
+{
+    using namespace std::chrono;
+    const long timeout_us { 200'000 };
+    Pty_controller pty;
+    pty.open_pty();
+    pty.set_read_timeout( 0, timeout_us );
+
+    int pid = fork();
+    BOOST_REQUIRE(-1 != pid);
+    if (0 == pid) {
+        pty.child_init();
+        execl( "/bin/sh", "sh", "-c",
+               "printf '> '; while read l; do echo \"( $l )\"; printf '> '; done",
+               (char*) NULL );
+        _exit(1);
+    }
+    std::string result{};
+    BOOST_TEST( pty.read_until( result, 2048, "> ", 2'000'000 ) );
+
+    result.clear();
+    auto t0 = steady_clock::now();
+    pty.write_nb( "status\n" );
+    BOOST_TEST( pty.read_until( result, 2048, "> ", 2'000'000 ) );
+    auto framed = duration_cast<microseconds>( steady_clock::now() - t0 ).count();
+    BOOST_TEST( result.npos != result.find("( status )") );
+
+    result.clear();
+    t0 = steady_clock::now();
+    pty.write_nb( "status\n" );
+    pty.read_nb( result, 2048 );
+    auto unframed = duration_cast<microseconds>( steady_clock::now() - t0 ).count();
+    BOOST_TEST( result.npos != result.find("( status )") );
+    std::cout << "framed " << framed << " us, unframed " << unframed << " us\n";
+    BOOST_TEST( framed < timeout_us );
+    BOOST_TEST( unframed >= timeout_us );
+
+    // A reply nobody read is discarded, and a missing prompt times out.
+    pty.write_nb( "late\n" );
+    usleep( 100'000 );
+    BOOST_TEST( pty.discard() > 0 );
+    result.clear();
+    BOOST_TEST( not pty.read_until( result, 2048, "> ", 50'000 ) );
+
+    kill( pid, SIGKILL );
+    waitpid( pid, nullptr, 0 );
+}
@@ -0,0 +1,382 @@
+/// Simulate rsked tracking its schedule over days of virtual time,
+/// with fake players, and print every player transition. Run as:
+///
+///    tsim [--config ../test/tsim.json] [--days 7]
+///         [--start "2021-01-03 00:00"] [--button "2021-01-04 08:00"]...
+///         [--broken cms]... [--quiet] [--debug]
+///
+/// The trace goes to standard output, so it may be compared with a
+/// saved copy after a change to the schedule or scheduler. Set TZ to
+/// get a trace that does not depend on the local time zone.
+
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "logging.hpp"
+#include "clock.hpp"
+#include "rsked.hpp"
+#include "playermgr.hpp"
+#include "vurunner.hpp"
+
+namespace po = boost::program_options;
+
+
+///////////////////////////////// Main stand-ins //////////////////////////////
+
+std::unique_ptr<Rsked> Main::rsked {};
+const char *Main::AppName { "tsim" };
+::std::string Main::DefaultConfigPath { "../test/tsim.json" };
+bool Main::Terminate = false;
+int  Main::gTermSignal = 0;
+bool Main::Button1 = false;
+bool Main::ReloadReq = false;
+
+void Main::block_signals(bool) { }
+void Main::log_banner(bool) { }
+
+void Main::note_signal(int s)
+{
+    if (SIGUSR1 == s) {
+        Main::Button1 = true;
+    } else if (SIGHUP == s) {
+        Main::ReloadReq = true;
+    } else {
+        Main::Terminate = true;
+        Main::gTermSignal = s;
+    }
+}
+
+
+///////////////////////////////// Trace ///////////////////////////////////////
+
+/// Simulation bookkeeping shared by the clock and the fake players.
+///
+struct Sim_state {
+    bool quiet {false};                   // suppress the trace
+    std::set<std::string> broken {};      // sources that fail to play
+    unsigned plays {0};                   // sources started
+    unsigned failures {0};                // plays refused (broken)
+    unsigned long ticks {0};              // rests taken
+};
+
+static Sim_state Sim {};
+
+
+/// Print one trace line stamped with the virtual local time.
+///
+static void trace( const char *what, const std::string &who,
+                   const std::string &detail )
+{
+    if (Sim.quiet) return;
+    struct tm ltm;
+    Clock::local( ltm );
+    char stamp[40] = {0};
+    strftime( stamp, sizeof(stamp), "%a %Y-%m-%d %H:%M:%S", &ltm );
+    std::cout << stamp << "  " << what << "  " << who;
+    if (not detail.empty()) {
+        std::cout << "  {" << detail << "}";
+    }
+    std::cout << "\n";
+}
+
+
+///////////////////////////////// Sim_clock ///////////////////////////////////
+
+/// Virtual clock that presses the snooze button at requested times and
+/// terminates rsked at the end of the simulated period.
+///
+class Sim_clock : public Virtual_clock {
+private:
+    time_t m_end;
+    std::deque<time_t> m_presses;    // sorted
+public:
+    bool rest( const struct timespec &ts ) override {
+        Virtual_clock::rest( ts );
+        ++Sim.ticks;
+        while (not m_presses.empty() and m_presses.front() <= now()) {
+            m_presses.pop_front();
+            trace( "button", "Snooze", "" );
+            Main::Button1 = true;
+        }
+        if (now() >= m_end) {
+            Main::Terminate = true;
+        }
+        return true;
+    }
+    Sim_clock( time_t start, time_t end, std::deque<time_t> presses )
+        : Virtual_clock(start), m_end(end), m_presses(std::move(presses)) {}
+};
+
+
+///////////////////////////////// Sim_player //////////////////////////////////
+
+/// Player that plays anything instantly. Sources without repeat finish
+/// after their declared duration (of virtual time); sources listed as
+/// broken throw a Player_media_exception.
+///
+class Sim_player : public Player_with_caps {
+private:
+    std::string m_name;
+    spSource m_src {};
+    PlayerState m_state {PlayerState::Stopped};
+    time_t m_started {0};
+public:
+    const std::string& name() const override { return m_name; }
+    bool completed() override {
+        if (not m_src or m_src->repeatp()) return false;
+        auto secs = static_cast<time_t>( ceil(m_src->duration()) );
+        return ((Clock::now() - m_started) >= secs);
+    }
+    bool currently_playing( spSource src ) override {
+        return (src and src == m_src and m_state != PlayerState::Stopped);
+    }
+    void exit() override { stop(); }
+    void initialize( Config&, bool ) override { }
+    bool is_usable() override { return true; }
+    void pause() override {
+        if (PlayerState::Playing == m_state) {
+            m_state = PlayerState::Paused;
+            trace( "pause ", m_name, "" );
+        }
+    }
+    void play( spSource src ) override {
+        if (not src) {
+            stop();
+            return;
+        }
+        if (Sim.broken.count( src->name() )) {
+            ++Sim.failures;
+            trace( "fail  ", m_name, src->name() );
+            throw Player_media_exception();
+        }
+        m_src = src;
+        m_state = PlayerState::Playing;
+        m_started = Clock::now();
+        ++Sim.plays;
+        trace( "play  ", m_name, src->name() );
+    }
+    void prepare( spSource src ) override {
+        trace( "prep  ", m_name, (src ? src->name() : "") );
+    }
+    void resume() override {
+        if (PlayerState::Paused == m_state) {
+            m_state = PlayerState::Playing;
+            trace( "resume", m_name, "" );
+        }
+    }
+    PlayerState state() override { return m_state; }
+    void stop() override {
+        if (PlayerState::Stopped != m_state) {
+            trace( "stop  ", m_name, "" );
+        }
+        m_state = PlayerState::Stopped;
+        m_src.reset();
+    }
+    bool check() override { return true; }
+    bool is_enabled() const override { return true; }
+    bool set_enabled( bool ) override { return true; }
+    //
+    explicit Sim_player( const char *nm ) : m_name(nm) { }
+};
+
+/// proforma dtor
+Player::~Player() { }
+
+
+///////////////////////////// Player_manager //////////////////////////////////
+
+/// A player manager with three simulated players: silence, everything
+/// else, and the annunciator.
+
+Player_manager::Player_manager()
+{
+    for (const char *nm : {"Silent_player", "Sim_player", "Annunciator"}) {
+        m_players[nm] = std::make_shared<Sim_player>( nm );
+    }
+}
+
+Player_manager::~Player_manager() { }
+
+void Player_manager::configure( Config&, bool ) { }
+
+bool Player_manager::check_players() { return true; }
+
+int Player_manager::events_fd() const { return -1; }
+
+void Player_manager::handle_events() { }
+
+spPlayer Player_manager::get_annunciator()
+{
+    return m_players["Annunciator"];
+}
+
+spPlayer Player_manager::get_sked_annunciator()
+{
+    return m_players["Annunciator"];
+}
+
+spPlayer Player_manager::get_player( spSource src )
+{
+    if (not src or Medium::off == src->medium()) {
+        return m_players["Silent_player"];
+    }
+    return m_players["Sim_player"];
+}
+
+bool Player_manager::inet_available() { return true; }
+
+void Player_manager::note_play( const spPlayer&, const spSource&, double, bool ) { }
+
+Async_player& Player_manager::async_player( const spPlayer &player )
+{
+    auto &ap = m_async[ player.get() ];
+    if (not ap) {
+        ap = std::make_unique<Async_player>( player );
+    }
+    return *ap;
+}
+
+
+///////////////////////////// VU_runner ///////////////////////////////////////
+
+/// There is no audio, so no VU monitor.
+class VU_checker { };
+
+VU_runner::VU_runner() { m_enabled = false; }
+VU_runner::~VU_runner() { }
+void VU_runner::configure( Config&, bool ) { m_enabled = false; }
+bool VU_runner::too_quiet() { return false; }
+
+
+///////////////////////////////// Main ////////////////////////////////////////
+
+/// Parse local time "YYYY-MM-DD HH:MM" into t.  Return false if invalid.
+///
+static bool parse_time( const std::string &s, time_t &t )
+{
+    struct tm ltm {};
+    const char *end = strptime( s.c_str(), "%Y-%m-%d %H:%M", &ltm );
+    if (not end or *end) {
+        return false;
+    }
+    ltm.tm_isdst = -1;
+    t = mktime( &ltm );
+    return (t != time_t(-1));
+}
+
+
+int main(int ac, char **av)
+{
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help", "show help message")
+        ("config",po::value<std::string>(),"use a particular config file")
+        ("schedule",po::value<std::string>(),"override schedule json file")
+        ("start",po::value<std::string>(),
+         "local start time YYYY-MM-DD HH:MM (default 2021-01-03 00:00)")
+        ("days",po::value<unsigned>(),"days to simulate (default 7)")
+        ("button",po::value<std::vector<std::string>>(),
+         "press snooze at local time YYYY-MM-DD HH:MM (repeatable)")
+        ("broken",po::value<std::vector<std::string>>(),
+         "source that fails whenever played (repeatable)")
+        ("quiet","print only the summary")
+        ("debug","debug level logging");
+    po::variables_map vm;
+    try {
+        po::store( po::parse_command_line(ac,av,desc),vm);
+        po::notify(vm);
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << "\n" << desc << "\n";
+        return 1;
+    }
+    if (vm.count("help")) {
+        std::cout << desc << "\n";
+        return 0;
+    }
+    std::string start_str { "2021-01-03 00:00" };
+    if (vm.count("start")) {
+        start_str = vm["start"].as<std::string>();
+    }
+    time_t start {0};
+    if (not parse_time( start_str, start )) {
+        std::cerr << "Invalid start time: " << start_str << "\n";
+        return 1;
+    }
+    unsigned days = (vm.count("days") ? vm["days"].as<unsigned>() : 7);
+    std::deque<time_t> presses {};
+    if (vm.count("button")) {
+        for (const auto &b : vm["button"].as<std::vector<std::string>>()) {
+            time_t t {0};
+            if (not parse_time( b, t )) {
+                std::cerr << "Invalid button time: " << b << "\n";
+                return 1;
+            }
+            presses.push_back( t );
+        }
+        std::sort( presses.begin(), presses.end() );
+    }
+    if (vm.count("broken")) {
+        for (const auto &b : vm["broken"].as<std::vector<std::string>>()) {
+            Sim.broken.insert( b );
+        }
+    }
+    Sim.quiet = (vm.count("quiet") > 0);
+
+    int log_mode = LF_FILE;
+    if (vm.count("debug")) { log_mode |= LF_DEBUG; }
+    init_logging( Main::AppName, "tsim_%5N.log", log_mode );
+
+    time_t end = start + static_cast<time_t>(days) * SecsPerDay;
+    Clock::install( std::make_shared<Sim_clock>( start, end, presses ) );
+    int rc = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    try {
+        Main::rsked = std::make_unique<Rsked>( IPC_PRIVATE, true );
+        std::string cfg { Main::DefaultConfigPath };
+        if (vm.count("config")) {
+            cfg = vm["config"].as<std::string>();
+        }
+        Main::rsked->configure( cfg, vm );
+        Main::rsked->track_schedule();
+    } catch (const std::exception &ex) {
+        std::cerr << "Simulation failed: " << ex.what() << "\n";
+        rc = 2;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0 ).count();
+    Main::rsked.reset();
+    Clock::install( nullptr );
+    std::cout << "# " << days << " days simulated in " << ms << " ms: "
+              << Sim.ticks << " ticks, " << Sim.plays << " plays, "
+              << Sim.failures << " failures\n";
+    LOG_INFO(Lgr) << "Simulated " << days << " days in " << ms << " ms";
+    finish_logging();
+    return rc;
+}
@@ -30,7 +30,11 @@
 #include <boost/test/data/test_case.hpp>
 #include <boost/test/data/monomorphic.hpp>
 
+#include <chrono>
+#include <boost/filesystem/fstream.hpp>
+
 #include "schedule.hpp"
+#include "clock.hpp"
 
 
 namespace bdata = boost::unit_test::data;
@@ -120,8 +124,9 @@ const char* badskeds[] = {
     "../test/sked-test5.json",
     "../test/sked-test6.json",
     "../test/sked-test7.json",
-    "../test/sked-test8.json"
-    // "../test/sked-test9.json"
+    "../test/sked-test8.json",
+    // "../test/sked-test9.json",
+    "../test/sked-test10.json"
 };
 
 /// Load should throw. Schedule should be marked as not valid.
@@ -214,3 +219,250 @@ BOOST_AUTO_TEST_CASE( Multi_announce )
     BOOST_TEST(test_time( sched,  119,  Sun, 21,00,00, "OFF" ));
     BOOST_TEST(test_time( sched,  119,  Sun, 23,59,59, "OFF" ));
 }
+
+
+/// Check the time remaining until the next slot transition, including
+/// the wrap from Saturday night to Sunday morning.
+///
+BOOST_AUTO_TEST_CASE( Transition_probe )
+{
+    Schedule sched;
+    LOG_INFO(Lgr) << "Unit test: Transition_probe";
+    sched.load(TestSchedule1);
+
+    BOOST_TEST( sched.secs_to_transition( mktime(120, Mon, 7,29,59) ) == 1U );
+    BOOST_TEST( sched.secs_to_transition( mktime(120, Mon, 7,30,00) ) == 5400U );
+    BOOST_TEST( sched.secs_to_transition( mktime(125, Sat,21,00,00) ) == 3*3600U );
+    BOOST_TEST( sched.secs_to_transition( mktime(125, Sat,23,59,59) ) == 1U );
+}
+
+
+/// Reference implementation: locate the slot in effect by scanning the
+/// day program from its first slot, as play_daytime formerly did.
+///
+static unsigned scan_slot( const Schedule &sched, unsigned wd, unsigned sec )
+{
+    const auto &slots = sched.day_program(wd).m_slots;
+    unsigned u = 0;
+    while (u+1 < slots.size() and sec >= slots[u+1]->start_day_sec()) {
+        ++u;
+    }
+    return u;
+}
+
+/// Write a dense schedule: a program or announcement every 5 minutes,
+/// every day of the week.
+///
+static void write_dense_schedule( const boost::filesystem::path &p )
+{
+    boost::filesystem::ofstream out(p);
+    out << "{ \"schema\":\"2.0\", \"version\":\"bench\",\n"
+        << "\"sources\": {\n"
+        << " \"kfai\": {\"encoding\":\"wfm\",\"medium\":\"radio\","
+           "\"location\":90.3},\n"
+        << " \"news\": {\"encoding\":\"mp3\",\"medium\":\"stream\","
+           "\"announcement\":true,\"location\":\"http://localhost/n.mp3\"}\n"
+        << "},\n\"dayprograms\": {\n";
+    for (unsigned d=Sun; d<DaysPerWeek; d++) {
+        out << " \"" << DayNames[d] << "\": [\n";
+        for (unsigned m=0; m < 24*60; m += 5) {
+            out << "  {\"start\":\"" << std::setfill('0') << std::setw(2)
+                << (m/60) << ":" << std::setw(2) << (m%60) << "\", "
+                << ((m/5)%2 ? "\"announce\":\"news\"" : "\"program\":\"kfai\"")
+                << "}" << ((m+5 < 24*60) ? ",\n" : "\n");
+        }
+        out << " ]" << ((d+1 < DaysPerWeek) ? ",\n" : "\n");
+    }
+    out << "}}\n";
+}
+
+/// Compare the timeline index against a linear scan of the day program:
+/// results must agree everywhere, and the timing of each is logged.
+///
+BOOST_AUTO_TEST_CASE( Timeline_bench )
+{
+    using Steady = std::chrono::steady_clock;
+    LOG_INFO(Lgr) << "Unit test: Timeline_bench";
+    boost::filesystem::path skedpath
+        = boost::filesystem::temp_directory_path()
+        / boost::filesystem::unique_path("tsked-%%%%-%%%%.json");
+    write_dense_schedule( skedpath );
+    Schedule sched;
+    sched.load( skedpath );
+    boost::filesystem::remove( skedpath );
+    BOOST_TEST( sched.timeline().size() == 7U*288 );
+
+    const Week_timeline &tl { sched.timeline() };
+    constexpr unsigned Step = 37;    // seconds between probes
+    unsigned mismatch = 0;
+    for (unsigned ws=0; ws < SecsPerWeek; ws += Step) {
+        const auto &mark = tl.at(ws);
+        if (mark.day != ws/SecsPerDay
+            or mark.slot != scan_slot(sched, ws/SecsPerDay, ws%SecsPerDay)) {
+            ++mismatch;
+        }
+    }
+    BOOST_TEST( mismatch == 0U );
+
+    unsigned long sum_scan = 0, sum_index = 0;
+    auto t0 = Steady::now();
+    for (unsigned ws=0; ws < SecsPerWeek; ws += Step) {
+        sum_scan += scan_slot(sched, ws/SecsPerDay, ws%SecsPerDay);
+    }
+    auto t1 = Steady::now();
+    for (unsigned ws=0; ws < SecsPerWeek; ws += Step) {
+        sum_index += tl.at(ws).slot;
+    }
+    auto t2 = Steady::now();
+    BOOST_TEST( sum_scan == sum_index );
+
+    using std::chrono::nanoseconds;
+    using std::chrono::duration_cast;
+    const auto nprobe = SecsPerWeek/Step + 1;
+    LOG_INFO(Lgr) << "Timeline_bench: " << nprobe << " lookups, scan "
+                  << duration_cast<nanoseconds>(t1-t0).count()/nprobe
+                  << " ns/lookup, index "
+                  << duration_cast<nanoseconds>(t2-t1).count()/nprobe
+                  << " ns/lookup";
+}
+
+
+/// Reloading the same schedule carries over failure marks (the very
+/// same Source objects are retained) and announcement completion.
+///
+BOOST_AUTO_TEST_CASE( Reload_carry_over )
+{
+    LOG_INFO(Lgr) << "Unit test: Reload_carry_over";
+    Schedule olds;
+    olds.load(TestSchedule1);
+
+    spPlay_slot slot { olds.play_daytime( mktime(120, Mon, 15,15,0) ) };
+    spSource cms = slot->source();
+    BOOST_TEST( cms->name() == "cms" );
+    cms->mark_failed();
+    BOOST_TEST(test_time( olds, 120, Mon, 15,30,02, "motd-ymd" )); // completes
+
+    Schedule news { olds.resource_watcher() };   // as Rsked reloads
+    news.load(TestSchedule1);
+    news.carry_over( olds );
+    BOOST_TEST( news.resource_watcher() == olds.resource_watcher() );
+
+    slot = news.play_daytime( mktime(120, Mon, 15,15,0) );
+    BOOST_TEST( slot->source()->name() == "ksjn" );  // cms still failed
+    cms->mark_failed(false);
+    slot = news.play_daytime( mktime(120, Mon, 15,15,0) );
+    BOOST_TEST( slot->source() == cms );             // same object
+    BOOST_TEST(test_time( news, 120, Mon, 15,30,03, "cms" ));
+}
+
+
+/// A schedule saved in compiled form restores to the same schedule;
+/// a compiled file that no longer matches its JSON is refused.
+///
+BOOST_AUTO_TEST_CASE( Compiled_schedule )
+{
+    namespace fs = boost::filesystem;
+    LOG_INFO(Lgr) << "Unit test: Compiled_schedule";
+    fs::path dir = fs::temp_directory_path() / fs::unique_path("tsked-%%%%-%%%%");
+    fs::create_directory( dir );
+    fs::path json = dir / "schedule.json";
+    fs::copy_file( TestSchedule1, json );
+    fs::path skedc = Schedule::compiled_path( json );
+    BOOST_TEST( skedc.filename() == "schedule.skedc" );
+
+    Schedule jsched;
+    jsched.load( json );
+    BOOST_TEST( not Schedule().load_compiled( json, skedc ) ); // none yet
+    jsched.save_compiled( json, skedc );
+
+    Schedule csched;
+    BOOST_TEST( csched.load_compiled( json, skedc ) );
+    BOOST_TEST( csched.valid() );
+    BOOST_TEST( csched.timeline().size() == jsched.timeline().size() );
+    BOOST_TEST(test_time( csched,  120,  Mon,  7,30,00, "cms" ));
+    BOOST_TEST(test_time( csched,  120,  Mon, 12,00,00, "dnow" ));
+    BOOST_TEST(test_time( csched,  120,  Mon, 15,30,02, "motd-ymd" ));
+    BOOST_TEST(test_time( csched,  120,  Mon, 21,00,00, "OFF" ));
+    spSource cms = csched.find_viable_source("cms");
+    BOOST_TEST( cms->resource() == "http://cms.stream.publicradio.org/cms.mp3" );
+    BOOST_TEST( cms->alternate() == "ksjn" );
+    BOOST_TEST( cms->repeatp() );
+    BOOST_TEST( csched.get_respathspec()->get_libpath()
+                == jsched.get_respathspec()->get_libpath() );
+
+    {   // change the JSON: compiled file is now stale
+        boost::filesystem::ofstream out( json, std::ios::app );
+        out << "\n";
+    }
+    BOOST_TEST( not Schedule().load_compiled( json, skedc ) );
+
+    jsched.save_compiled( json, skedc );   // fresh again, then damage it
+    fs::resize_file( skedc, fs::file_size(skedc) / 2 );
+    BOOST_TEST( not Schedule().load_compiled( json, skedc ) );
+    fs::remove_all( dir );
+}
+
+
+/// play_now() resolves the schedule once per slot, and again only
+/// when a source fails or its retry time comes around.
+///
+BOOST_AUTO_TEST_CASE( Play_now_memo )
+{
+    LOG_INFO(Lgr) << "Unit test: Play_now_memo";
+    struct tm ltm {};
+    ltm.tm_year = 121; ltm.tm_mon = 0; ltm.tm_mday = 5;  // Tue 2021-01-05
+    ltm.tm_hour = 15; ltm.tm_isdst = -1;
+    auto vc = std::make_shared<Virtual_clock>( mktime(&ltm) );
+    Clock::install( vc );
+
+    Schedule sched;
+    sched.load(TestSchedule1);
+    spPlay_slot slot = sched.play_now();
+    BOOST_TEST( slot->source()->name() == "cms" );
+    for (unsigned i=0; i<1000; i++) {
+        vc->advance( 2 );
+        BOOST_TEST_REQUIRE( sched.play_now() == slot );
+    }
+    BOOST_TEST( sched.resolutions() == 1U );
+
+    spSource cms = slot->source();
+    cms->mark_failed();                              // invalidates
+    BOOST_TEST( sched.play_now()->source()->name() == "ksjn" );
+    BOOST_TEST( sched.resolutions() == 2U );
+    vc->advance( 3601 );                             // retry time is up
+    BOOST_TEST( sched.play_now()->source() == cms );
+    BOOST_TEST( sched.resolutions() == 3U );
+
+    vc->set( mktime(&ltm) + 6*3600 );                // 21:00 OFF
+    BOOST_TEST( sched.play_now()->name() == "OFF" );
+    Clock::install( nullptr );
+}
+
+
+/// peek_next() names the source of a slot starting within the horizon,
+/// skipping announcements, without disturbing play_now().
+///
+BOOST_AUTO_TEST_CASE( Peek_next )
+{
+    LOG_INFO(Lgr) << "Unit test: Peek_next";
+    struct tm ltm {};
+    ltm.tm_year = 121; ltm.tm_mon = 0; ltm.tm_mday = 5;  // Tue 2021-01-05
+    ltm.tm_hour = 13; ltm.tm_min = 59; ltm.tm_sec = 40; ltm.tm_isdst = -1;
+    time_t t = mktime(&ltm);
+    auto vc = std::make_shared<Virtual_clock>( t );
+    Clock::install( vc );
+
+    Schedule sched;
+    sched.load(TestSchedule1);
+    time_t start {0};
+    BOOST_TEST( not sched.peek_next( t, 10, start ) );
+    spSource next = sched.peek_next( t, 30, start );
+    BOOST_REQUIRE( next );
+    BOOST_TEST( next->name() == "nis" );
+    BOOST_TEST( start == t + 20 );
+    BOOST_TEST( sched.resolutions() == 0U );
+
+    // 13:30 is an announcement: nothing to prepare
+    BOOST_TEST( not sched.peek_next( t - 1800, 60, start ) );
+    Clock::install( nullptr );
+}
@@ -32,9 +32,11 @@
 
 #include <cstring>
 #include <memory>
+#include <boost/filesystem/fstream.hpp>
 
 #include "logging.hpp"
 #include "source.hpp"
+#include "reswatch.hpp"
 
 /* jsoncpp */
 #include <json/json.h>
@@ -230,3 +232,43 @@ BOOST_DATA_TEST_CASE( Valid_json, bdata::make(good_sources), src_str )
 {
     BOOST_TEST( test_create(src_str) );
 }
+
+
+/// The resource watcher answers repeated questions from memory, but
+/// notices files and directories that come and go.
+///
+BOOST_AUTO_TEST_CASE( Watched_existence )
+{
+    namespace fs = boost::filesystem;
+    fs::path dir = fs::temp_directory_path() / fs::unique_path("tsrc-%%%%-%%%%");
+    fs::create_directory( dir );
+    fs::path file = dir / "song.ogg";
+    fs::path deep = dir / "album" / "track.ogg";
+
+    Res_watcher rw {};
+    BOOST_REQUIRE( rw.enabled() );
+    BOOST_TEST( not rw.exists( file ) );
+    BOOST_TEST( not rw.exists( deep ) );
+    unsigned long nstats = rw.stats();
+    for (unsigned i=0; i<100; i++) {
+        BOOST_TEST_REQUIRE( not rw.exists( file ) );
+    }
+    BOOST_TEST( rw.stats() == nstats );      // no filesystem calls
+
+    fs::ofstream( file ) << "x";
+    BOOST_TEST( rw.exists( file ) );
+    fs::create_directory( dir / "album" );
+    fs::ofstream( deep ) << "x";
+    BOOST_TEST( rw.exists( deep ) );
+    nstats = rw.stats();
+    BOOST_TEST( rw.exists( deep ) );
+    BOOST_TEST( rw.stats() == nstats );
+
+    unsigned long nchanges = rw.changes();
+    fs::remove_all( dir / "album" );
+    BOOST_TEST( not rw.exists( deep ) );
+    BOOST_TEST( rw.changes() > nchanges );
+    fs::remove( file );
+    BOOST_TEST( not rw.exists( file ) );
+    fs::remove_all( dir );
+}
@@ -1,6 +1,10 @@
 /// Test the VLC player class
 ///
 ///  ./tvlc --log_level=all
+///
+/// Command round trip latency, framed by the cli prompt versus not:
+///
+///  ./tvlc --run_test=vlc_command_latency
 
 
 /*   Part of the rsked package.
@@ -29,6 +33,8 @@
 #include <boost/test/unit_test.hpp>
 #include <boost/test/data/test_case.hpp>
 #include <boost/test/data/monomorphic.hpp>
+#include <chrono>
+#include <iostream>
 #include <memory>
 #include <json/json.h>  /* jsoncpp */
 
@@ -308,3 +314,45 @@ BOOST_AUTO_TEST_CASE( vlc_play_pause_resume_test, * utf::disabled()   )
     BOOST_TEST( do_mp3_stream(vlcp,10) );
 
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+/// Mean round trip in ms of n status checks and n volume changes on
+/// an idle vlc run by the player configured in section.
+///
+double command_latency( Config &cfg, const char *section, unsigned n )
+{
+    spPlayer vlcp = std::make_shared<Vlc_player>( section );
+    vlcp->initialize( cfg, false );  // testp=false
+    BOOST_REQUIRE( vlcp->check() );  // starts vlc
+    using namespace std::chrono;
+    double max_ms {0.0};
+    auto t0 = steady_clock::now();
+    for (unsigned i=0; i<n; i++) {
+        auto t1 = steady_clock::now();
+        BOOST_TEST( vlcp->check() );
+        vlcp->set_volume( (i % 2) ? 90U : 100U );
+        max_ms = std::max( max_ms, duration<double,std::milli>(
+                               steady_clock::now() - t1 ).count() / 2.0 );
+    }
+    double mean_ms = duration<double,std::milli>( steady_clock::now() - t0 ).count()
+        / (2.0 * n);
+    std::cout << section << ": " << (2*n) << " commands, mean "
+              << mean_ms << " ms, max " << max_ms << " ms\n";
+    vlcp->exit();
+    return mean_ms;
+}
+
+/// Replies framed by the prompt need not wait out the read timeout.
+///
+BOOST_AUTO_TEST_CASE( vlc_command_latency )
+{
+    const char *confname = "../test/vlc.json";
+    Config cfg(confname);
+    cfg.read_config();
+
+    const unsigned n = 50;
+    double unframed = command_latency( cfg, "Vlc_unframed", n );
+    double framed = command_latency( cfg, "Vlc_framed", n );
+    BOOST_TEST( framed < unframed );
+}
@@ -0,0 +1,333 @@
+/// Test the VLC reply parsers (vlcparse.cc) against the regular
+/// expressions they replaced, on the replies in vlc-replies.txt, and
+/// time both.  Run as:
+///
+///    tvlcparse  --log_level=all
+
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/// Dynamically link boost test framework
+#define BOOST_TEST_MODULE vlcparse_test
+#ifndef BOOST_TEST_DYN_LINK
+#define BOOST_TEST_DYN_LINK 1
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <boost/regex.hpp>
+
+#include "logging.hpp"
+#include "player.hpp"
+#include "vlcparse.hpp"
+
+
+/// Count heap allocations while Counting is set.  (GCC cannot see
+/// that these new and delete operators are a matched pair.)
+///
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+static std::atomic<bool> Counting {false};
+static std::atomic<unsigned long> Allocs {0};
+
+void* operator new( std::size_t n )
+{
+    if (Counting) { ++Allocs; }
+    if (void *p = std::malloc( n ? n : 1 )) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete( void *p ) noexcept { std::free( p ); }
+void operator delete( void *p, std::size_t ) noexcept { std::free( p ); }
+
+
+/// Simple test fixture that just handles logging setup/teardown.
+///
+struct LogFixture {
+    LogFixture() {
+        init_logging("tvlcparse","tvlcparse_%5N.log",LF_FILE|LF_DEBUG|LF_CONSOLE);
+    }
+    ~LogFixture() {
+        finish_logging();
+    }
+};
+
+BOOST_TEST_GLOBAL_FIXTURE(LogFixture);
+
+
+////////////////////////// Reference: the regex parsers ///////////////////////
+
+/// this is used to parse vlc status messages from cli interface
+///
+static boost::regex Status_regex(R"*(
+^ \( \s* (state|(?:audio \s volume)|(?:new \s input)) [:]* \s+
+  ( [^)]+ ) \s+ \) $)*",  boost::regex::mod_x);
+
+/// look for an unsigned decimal number on a line by itself:
+///
+static boost::regex
+Unsigned_regex(R"*( ^ \s* (\d+) \s* $ )*", boost::regex::mod_x);
+
+
+/// Extract an unsigned integer appearing on a line by itself.
+/// Sets parameter u to the parsed integer and return true on success.
+/// If more than one integer is present, only the first will be parsed.
+/// Returns false if no integer was found.
+///
+/// * May throw  std::runtime_error in very rare circumstances
+///
+static bool parse_unsigned( const std::string &resp, unsigned long &u )
+{
+   boost::match_results<std::string::const_iterator> what;
+   boost::match_flag_type flags = boost::match_default;
+
+   if (regex_search(resp.begin(),resp.end(),what,Unsigned_regex,flags))
+   {
+       std::string snumber(what[1].first, what[1].second);
+       try {
+           u = std::stoul( snumber ); // can throw std::invalid_argument
+       }
+       catch( std::invalid_argument & ) { // unlikely
+           LOG_DEBUG(Lgr) << "parse_unsigned: invalid int '"
+                          << snumber << "'";
+           return false;
+       }
+       return true;
+   }
+   // LOG_DEBUG(Lgr) << "parse_unsigned: no match for:" << resp;
+   return false;
+}
+
+
+/// Takes apart the status response into state, volume and resource
+///  'stopped' : PlayerState::Stopped
+///  'playing' : PlayerState::Playing
+///  'paused'  : PlayerState::Paused
+/// Returns true if a normal status response is parsed, othewise false.
+///
+/// * May throw std::runtime_error in VERY rare circumstances
+///
+static bool
+parse_status( const std::string &sresp1, PlayerState &pstate,
+                   unsigned &obsvol, std::string &resource)
+{
+   std::string::const_iterator start, end;
+   start = sresp1.begin();
+   end = sresp1.end();
+   boost::match_results<std::string::const_iterator> what;
+   boost::match_flag_type flags = boost::match_default;
+   bool parsedp {false};
+
+   while(regex_search(start, end, what, Status_regex, flags))
+   {
+       std::string skey(what[1].first, what[1].second);
+       std::string sval(what[2].first, what[2].second);
+       parsedp = true;
+       if (skey == "audio volume") {
+           try {
+               obsvol = static_cast<unsigned>( std::stoul(sval) );
+               // can throw std::invalid_argument
+           } catch(...) {
+               LOG_WARNING(Lgr) << "Vlc reports odd volume: " << sval;
+           }
+       }
+       else if (skey == "status") {
+           if ("stopped" == sval) { pstate = PlayerState::Stopped; }
+           else if ("playing" == sval) { pstate = PlayerState::Playing; }
+           else if ("paused" == sval) { pstate = PlayerState::Paused; }
+           else {
+               LOG_ERROR(Lgr) << "VLC unexpected status: '" << sval << "'";
+               pstate=PlayerState::Broken;
+           }
+       }
+       else if (skey == "new input") {
+           resource = sval;   // TODO: maybe trim any file:// prefix?
+       }
+       start = what[0].second;  // move to the next sexpr
+       flags |= boost::match_prev_avail;
+       flags |= boost::match_not_bob;
+   }
+   return parsedp;
+}
+
+/// Look for any of the known error strings from the (English language)
+/// vlc cli response in string resp. Return true iff an error id detected.
+///
+static bool detect_vlc_error( const std::string &resp )
+{
+    static boost::regex
+        err_regex(R"*( ^ [E|e]rror | (filesystem|access) \s stream \s error )*",
+                  boost::regex::mod_x);
+    boost::match_results<std::string::const_iterator> what;
+    boost::match_flag_type flags = boost::match_default;
+
+    return regex_search( resp.begin(), resp.end(), what, err_regex, flags );
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/// Load the replies from the transcript file, each also with its
+/// lines ended by "\r\n" as a pty would.
+///
+static std::vector<std::string> load_replies()
+{
+    std::ifstream in( "../test/vlc-replies.txt" );
+    BOOST_REQUIRE( in );
+    std::vector<std::string> replies;
+    std::string line, reply;
+    bool started {false};
+    while (std::getline( in, line )) {
+        if (line == "%%") {
+            if (started) {
+                replies.push_back( reply );
+            }
+            started = true;
+            reply.clear();
+        } else if (started) {
+            reply += line;
+            reply += "\n";
+        }
+    }
+    size_t n = replies.size();
+    for (size_t i=0; i<n; i++) {
+        std::string crlf;
+        for (char c : replies[i]) {
+            if ('\n' == c) { crlf += '\r'; }
+            crlf += c;
+        }
+        replies.push_back( crlf );
+    }
+    return replies;
+}
+
+
+/// Both parsers agree on every reply.
+///
+BOOST_AUTO_TEST_CASE( same_as_regex )
+{
+    auto replies = load_replies();
+    BOOST_TEST( replies.size() >= 40U );
+    unsigned nerrs {0}, nstatus {0}, nunsigned {0};
+    for (const auto &r : replies) {
+        BOOST_TEST_CONTEXT( "reply: " << r ) {
+            bool err = detect_vlc_error( r );
+            BOOST_TEST( vlc_detect_error( r ) == err );
+            nerrs += err;
+
+            PlayerState ps { PlayerState::Stopped };
+            unsigned vol1 {1}, vol2 {1};
+            std::string res1 {"none"}, res2 {"none"};
+            bool st = parse_status( r, ps, vol1, res1 );
+            BOOST_TEST( vlc_parse_status( r, vol2, res2 ) == st );
+            BOOST_TEST( vol1 == vol2 );
+            BOOST_TEST( res1 == res2 );
+            BOOST_TEST( (ps == PlayerState::Stopped) );  // never parsed
+            nstatus += st;
+
+            unsigned long u1 {7}, u2 {7};
+            bool un = parse_unsigned( r, u1 );
+            BOOST_TEST( vlc_parse_unsigned( r, u2 ) == un );
+            BOOST_TEST( u1 == u2 );
+            nunsigned += un;
+        }
+    }
+    // make sure the transcripts exercise all three
+    BOOST_TEST( nerrs >= 8U );
+    BOOST_TEST( nstatus >= 16U );
+    BOOST_TEST( nunsigned >= 8U );
+}
+
+/// Parsing a status reply does not touch the heap once the resource
+/// string has room.
+///
+BOOST_AUTO_TEST_CASE( no_allocation )
+{
+    const std::string r {
+        "status\r\n( new input: http://cms.stream.publicradio.org/cms.mp3 )\r\n"
+        "( audio volume: 270 )\r\n( state playing )\r\n> " };
+    std::string res;
+    res.reserve( 200 );
+    unsigned vol {0};
+    unsigned long u {0};
+    Allocs = 0;
+    Counting = true;
+    bool ok = vlc_parse_status( r, vol, res ) and not vlc_detect_error( r )
+        and not vlc_parse_unsigned( r, u );
+    Counting = false;
+    BOOST_TEST( ok );
+    BOOST_TEST( vol == 270U );
+    BOOST_TEST( res == "http://cms.stream.publicradio.org/cms.mp3" );
+    BOOST_TEST( Allocs == 0UL );
+}
+
+/// Time the parsers on each reply, as rsked uses them.  The reply
+/// with an odd volume is left out, lest logging dominate.
+///
+BOOST_AUTO_TEST_CASE( benchmark )
+{
+    using namespace std::chrono;
+    auto replies = load_replies();
+    replies.erase( std::remove_if( replies.begin(), replies.end(),
+                                   [](const std::string &r) {
+                                       return r.npos != r.find("volume: loud"); } ),
+                   replies.end() );
+    const unsigned rounds = 2000;
+    std::string res;
+    unsigned vol {0};
+    unsigned long u {0};
+    unsigned long hits {0};
+
+    auto t0 = steady_clock::now();
+    for (unsigned i=0; i<rounds; i++) {
+        for (const auto &r : replies) {
+            PlayerState ps { PlayerState::Stopped };
+            hits += detect_vlc_error( r ) + parse_status( r, ps, vol, res )
+                + parse_unsigned( r, u );
+        }
+    }
+    double regex_ns = duration<double,std::nano>( steady_clock::now() - t0 ).count();
+
+    Allocs = 0;
+    Counting = true;
+    t0 = steady_clock::now();
+    for (unsigned i=0; i<rounds; i++) {
+        for (const auto &r : replies) {
+            hits -= vlc_detect_error( r ) + vlc_parse_status( r, vol, res )
+                + vlc_parse_unsigned( r, u );
+        }
+    }
+    double sv_ns = duration<double,std::nano>( steady_clock::now() - t0 ).count();
+    Counting = false;
+
+    double n = 3.0 * rounds * static_cast<double>(replies.size());
+    std::cout << "regex: " << regex_ns/n << " ns per parse\n"
+              << "string_view: " << sv_ns/n << " ns per parse, "
+              << static_cast<double>(Allocs)/n << " allocations per parse\n";
+    BOOST_TEST( hits == 0UL );
+    BOOST_TEST( sv_ns < regex_ns );
+}
@@ -0,0 +1,242 @@
+/// Test the wav parser (wavparse.cc) used by the Pcm_player, on
+/// images built here: well formed, truncated, with odd-length chunks,
+/// and in sample formats it must refuse.  Run as:
+///
+///    twavparse  --log_level=all
+
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/// Dynamically link boost test framework
+#define BOOST_TEST_MODULE wavparse_test
+#ifndef BOOST_TEST_DYN_LINK
+#define BOOST_TEST_DYN_LINK 1
+#endif
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include "wavparse.hpp"
+
+
+/////////////////////////// Building wav images //////////////////////////////
+
+/// Append n bytes of little-endian v to buf.
+///
+static void put_le( std::vector<char> &buf, unsigned long v, unsigned n )
+{
+    for (unsigned i=0; i<n; i++) {
+        buf.push_back( static_cast<char>((v >> (8*i)) & 0xFF) );
+    }
+}
+
+/// Append a chunk with the given id and body, padded to even length.
+///
+static void put_chunk( std::vector<char> &buf, const std::string &id,
+                       const std::vector<char> &body )
+{
+    buf.insert( buf.end(), id.begin(), id.end() );
+    put_le( buf, body.size(), 4 );
+    buf.insert( buf.end(), body.begin(), body.end() );
+    if (body.size() & 1) {
+        buf.push_back( 0 );
+    }
+}
+
+/// The body of a fmt chunk.
+///
+static std::vector<char> fmt_body( unsigned tag, unsigned channels,
+                                   unsigned rate, unsigned bits )
+{
+    std::vector<char> b;
+    put_le( b, tag, 2 );
+    put_le( b, channels, 2 );
+    put_le( b, rate, 4 );
+    put_le( b, rate*channels*bits/8, 4 );      // byte rate
+    put_le( b, channels*bits/8, 2 );           // block align
+    put_le( b, bits, 2 );
+    return b;
+}
+
+/// Samples 1, 2, 3 ... as 16 bit values, n bytes of them.
+///
+static std::vector<char> pcm_body( size_t n )
+{
+    std::vector<char> b;
+    for (size_t i=0; i<n; i++) {
+        b.push_back( static_cast<char>((i & 1) ? 0 : (i/2 + 1)) );
+    }
+    return b;
+}
+
+/// A wav image holding the given chunks, in order, after the header.
+///
+static std::vector<char> wav( const std::vector<std::vector<char>> &chunks )
+{
+    std::vector<char> buf { 'R','I','F','F' };
+    size_t len = 4;
+    for (const auto &c : chunks) { len += c.size(); }
+    put_le( buf, len, 4 );
+    buf.insert( buf.end(), { 'W','A','V','E' } );
+    for (const auto &c : chunks) {
+        buf.insert( buf.end(), c.begin(), c.end() );
+    }
+    return buf;
+}
+
+/// One chunk, as it would appear in an image.
+///
+static std::vector<char> chunk( const std::string &id, const std::vector<char> &body )
+{
+    std::vector<char> c;
+    put_chunk( c, id, body );
+    return c;
+}
+
+
+///////////////////////////////// Tests ////////////////////////////////////
+
+/// A plain 16 bit stereo wav is taken whole.
+///
+BOOST_AUTO_TEST_CASE( well_formed )
+{
+    auto img = wav({ chunk( "fmt ", fmt_body( 1, 2, 22050, 16 ) ),
+                     chunk( "data", pcm_body( 400 ) ) });
+    Pcm_clip clip;
+    BOOST_TEST( parse_wav( img, clip ) );
+    BOOST_TEST( clip.rate == 22050U );
+    BOOST_TEST( clip.channels == 2U );
+    BOOST_TEST( (clip.pcm == pcm_body( 400 )) );
+    BOOST_TEST( clip.secs() == 100.0/22050, boost::test_tools::tolerance(1e-9) );
+}
+
+/// Cut short anywhere before the data chunk header ends, the image is
+/// refused; cut within the data, only the whole frames present are
+/// kept.
+///
+BOOST_AUTO_TEST_CASE( truncated_header )
+{
+    auto img = wav({ chunk( "fmt ", fmt_body( 1, 2, 8000, 16 ) ),
+                     chunk( "data", pcm_body( 64 ) ) });
+    const size_t data_at = 12 + 8 + 16 + 8;
+    for (size_t n=0; n < data_at; n++) {
+        std::vector<char> cut( img.begin(), img.begin() + static_cast<long>(n) );
+        Pcm_clip clip;
+        BOOST_TEST_CONTEXT( "cut at " << n ) {
+            BOOST_TEST( not parse_wav( cut, clip ) );
+        }
+    }
+    for (size_t n=data_at; n <= img.size(); n++) {
+        std::vector<char> cut( img.begin(), img.begin() + static_cast<long>(n) );
+        Pcm_clip clip;
+        BOOST_TEST_CONTEXT( "cut at " << n ) {
+            BOOST_TEST( parse_wav( cut, clip ) );
+            BOOST_TEST( clip.pcm.size() == ((n - data_at) & ~size_t{3}) );
+        }
+    }
+}
+
+/// A fmt chunk too short to hold the sample format is not trusted.
+///
+BOOST_AUTO_TEST_CASE( short_fmt_chunk )
+{
+    auto fmt = fmt_body( 1, 1, 8000, 16 );
+    fmt.resize( 14 );                           // no bits per sample
+    auto img = wav({ chunk( "fmt ", fmt ), chunk( "data", pcm_body( 8 ) ) });
+    Pcm_clip clip;
+    BOOST_TEST( not parse_wav( img, clip ) );
+}
+
+/// Odd-length chunks are followed by a pad byte, which must be
+/// skipped to find the next chunk; an odd-length data chunk yields
+/// only its whole frames.
+///
+BOOST_AUTO_TEST_CASE( odd_length_chunks )
+{
+    auto img = wav({ chunk( "LIST", { 'I','N','F','O','x' } ),
+                     chunk( "fmt ", fmt_body( 1, 1, 16000, 16 ) ),
+                     chunk( "junk", { 'z' } ),
+                     chunk( "data", pcm_body( 7 ) ) });
+    Pcm_clip clip;
+    BOOST_TEST( parse_wav( img, clip ) );
+    BOOST_TEST( clip.rate == 16000U );
+    BOOST_TEST( clip.channels == 1U );
+    BOOST_TEST( (clip.pcm == pcm_body( 6 )) );
+
+    // stereo: 4 byte frames
+    img = wav({ chunk( "fmt ", fmt_body( 1, 2, 16000, 16 ) ),
+                chunk( "data", pcm_body( 11 ) ) });
+    BOOST_TEST( parse_wav( img, clip ) );
+    BOOST_TEST( (clip.pcm == pcm_body( 8 )) );
+}
+
+/// Only 16 bit integer PCM is accepted, plain or in the extensible
+/// format.
+///
+BOOST_AUTO_TEST_CASE( sample_formats )
+{
+    struct Fmt { unsigned tag; unsigned bits; bool ok; };
+    const Fmt fmts[] {
+        { 1, 16, true },
+        { 0xFFFE, 16, true },
+        { 1, 8, false },
+        { 1, 24, false },
+        { 1, 32, false },
+        { 3, 32, false },           // IEEE float
+        { 3, 16, false },
+        { 6, 16, false },           // A-law
+        { 0xFFFE, 24, false },
+    };
+    for (const auto &f : fmts) {
+        BOOST_TEST_CONTEXT( "tag " << f.tag << ", bits " << f.bits ) {
+            auto img = wav({ chunk( "fmt ", fmt_body( f.tag, 1, 8000, f.bits ) ),
+                             chunk( "data", pcm_body( 12 ) ) });
+            Pcm_clip clip;
+            BOOST_TEST( parse_wav( img, clip ) == f.ok );
+        }
+    }
+}
+
+/// Neither a RIFF WAVE, nor data before its format, nor a wav without
+/// data is accepted.
+///
+BOOST_AUTO_TEST_CASE( not_a_wav )
+{
+    Pcm_clip clip;
+    auto img = wav({ chunk( "fmt ", fmt_body( 1, 1, 8000, 16 ) ),
+                     chunk( "data", pcm_body( 8 ) ) });
+    auto rifx = img;
+    rifx[3] = 'X';
+    BOOST_TEST( not parse_wav( rifx, clip ) );
+    auto avi = img;
+    avi[8] = 'A'; avi[9] = 'V'; avi[10] = 'I'; avi[11] = ' ';
+    BOOST_TEST( not parse_wav( avi, clip ) );
+
+    img = wav({ chunk( "data", pcm_body( 8 ) ),
+                chunk( "fmt ", fmt_body( 1, 1, 8000, 16 ) ) });
+    BOOST_TEST( not parse_wav( img, clip ) );
+
+    img = wav({ chunk( "fmt ", fmt_body( 1, 1, 8000, 16 ) ) });
+    BOOST_TEST( not parse_wav( img, clip ) );
+
+    img = wav({ chunk( "fmt ", fmt_body( 1, 0, 8000, 16 ) ),
+                chunk( "data", pcm_body( 8 ) ) });
+    BOOST_TEST( not parse_wav( img, clip ) );       // no channels
+}
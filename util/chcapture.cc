@@ -0,0 +1,223 @@
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include "chcapture.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "logging.hpp"
+
+
+/// CTOR  name prefixes forwarded lines; the last ring_bytes of output
+/// are kept.
+///
+Output_capture::Output_capture( const std::string &name, size_t ring_bytes )
+    : m_name(name), m_ring(ring_bytes)
+{
+    m_line.reserve( LineMax );
+}
+
+/// DTOR - closes both ends of the pipe.
+///
+Output_capture::~Output_capture()
+{
+    close_pipe();
+}
+
+/// Open a fresh pipe for the next child, closing any prior one and
+/// forgetting its output.  Returns false (logged) if that fails, in
+/// which case the child's output will not be captured.
+/// * Will NOT throw
+///
+bool Output_capture::open_pipe()
+{
+    close_pipe();
+    clear();
+    int fds[2];
+    if (pipe2( fds, O_CLOEXEC )) {
+        LOG_WARNING(Lgr) << "Output_capture " << m_name << ": no pipe: "
+                         << strerror(errno);
+        return false;
+    }
+    m_rfd = fds[0];
+    m_wfd = fds[1];
+    fcntl( m_rfd, F_SETFL, O_NONBLOCK );
+    fcntl( m_rfd, F_SETPIPE_SZ, PipeSize );  // best effort
+    return true;
+}
+
+/// Close both ends of the pipe, if open.
+/// * Will NOT throw
+///
+void Output_capture::close_pipe()
+{
+    parent_done();
+    if (m_rfd != non_fd) {
+        close( m_rfd );
+        m_rfd = non_fd;
+    }
+}
+
+/// This is to be called in the newly forked CHILD *before* executing
+/// the target program.  It attaches stdout and stderr to the pipe.
+///
+void Output_capture::child_init()
+{
+    if (m_wfd != non_fd) {
+        dup2( m_wfd, STDOUT_FILENO );
+        dup2( m_wfd, STDERR_FILENO );
+    }
+}
+
+/// The equivalent of child_init for a child to be started by
+/// posix_spawn: add file actions to acts that attach the child's
+/// stdout and stderr to the pipe.  Call parent_done after spawning.
+///
+void Output_capture::spawn_init( posix_spawn_file_actions_t *acts )
+{
+    if (m_wfd != non_fd) {
+        posix_spawn_file_actions_adddup2( acts, m_wfd, STDOUT_FILENO );
+        posix_spawn_file_actions_adddup2( acts, m_wfd, STDERR_FILENO );
+    }
+}
+
+/// Release the child's end of the pipe, in the PARENT, once the child
+/// has been launched; the pipe reports end of file when it exits.
+/// * Will NOT throw
+///
+void Output_capture::parent_done()
+{
+    if (m_wfd != non_fd) {
+        close( m_wfd );
+        m_wfd = non_fd;
+    }
+}
+
+/// Read whatever the child has written, without blocking.  Returns
+/// false if the pipe is closed or at end of file (every writer gone),
+/// in which case the caller should stop watching fd() and close_pipe().
+/// * Will NOT throw
+///
+bool Output_capture::drain()
+{
+    char buf[4096];
+    while (m_rfd != non_fd) {
+        ssize_t n = read( m_rfd, buf, sizeof(buf) );
+        if (n > 0) {
+            for (ssize_t i=0; i<n; i++) {
+                char c = buf[i];
+                if ('\n' == c) {
+                    end_line();
+                    continue;
+                }
+                if (m_cr) {             // lone CR: line is overwritten
+                    m_line.clear();
+                    m_cr = false;
+                }
+                if ('\r' == c) {
+                    m_cr = true;
+                } else {
+                    m_line.push_back( c );
+                    if (m_line.size() >= LineMax) {
+                        end_line();
+                    }
+                }
+            }
+        } else if ((n < 0) and (EINTR == errno)) {
+            continue;
+        } else if ((n < 0) and (EAGAIN == errno)) {
+            return true;
+        } else {
+            break;
+        }
+    }
+    if (m_suppressed) {
+        LOG_INFO(Lgr) << m_name << ": (" << m_suppressed << " lines not logged)";
+        m_suppressed = 0;
+    }
+    return false;
+}
+
+/// A line is complete: keep it in the ring and maybe forward it.
+///
+void Output_capture::end_line()
+{
+    m_cr = false;
+    if (m_line.empty()) {
+        return;
+    }
+    m_ring.insert( m_ring.end(), m_line.begin(), m_line.end() );
+    m_ring.push_back( '\n' );
+    forward_line();
+    m_line.clear();
+}
+
+/// Log the current line if the token bucket allows: BurstLines at
+/// once, then one every RefillSecs.  Lines refused are counted, and
+/// the count is logged when logging resumes.
+///
+void Output_capture::forward_line()
+{
+    time_t now = time(0);
+    if (m_tokens < BurstLines) {
+        auto earned = static_cast<unsigned>( (now - m_refill_time) / RefillSecs );
+        if (earned) {
+            m_tokens = std::min<unsigned>( BurstLines, m_tokens + earned );
+            m_refill_time = now;
+        }
+    } else {
+        m_refill_time = now;
+    }
+    if (0 == m_tokens) {
+        ++m_suppressed;
+        return;
+    }
+    --m_tokens;
+    if (m_suppressed) {
+        LOG_INFO(Lgr) << m_name << ": (" << m_suppressed << " lines not logged)";
+        m_suppressed = 0;
+    }
+    LOG_INFO(Lgr) << m_name << ": " << m_line;
+}
+
+/// Log all the output kept in the ring, a line at a time, noting why.
+/// The first line may have lost its beginning to the ring.
+/// * Will NOT throw
+///
+void Output_capture::dump( const char *why ) const
+{
+    if (m_ring.empty() and m_line.empty()) {
+        return;
+    }
+    LOG_WARNING(Lgr) << m_name << " " << why << "; its last output follows";
+    std::string line {};
+    for (char c : m_ring) {
+        if ('\n' == c) {
+            LOG_WARNING(Lgr) << m_name << "| " << line;
+            line.clear();
+        } else {
+            line.push_back( c );
+        }
+    }
+    if (not m_line.empty()) {           // unterminated last line
+        LOG_WARNING(Lgr) << m_name << "| " << m_line;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma  once
+/// Output capture object for the Child_mgr class
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+
+/// Normal usage pattern:
+///
+/// Parent:
+///    Output_capture cap { "name", 8192 };
+///    cap.open_pipe()
+///    fork()
+///
+/// Child:
+///    child_init()
+///    exec()
+///
+/// Parent:
+///    parent_done()
+///    drain() ... whenever fd() is readable
+///    dump()      if the child failed
+
+#include <spawn.h>
+#include <ctime>
+#include <string>
+
+#include <boost/circular_buffer.hpp>
+
+
+///////////////////////////////////////////////////////////////////
+
+/// Captures the stdout and stderr of a child process through a pipe.
+/// The most recent output is kept in a ring buffer of fixed size, so
+/// it may be logged should the child fail, and complete lines are
+/// forwarded to the log, no more than about 20 a minute.  A carriage
+/// return not followed by newline discards the line so far, as a
+/// terminal would overwrite it, so progress displays are not kept.
+///
+/// The parent's end of the pipe is non-blocking and enlarged, so that
+/// the child can write a good deal before it could block, but somebody
+/// must call drain() whenever fd() is readable.
+///
+class Output_capture {
+private:
+    enum { non_fd=(-1), LineMax=200, BurstLines=20, RefillSecs=3,
+           PipeSize=(1<<20) };
+    int m_rfd { non_fd };               // parent's (read) end
+    int m_wfd { non_fd };               // child's (write) end, until launch
+    std::string m_name;                 // prefix for log lines
+    boost::circular_buffer<char> m_ring; // most recent output
+    std::string m_line {};              // partial line, at most LineMax
+    bool m_cr {false};                  // last char was a carriage return
+    unsigned m_tokens { BurstLines };   // lines that may be logged now
+    time_t m_refill_time {0};           // when a token was last added
+    unsigned long m_suppressed {0};     // lines not logged, since last
+    void end_line();
+    void forward_line();
+public:
+    void child_init();
+    void clear() { m_ring.clear(); m_line.clear(); m_cr = false; }
+    void close_pipe();
+    bool drain();
+    void dump( const char* ) const;
+    int fd() const { return m_rfd; }
+    bool open_pipe();
+    void parent_done();
+    void set_capacity( size_t n ) { m_ring.set_capacity( n ); }
+    void spawn_init( posix_spawn_file_actions_t* );
+    //
+    Output_capture( const std::string&, size_t );   // name, ring bytes
+    Output_capture(const Output_capture&) = delete;
+    void operator=(const Output_capture&) = delete;
+    ~Output_capture();
+};
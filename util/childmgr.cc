@@ -22,8 +22,19 @@
 
 #include "childmgr.hpp"
 #include "chpty.hpp"
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
 #include <signal.h>
+#include <spawn.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -31,39 +42,154 @@
 
 /// Init static members of Child_mgr
 ///
+std::unique_ptr<Event_loop> Child_mgr::c_captures {};  // outlives instances
+
 std::list<std::shared_ptr<Child_mgr>> 
    Child_mgr::c_instances;  // list of all instances
 
+std::unordered_map<pid_t,std::weak_ptr<Child_mgr>>
+   Child_mgr::c_by_pid;     // instances with a live child, by pid
+
 std::mutex  Child_mgr::c_mutex;
 bool Child_mgr::CM_ready { false };
+bool Child_mgr::c_spawn { true };
+std::unique_ptr<Event_fd> Child_mgr::c_events {};
+std::atomic<unsigned> Child_mgr::c_sigchld_gen { 0 };
+std::atomic<unsigned> Child_mgr::c_reaped_gen { 0 };
+std::chrono::steady_clock::time_point Child_mgr::c_usage_logged {
+    std::chrono::steady_clock::now() };
 
 /* Note that the global list c_instances needs to be accessed:
  * 1. on creation of a new instance  (append to end)
- * 2. on destruction of an instance  
+ * 2. on destruction of an instance
  * 3. when searching or listing instances
- * 4. when a SIGCHLD signal arrives affecting an instance
- * The signal handling case deserves some care. It is treacherous
- * to include any sort of lock or other blocking call in a signal
- * handler since deadlock may occur. The signal handler for SIGCHLD
- * thus operates without grabbing the lock. The destructor does not
- * modify the list structure, but zeroes out the entry if found.
+ * Children are reaped by reap(), never in the SIGCHLD handler, so the
+ * pid table c_by_pid is only touched under c_mutex.  The handler just
+ * counts the signal and bumps eventfds: c_events for the event loop,
+ * and one for each thread waiting in wait_for_phase or kill_all.
  */
 
+/// Descriptors of threads blocked waiting for some child to change
+/// state.  Each is an eventfd, made on first use and never closed, so
+/// the SIGCHLD handler may write to any of them at any time.
+///
+constexpr size_t MaxWaiters { 8 };
+static std::array<std::atomic<int>,MaxWaiters> WaitFds {{-1,-1,-1,-1,-1,-1,-1,-1}};
+static std::array<std::atomic<bool>,MaxWaiters> WaitBusy {};
+
+/// Claim a waiter descriptor for the lifetime of this object.  If none
+/// is available, fd() is -1 and the caller should wait in short slices.
+///
+class Child_waiter {
+private:
+    int m_fd { -1 };
+    size_t m_slot { MaxWaiters };
+public:
+    int fd() const { return m_fd; }
+    void consume() {
+        uint64_t n;
+        if (m_fd >= 0) { while (read(m_fd, &n, sizeof(n)) == sizeof(n)) { } }
+    }
+    Child_waiter() {
+        for (size_t i=0; i < MaxWaiters; i++) {
+            bool idle = false;
+            if (WaitBusy[i].compare_exchange_strong( idle, true )) {
+                m_slot = i;
+                break;
+            }
+        }
+        if (m_slot == MaxWaiters) return;
+        m_fd = WaitFds[m_slot];
+        if (m_fd < 0) {
+            m_fd = eventfd( 0, EFD_NONBLOCK|EFD_CLOEXEC );
+            WaitFds[m_slot] = m_fd;
+        }
+        consume();      // stale notices
+    }
+    ~Child_waiter() {
+        if (m_slot < MaxWaiters) { WaitBusy[m_slot] = false; }
+    }
+    Child_waiter(const Child_waiter&) = delete;
+    void operator=(const Child_waiter&) = delete;
+};
+
+/// What posix_spawn can do here, beyond POSIX: change directory
+/// (glibc 2.29) and close inherited descriptors (glibc 2.34).
+/// Children that need a directory or session it cannot arrange are
+/// forked instead.
+///
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2,29)
+#define SPAWN_CHDIR 1
+#else
+#define SPAWN_CHDIR 0
+#endif
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2,34)
+#define SPAWN_CLOSEFROM 1
+#else
+#define SPAWN_CLOSEFROM 0
+#endif
+constexpr bool SpawnChdir { SPAWN_CHDIR };
+#ifdef POSIX_SPAWN_SETSID
+constexpr bool SpawnSetsid { true };
+#else
+constexpr bool SpawnSetsid { false };
+#endif
+
+/// I/O priority encoding (linux/ioprio.h, not always installed).
+///
+enum { IoprioWhoProcess=1, IoprioClassShift=13 };
+static const char* IoClassNames[] { "none", "realtime", "best-effort", "idle" };
+
+/// Open a pidfd for process pid, or return -1 if unsupported.
+///
+static int open_pidfd( pid_t pid )
+{
+#ifdef SYS_pidfd_open
+    return static_cast<int>( syscall( SYS_pidfd_open, pid, 0 ) );
+#else
+    (void) pid;
+    return -1;
+#endif
+}
+
+/// Wait until one of the descriptors in fds (waiting for POLLIN) is
+/// ready or ms milliseconds pass.  With no descriptors, just sleep.
+/// * Will NOT throw
+///
+static void wait_readable( std::vector<struct pollfd> &fds, int ms )
+{
+    if (poll( fds.data(), fds.size(), ms ) < 0 and (EINTR != errno)) {
+        LOG_ERROR(Lgr) << "Child_mgr: poll failed: " << strerror(errno);
+    }
+}
+
 /// Static Method. Remove all dead (not running or null) tracked
 /// instances of Child_mgr.
 /// Note: this function is NOT thread safe.
 ///
 void Child_mgr::purge()
 {
+    refresh();
     c_instances.remove_if( [](spCM &p){ 
             return (not p or not p->running()); } );
 }
 
+/// Static method. Choose how children are launched: by posix_spawn
+/// (the default), which does not copy the page tables of a large
+/// parent, or by fork and exec.  Some children may be forked anyway
+/// if the C library cannot spawn them as configured.
+///
+void Child_mgr::set_spawn( bool sp )
+{
+    c_spawn = sp;
+}
+
 /// Static method. Return the number of child processes that are
 /// marked as *running* (globally).
 ///
 unsigned Child_mgr::run_count()
 {
+    refresh();
     unsigned rc=0;
     for (auto pcm : c_instances) {
         if (pcm->running()) {
@@ -74,33 +200,33 @@ unsigned Child_mgr::run_count()
 }
 
 /// Static Method. Kill all known processes and wait for them to die.
-/// Purge the c_instances list.  To kill, try first with SIGINT; if
-/// that fails use SIGTERM.  If that fails, give up.
+/// Purge the c_instances list.  To kill, try first with SIGTERM; if
+/// that fails use SIGKILL.  If that fails, give up.  All children are
+/// signalled before any is waited for, so the wait is only as long as
+/// the slowest one takes to die (at most 3 seconds per round).
 ///
 void Child_mgr::kill_all()
 {
-    const unsigned int WAIT_SECS {3};  // wait for SIGCHLD, seconds
-    unsigned int wait_secs;
+    const long WAIT_US {3'000'000};  // wait for all to die, usecs
     unsigned nalive;
     bool forcep=false;
+    refresh();
     do {
-        nalive = 0;
         for (auto pcm : c_instances) {
-            if (pcm->running()) {
-                nalive++;
-                pcm->kill_child(forcep);
+            if (pcm and pcm->running()) {
+                pcm->kill_child(forcep);   // signal only
             }
         }
-        for (wait_secs=WAIT_SECS; wait_secs; wait_secs=sleep(wait_secs));
+        wait_all_gone( WAIT_US );
         nalive = run_count();
         if (nalive) {
             if (forcep)  {
-                LOG_ERROR(Lgr) << "Cannot kill " << nalive 
+                LOG_ERROR(Lgr) << "Cannot kill " << nalive
                                << " process(es), giving up.";
                 break;
             }
             forcep = true;
-            LOG_INFO(Lgr) << "Waiting for " << nalive 
+            LOG_INFO(Lgr) << "Waiting for " << nalive
                           << " process(es) to die...";
             ListInstances();
         }
@@ -109,6 +235,47 @@ void Child_mgr::kill_all()
     purge();
 }
 
+/// Static Method. Wait up to wait_us MICROseconds for every child
+/// that has been told to die to be gone, blocking on their pidfds and
+/// on SIGCHLD.  Returns true if none remain.
+/// * Will NOT throw
+///
+bool Child_mgr::wait_all_gone( long wait_us )
+{
+    using namespace std::chrono;
+    auto deadline = steady_clock::now() + microseconds(wait_us);
+    Child_waiter waiter {};
+    for (;;) {
+        reap();
+        std::vector<struct pollfd> fds {};
+        bool dying = false;
+        for (auto pcm : c_instances) {
+            if (pcm and (ChildPhase::gone != pcm->m_obs_phase)
+                and (ChildPhase::gone == pcm->m_cmd_phase)) {
+                dying = true;
+                if (pcm->m_pidfd >= 0) {
+                    fds.push_back( {pcm->m_pidfd, POLLIN, 0} );
+                }
+            }
+        }
+        if (not dying) {
+            return true;
+        }
+        auto ms = duration_cast<milliseconds>( deadline - steady_clock::now()
+                                               + microseconds(999) ).count();
+        if (ms <= 0) {
+            return false;
+        }
+        if (waiter.fd() >= 0) {
+            fds.push_back( {waiter.fd(), POLLIN, 0} );
+        } else {
+            ms = std::min( ms, 10L );
+        }
+        wait_readable( fds, static_cast<int>(ms) );
+        waiter.consume();
+    }
+}
+
 
 
 /// CTOR. Private.
@@ -132,6 +299,13 @@ Child_mgr::Child_mgr( const boost::filesystem::path bp )
 ///
 Child_mgr::~Child_mgr()
 {
+    if (m_pidfd >= 0) {
+        close( m_pidfd );
+    }
+    close_input();
+    if (m_capture and c_captures) {
+        c_captures->remove( m_capture->fd() );
+    }
 }
 
 
@@ -147,47 +321,117 @@ void Child_mgr::ListInstances()
             LOG_DEBUG(Lgr) << " (" << child_index++ << ") " << pcm->get_name()
                            << " pid=" << pcm->get_pid()
                            << "  last_observed_phase="
-                           << phase_name( pcm->last_obs_phase() );
+                           << phase_name( pcm->m_obs_phase );
         }
     }
 }
 
 
 /// Return a shared pointer to the child_mgr associated with the given
-/// pid This will lock the child list while it searches.  Returns a
-/// shared nullptr if no such child is registered.
+/// pid, or a shared nullptr if no such child is registered.
+/// Caller must hold c_mutex.
 ///
 spCM Child_mgr::find_child( pid_t pid )
 {
+    auto it = c_by_pid.find( pid );
+    return (it == c_by_pid.end()) ? spCM(nullptr) : it->second.lock();
+}
+
+/// Static Method. Collect every pending change of state of any child
+/// (exit, stop, continue) and update the instance concerned.  Cheap
+/// if nothing is pending; safe to call from any thread, but not with
+/// c_mutex held.
+/// * Will NOT throw
+///
+void Child_mgr::reap()
+{
+    std::lock_guard<std::mutex> lock( c_mutex );
+    unsigned gen = c_sigchld_gen;
+    constexpr int event_mask = WUNTRACED|WCONTINUED|WNOHANG;
+    int wstatus = 0;
+    struct rusage ru;
+    pid_t pid;
+    // wait4 rather than waitid, to collect resource use on exit
+    while (0 < (pid = wait4( -1, &wstatus, event_mask, &ru ))) {
+        siginfo_t status;
+        memset(&status,0,sizeof(status));
+        status.si_pid = pid;
+        bool exited = false;
+        if (WIFEXITED(wstatus)) {
+            status.si_code = CLD_EXITED;
+            status.si_status = WEXITSTATUS(wstatus);
+            exited = true;
+        } else if (WIFSIGNALED(wstatus)) {
+            status.si_code = CLD_KILLED;     // with or without a core
+            status.si_status = WTERMSIG(wstatus);
+            exited = true;
+        } else if (WIFSTOPPED(wstatus)) {
+            status.si_code = CLD_STOPPED;
+            status.si_status = WSTOPSIG(wstatus);
+        } else if (WIFCONTINUED(wstatus)) {
+            status.si_code = CLD_CONTINUED;
+            status.si_status = SIGCONT;
+        }
+        spCM pcm = find_child( pid );
+        if (pcm) {
+            if (exited) {
+                pcm->note_rusage( ru );
+            }
+            pcm->update_status( status );
+        }
+    }
+    c_reaped_gen = gen;
+}
+
+/// Static Method. Sample the resource use of every running child,
+/// terminating any that exceed a soft limit, and log them all hourly.
+/// Call this periodically, e.g. with each round of health checks.
+/// * Will NOT throw
+///
+void Child_mgr::sample_all()
+{
+    using namespace std::chrono;
+    refresh();
+    drain_captures();           // in case nobody watches capture_fd()
+    std::lock_guard<std::mutex> lock( c_mutex );  // no pid is reaped meanwhile
+    bool hourly = ((steady_clock::now() - c_usage_logged) >= hours(1));
+    if (hourly) {
+        c_usage_logged = steady_clock::now();
+    }
     for (auto pcm : c_instances) {
-        if (pcm and (pcm->get_pid() == pid)) {
-            return pcm;
+        if (not pcm or (NOTAPID == pcm->m_pid)
+            or (ChildPhase::gone == pcm->m_obs_phase)) {
+            continue;
+        }
+        pcm->sample_usage();
+        if (hourly) {
+            pcm->log_usage( "using" );
         }
     }
-    return spCM(nullptr);
 }
 
-/// Signal handler function for child process death.
-/// Scan all children to see which one(s) have changed status.
-/// Note: Calling waitid() here "consumes" the event.
+/// Signal handler function for child process state changes.  Only
+/// counts the signal and wakes whoever is waiting; see reap().
 /// This function will not throw, perform I/O, or call any other
 /// signal-unsafe functions.
 ///
 void Child_mgr::sigchld_handler(int sig)
 {
     if (SIGCHLD != sig) return;
-    siginfo_t status;
-    constexpr int event_mask = WEXITED|WSTOPPED|WCONTINUED|WNOHANG;
-    memset(&status,0,sizeof(status));
-    while (0 == waitid(P_ALL, 0, &status, event_mask) ) {
-        if (0 == status.si_pid) break; // no state change
-        // Find the instance 
-        spCM pcm = find_child( status.si_pid );
-        if (pcm) {
-            pcm->update_status( status );
+    int saved_errno = errno;
+    ++c_sigchld_gen;
+    if (c_events) {
+        c_events->notify();
+    }
+    for (auto &wfd : WaitFds) {
+        int fd = wfd;
+        if (fd >= 0) {
+            uint64_t one = 1;
+            ssize_t rc = write( fd, &one, sizeof(one) );
+            (void) rc;
         }
-        memset(&status,0,sizeof(status));
     }
+    errno = saved_errno;
 }
 
 /// Set up the SIGCHLD handler. No attempt is made to preserve any
@@ -195,6 +439,16 @@ void Child_mgr::sigchld_handler(int sig)
 ///
 void Child_mgr::setup_sigchld_handler()
 {
+    try {
+        c_events = std::make_unique<Event_fd>();
+    } catch (const Event_loop_exception&) {
+        LOG_WARNING(Lgr) << "Child_mgr: no event descriptor for SIGCHLD";
+    }
+    try {
+        c_captures = std::make_unique<Event_loop>();
+    } catch (const Event_loop_exception&) {
+        LOG_WARNING(Lgr) << "Child_mgr: child output will not be captured";
+    }
     // prepare signal handler
     struct sigaction sa;
     memset( &sa, 0, sizeof(sa) );
@@ -209,6 +463,131 @@ void Child_mgr::setup_sigchld_handler()
 }
 
 
+/// Class method. Return a descriptor that becomes readable whenever
+/// SIGCHLD has been handled, or -1 if there is none (no instance
+/// created yet, or the eventfd could not be made).
+///
+int Child_mgr::event_fd()
+{
+    return (c_events ? c_events->fd() : -1);
+}
+
+/// Class method. Return a descriptor that is readable whenever some
+/// child has output waiting to be drained by drain_captures(), or -1
+/// if output cannot be captured.
+///
+int Child_mgr::capture_fd()
+{
+    return (c_captures ? c_captures->fd() : -1);
+}
+
+/// Class method. Read whatever output the children have written, so
+/// they never block on a full pipe.
+/// * Will NOT throw
+///
+void Child_mgr::drain_captures()
+{
+    std::lock_guard<std::mutex> lock( c_mutex );
+    if (c_captures) {
+        c_captures->run_once( 0 );
+    }
+}
+
+/// Capture the stdout and stderr of children started hereafter, and
+/// keep the last ring_bytes of it; 0 stops capturing at once.  A child
+/// already being captured keeps its pipe.  Ignored if the child has a
+/// pty, which takes those streams instead.
+///
+void Child_mgr::enable_capture( size_t ring_bytes )
+{
+    std::lock_guard<std::mutex> lock( c_mutex );
+    if (0 == ring_bytes) {
+        close_capture();
+        m_capture.reset();
+    } else if (m_capture) {
+        m_capture->set_capacity( ring_bytes );
+    } else {
+        m_capture = std::make_unique<Output_capture>(
+            (m_name.empty() ? m_bin_path.filename().string() : m_name),
+            ring_bytes );
+    }
+}
+
+/// Give children started hereafter a pipe for stdin, holding about
+/// pipe_bytes (rounded up to a page), whose other end is input_fd(); 0
+/// stops doing so.  A small pipe keeps what the child has yet to read
+/// small.  Ignored if the child has a pty.
+///
+void Child_mgr::enable_input( size_t pipe_bytes )
+{
+    m_input_bytes = pipe_bytes;
+}
+
+/// Close both ends of any stdin pipe.  Writes by another thread in
+/// progress must be over, since the descriptor may be reused.
+///
+void Child_mgr::close_input()
+{
+    for (int *fd : { &m_in_rfd, &m_in_wfd }) {
+        if (*fd >= 0) {
+            close( *fd );
+            *fd = -1;
+        }
+    }
+}
+
+/// Drain the capture pipe, closing it at end of file.
+/// Caller must hold c_mutex.
+///
+void Child_mgr::drain_capture()
+{
+    if (m_capture and (m_capture->fd() >= 0) and not m_capture->drain()) {
+        close_capture();
+    }
+}
+
+/// Stop watching the capture pipe and close it; the output kept is
+/// not lost.  Caller must hold c_mutex.
+///
+void Child_mgr::close_capture()
+{
+    if (m_capture and (m_capture->fd() >= 0)) {
+        if (c_captures) {
+            c_captures->remove( m_capture->fd() );
+        }
+        m_capture->close_pipe();
+    }
+}
+
+/// Once the child is launched, release its end of the capture pipe
+/// and watch ours.  Caller must hold c_mutex.
+///
+void Child_mgr::watch_capture()
+{
+    if (not m_capture or (m_capture->fd() < 0)) {
+        return;
+    }
+    m_capture->parent_done();
+    std::weak_ptr<Child_mgr> wp { shared_from_this() };
+    try {
+        c_captures->add( m_capture->fd(), [wp](uint32_t) {
+                if (auto pcm = wp.lock()) { pcm->drain_capture(); } } );
+    } catch (const Event_loop_exception&) {
+        m_capture->close_pipe();    // child gets SIGPIPE, rather than block
+    }
+}
+
+/// Class method. Reset the event_fd() so it is no longer readable,
+/// and reap whatever changes of child state it announced.
+///
+void Child_mgr::clear_events()
+{
+    if (c_events) {
+        c_events->consume();
+    }
+    reap();
+}
+
 /// Class method retrieves phase name
 ///
 const char*
@@ -264,6 +643,227 @@ Child_mgr::cond_name( RunCond r )
 }
 
 
+/// Set soft limits on the resources used by the child: its smoothed
+/// CPU use, percent of one core, and its resident set size, in KB.
+/// Zero means no limit.  A child found over a limit by sample_all()
+/// is terminated, and will show up as an abnormal exit.
+///
+void Child_mgr::set_limits( double cpu_pct, unsigned long rss_kb )
+{
+    m_max_cpu_pct = cpu_pct;
+    m_max_rss_kb = rss_kb;
+}
+
+/// Set the scheduling policy for children started hereafter.
+///
+void Child_mgr::set_policy( const Child_policy &pol )
+{
+    m_policy = pol;
+}
+
+/// Apply m_policy to the calling process.  This runs in the forked
+/// child, before it execs the binary, so the policy is in force before
+/// the child can start any threads.  Only async-signal-safe calls are
+/// made, and nothing is logged here: report_policy() in the parent
+/// logs what took effect and warns of anything not granted.
+/// * Will NOT throw
+///
+void Child_mgr::apply_policy()
+{
+    const Child_policy &pol = m_policy;
+    if (pol.cpu_mask) {
+        cpu_set_t cpus;
+        CPU_ZERO( &cpus );
+        for (unsigned n=0; n < 8*sizeof(pol.cpu_mask); n++) {
+            if (pol.cpu_mask & (1UL << n)) { CPU_SET( n, &cpus ); }
+        }
+        sched_setaffinity( 0, sizeof(cpus), &cpus );
+    }
+    if (pol.rt_priority) {
+        struct sched_param sp {};
+        sp.sched_priority = static_cast<int>(pol.rt_priority);
+        sched_setscheduler( 0, SCHED_RR, &sp );
+    }
+    if (pol.set_nice) {
+        setpriority( PRIO_PROCESS, 0, pol.nice );
+    }
+#ifdef SYS_ioprio_set
+    if (pol.io_class) {
+        long prio = (pol.io_class << IoprioClassShift) | pol.io_level;
+        syscall( SYS_ioprio_set, IoprioWhoProcess, 0, prio );
+    }
+#endif
+}
+
+/// Log the scheduling the child just launched actually has, with a
+/// warning for any part of m_policy not granted.  Favoring a child
+/// (negative nice, SCHED_RR, realtime I/O) needs CAP_SYS_NICE or a
+/// suitable rlimit; failure to get it is not fatal.  Must be called
+/// only once the child has exec'd, so that it has applied the policy.
+/// * Will NOT throw
+///
+void Child_mgr::report_policy()
+{
+    if (m_policy.empty() or (NOTAPID == m_pid)) {
+        return;
+    }
+    const Child_policy &pol = m_policy;
+    std::ostringstream eff;
+    errno = 0;
+    int nice = getpriority( PRIO_PROCESS, static_cast<id_t>(m_pid) );
+    if (0 == errno) {
+        eff << "nice " << nice;
+        if (pol.set_nice and (nice != pol.nice)) {
+            LOG_WARNING(Lgr) << "Child_mgr " << m_name << " did not get nice "
+                             << pol.nice;
+        }
+    }
+    int sched = sched_getscheduler( m_pid );
+    struct sched_param sp {};
+    if ((SCHED_RR == sched) and (0 == sched_getparam( m_pid, &sp ))) {
+        eff << ", SCHED_RR " << sp.sched_priority;
+    } else if (SCHED_FIFO == sched) {
+        eff << ", SCHED_FIFO";
+    }
+    if (pol.rt_priority and ((SCHED_RR != sched)
+                             or (sp.sched_priority != static_cast<int>(pol.rt_priority)))) {
+        LOG_WARNING(Lgr) << "Child_mgr " << m_name << " did not get SCHED_RR "
+                         << pol.rt_priority;
+    }
+    cpu_set_t cpus;
+    if (pol.cpu_mask and (0 == sched_getaffinity( m_pid, sizeof(cpus), &cpus ))) {
+        eff << ", cpus";
+        const char *sep = " ";
+        unsigned long got = 0;
+        for (int n=0; n < CPU_SETSIZE; n++) {
+            if (CPU_ISSET( n, &cpus )) {
+                eff << sep << n;
+                sep = ",";
+                if (n < static_cast<int>(8*sizeof(got))) { got |= (1UL << n); }
+            }
+        }
+        if (got != pol.cpu_mask) {
+            LOG_WARNING(Lgr) << "Child_mgr " << m_name
+                             << " did not get the cpu affinity asked for";
+        }
+    }
+#ifdef SYS_ioprio_get
+    long prio = syscall( SYS_ioprio_get, IoprioWhoProcess, m_pid );
+    if (prio >= 0) {
+        eff << ", io " << IoClassNames[(prio >> IoprioClassShift) & 3]
+            << "/" << (prio & 7);
+        if (pol.io_class and (((prio >> IoprioClassShift) & 3) != (pol.io_class & 3))) {
+            LOG_WARNING(Lgr) << "Child_mgr " << m_name << " did not get io priority "
+                             << IoClassNames[pol.io_class & 3] << "/" << pol.io_level;
+        }
+    }
+#endif
+    LOG_INFO(Lgr) << "Child_mgr " << m_name << " pid=" << m_pid
+                  << " scheduling: " << eff.str();
+}
+
+/// Read /proc/<pid>/stat and /proc/<pid>/io to update m_usage, then
+/// enforce any soft limits.  CPU use is smoothed over a few samples
+/// and not judged before the third.  Caller must hold c_mutex.
+/// * Will NOT throw
+///
+void Child_mgr::sample_usage()
+{
+    using namespace std::chrono;
+    static const long TicksPerSec { sysconf(_SC_CLK_TCK) };
+    static const long PageKB { sysconf(_SC_PAGESIZE) / 1024 };
+    std::string proc { "/proc/" + std::to_string(m_pid) };
+    std::ifstream statf( proc + "/stat" );
+    std::string line;
+    if (not std::getline( statf, line )) {
+        return;                 // gone meanwhile
+    }
+    // fields after "(comm)": state is field 3, utime 14, stime 15, rss 24
+    std::istringstream fields( line.substr( line.rfind(')') + 2 ) );
+    std::string field;
+    unsigned long utime=0, stime=0, rss=0;
+    for (unsigned n=3; (n <= 24) and (fields >> field); n++) {
+        if (14 == n) { utime = std::stoul(field); }
+        if (15 == n) { stime = std::stoul(field); }
+        if (24 == n) { rss = std::stoul(field); }
+    }
+    auto now = steady_clock::now();
+    unsigned long ticks = utime + stime;
+    if (m_usage.samples) {
+        double secs = duration<double>( now - m_last_sample ).count();
+        if (secs > 0) {
+            double pct = 100.0 * static_cast<double>(ticks - m_last_ticks)
+                / static_cast<double>(TicksPerSec) / secs;
+            m_usage.cpu_pct = (1 == m_usage.samples) ? pct
+                : (0.7*m_usage.cpu_pct + 0.3*pct);
+            m_usage.peak_cpu_pct = std::max( m_usage.peak_cpu_pct, pct );
+        }
+    }
+    ++m_usage.samples;
+    m_last_ticks = ticks;
+    m_last_sample = now;
+    m_usage.cpu_secs = static_cast<double>(ticks) / static_cast<double>(TicksPerSec);
+    m_usage.rss_kb = rss * static_cast<unsigned long>(PageKB);
+    m_usage.peak_rss_kb = std::max( m_usage.peak_rss_kb, m_usage.rss_kb );
+    std::ifstream iof( proc + "/io" );
+    std::string key;
+    unsigned long long value;
+    while (iof >> key >> value) {
+        if ("read_bytes:" == key) { m_usage.read_bytes = value; }
+        if ("write_bytes:" == key) { m_usage.write_bytes = value; }
+    }
+    //
+    if (m_limit_hit) {
+        return;                 // already told to go
+    }
+    bool cpu_over = (m_max_cpu_pct > 0) and (m_usage.samples >= 3)
+        and (m_usage.cpu_pct > m_max_cpu_pct);
+    bool rss_over = m_max_rss_kb and (m_usage.rss_kb > m_max_rss_kb);
+    if (cpu_over or rss_over) {
+        LOG_WARNING(Lgr) << "Child_mgr " << m_name << " pid=" << m_pid
+                         << " over its soft limit of "
+                         << (cpu_over ? m_max_cpu_pct
+                             : static_cast<double>(m_max_rss_kb)/1024.0)
+                         << (cpu_over ? "% cpu" : " MB resident")
+                         << "--terminating it";
+        log_usage( "using" );
+        m_limit_hit = true;
+        if (kill( m_pid, SIGTERM )) {
+            LOG_WARNING(Lgr) << "Child_mgr failed to terminate " << m_name
+                             << ": " << strerror(errno);
+        }
+    }
+}
+
+/// Complete m_usage with the resource use wait4 reported at exit.
+/// Called by reap() with c_mutex held.
+///
+void Child_mgr::note_rusage( const struct rusage &ru )
+{
+    m_usage.cpu_secs = static_cast<double>(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)
+        + static_cast<double>(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+    m_usage.peak_rss_kb = std::max( m_usage.peak_rss_kb,
+                                    static_cast<unsigned long>(ru.ru_maxrss) );
+    m_usage.read_bytes = std::max( m_usage.read_bytes,
+        static_cast<unsigned long long>(ru.ru_inblock) * 512ULL );
+    m_usage.write_bytes = std::max( m_usage.write_bytes,
+        static_cast<unsigned long long>(ru.ru_oublock) * 512ULL );
+}
+
+/// Log the resource use of the current or last run, prefixed by what.
+///
+void Child_mgr::log_usage( const char *what ) const
+{
+    constexpr double MB { 1024.0*1024.0 };
+    LOG_INFO(Lgr) << "Child_mgr " << m_name << " " << what << " cpu "
+                  << m_usage.cpu_secs << " s (now " << m_usage.cpu_pct
+                  << "%, peak " << m_usage.peak_cpu_pct << "%), rss "
+                  << m_usage.rss_kb/1024 << " MB (peak "
+                  << m_usage.peak_rss_kb/1024 << " MB), read "
+                  << static_cast<double>(m_usage.read_bytes)/MB << " MB, wrote "
+                  << static_cast<double>(m_usage.write_bytes)/MB << " MB";
+}
+
 /// Return the number of failures at or after time pt
 ///
 unsigned Child_mgr::fails_since( time_t pt ) const
@@ -292,14 +892,16 @@ time_t Child_mgr::uptime() const
     return 0;
 }
 
-/// Check run status and return true if child is running.
+/// Return true if the child was running as of the last reap (see
+/// refresh).
 ///
 bool Child_mgr::running() const
 {
     return (m_obs_phase==ChildPhase::running);
 }
 
-/// Returns true if the observed phase is "gone".
+/// Returns true if the observed phase, as of the last reap (see
+/// refresh), is "gone".
 /// NOTE: This does not imply *successful* completion....
 ///
 bool Child_mgr::completed() const
@@ -380,11 +982,16 @@ void Child_mgr::clear_args()
 /// considered a normal exit) or was killed, reason=CLD_KILLED.
 /// Track run time if it was a non-zero status or ran too briefly.
 ///
-/// N.B. This is called within SIGCHLD signal handler, so no I/O or other
-/// unsafe function calls. It should never throw an exception.
+/// N.B. This is called by reap() with c_mutex held.
+/// It should never throw an exception.
 ///
 void Child_mgr::postmortem( int status, int reason )
 {
+    c_by_pid.erase( m_pid );
+    if (m_pidfd >= 0) {
+        close( m_pidfd );
+        m_pidfd = -1;
+    }
     m_old_pid = m_pid;
     m_pid = NOTAPID;
     m_exit_status = status;
@@ -396,6 +1003,14 @@ void Child_mgr::postmortem( int status, int reason )
     if ((m_exit_status != 0) or (run_secs < m_min_run)) {
         m_fails.push_back( m_exit_time );   // remember this failure time
     }
+    log_usage( "exited, used" );
+    if (m_capture) {
+        drain_capture();
+        if ((m_exit_status != 0) and not m_terminate) {
+            m_capture->dump( (CLD_KILLED == reason) ? "was killed"
+                             : "exited with an error" );
+        }
+    }
     if (m_pty) { // If there is a pty, close it immediately (safe).
         m_pty->close_pty();
     }
@@ -406,8 +1021,7 @@ void Child_mgr::postmortem( int status, int reason )
 ///    gone, paused, running, completed, unknown
 /// Member _pid may be zeroed if the process no longer observed.
 ///
-/// N.B. This is called within the SIGCHLD handler, so no I/O or other
-/// unsafe function calls.
+/// N.B. This is called by reap() with c_mutex held.
 ///
 /// * Will not throw
 ///
@@ -463,26 +1077,33 @@ void Child_mgr::signal_child(int sig)
 /// Wait up to wait_us MICROseconds for the observed phase to
 /// transition to phase indicated by argument "tgt_phase".  Return
 /// true if the observed phase is is the desired target phase.
+/// The wait blocks until the child's pidfd or a SIGCHLD says
+/// something has changed.
 ///
 /// * Will NOT throw
 ///
 bool Child_mgr::wait_for_phase( ChildPhase tgt_phase, long wait_us )
 {
-    time_t secs = wait_us / 1'000'000;
-    long     us = wait_us - secs*1000;
-    struct timespec rem_ts { secs, us*1000 };
-
-    while (m_obs_phase != tgt_phase) {
-        struct timespec wait_ts = rem_ts;
-        errno = 0;
-        int rc = nanosleep( &wait_ts, &rem_ts );
-        if (0 == rc) break;  // full wait accomplished
-        if (errno != EINTR) {
-            LOG_ERROR(Lgr) << "Child_mgr " << m_name << " wait for phase "
-                           << phase_name(tgt_phase)
-                           << " failed on error " << errno;
-            break;
-        } // else: interrupted, continue to wait the remaining rem_ts
+    using namespace std::chrono;
+    auto deadline = steady_clock::now() + microseconds(wait_us);
+    Child_waiter waiter {};
+    for (;;) {
+        reap();
+        if (m_obs_phase == tgt_phase) break;
+        auto ms = duration_cast<milliseconds>( deadline - steady_clock::now()
+                                               + microseconds(999) ).count();
+        if (ms <= 0) break;
+        std::vector<struct pollfd> fds {};
+        if ((ChildPhase::gone == tgt_phase) and (m_pidfd >= 0)) {
+            fds.push_back( {m_pidfd, POLLIN, 0} );
+        }
+        if (waiter.fd() >= 0) {
+            fds.push_back( {waiter.fd(), POLLIN, 0} );
+        } else {
+            ms = std::min( ms, 10L );
+        }
+        wait_readable( fds, static_cast<int>(ms) );
+        waiter.consume();
     }
     if (m_obs_phase != tgt_phase) {
         LOG_WARNING(Lgr) << "Child " << m_name << "(" << m_pid
@@ -591,7 +1212,9 @@ void Child_mgr::kill_child( bool force, long wait_us )
     if (0 == res) {
         LOG_DEBUG(Lgr) << "Child_mgr killed " << m_name << " pid=" << m_pid
             << " signal=" << (SIGTERM==m_terminate ? "SIGTERM" : "SIGKILL");
-        wait_for_phase( ChildPhase::gone, wait_us );
+        if (wait_us > 0) {
+            wait_for_phase( ChildPhase::gone, wait_us );
+        }
     }
     else { // not much we can do if we cannot even send the signal
         presume_dead( res );
@@ -607,6 +1230,7 @@ void Child_mgr::kill_child( bool force, long wait_us )
 ///
 void Child_mgr::presume_dead( int /* rc */ )
 {
+    forget_pid();
     m_obs_phase = ChildPhase::gone;
     m_old_pid = m_pid;
     m_pid = NOTAPID;
@@ -614,10 +1238,28 @@ void Child_mgr::presume_dead( int /* rc */ )
     /* m_start_time = 0; */ // leave for possible postmortem
 }
 
-/// Launch the child process.  Clear args, then add arguments prior to
-/// calling this function. Adding args prior to call must be
-/// done for *every* invocation.  If a child is already running, it will
-/// be killed ungently (sigkill) first.
+/// Stop tracking m_pid: any further news of it will be ignored.
+///
+/// *  Will NOT throw.
+///
+void Child_mgr::forget_pid()
+{
+    std::lock_guard<std::mutex> lock( c_mutex );
+    if (NOTAPID != m_pid) {
+        c_by_pid.erase( m_pid );
+    }
+    if (m_pidfd >= 0) {
+        close( m_pidfd );
+        m_pidfd = -1;
+    }
+}
+
+/// Launch the child process: by posix_spawn, unless set_spawn(false)
+/// or the child needs something spawn cannot do here, else by fork and
+/// exec.  Clear args, then add arguments prior to calling this
+/// function. Adding args prior to call must be done for *every*
+/// invocation.  If a child is already running, it will be killed
+/// ungently (sigkill) first.
 ///
 /// * May throw CM_start_exception.
 ///
@@ -638,6 +1280,9 @@ void Child_mgr::start_child()
     //
     m_exit_status = 0;
     m_terminate = 0;
+    m_usage = Child_usage{};
+    m_last_ticks = 0;
+    m_limit_hit = false;
     m_start_time = 0;
     m_exit_time = 0;
     m_kill_time = 0;
@@ -647,22 +1292,162 @@ void Child_mgr::start_child()
         m_pty->open_pty();
     }
 
-    if (-1 == (m_pid = fork())) {
-        LOG_ERROR(Lgr) << "Child_mgr for " << m_name << " failed to fork "
-                       << m_bin_path ;
-        throw CM_start_exception();
+    forget_pid();
+    int exec_fds[2] { -1, -1 };     // forked child's write end closes on exec
+    {
+        // Hold c_mutex so the child cannot be reaped before it is known.
+        std::lock_guard<std::mutex> lock( c_mutex );
+        if (m_capture and not m_pty) {
+            close_capture();
+            if (c_captures) {
+                m_capture->open_pipe();
+            }
+        }
+        close_input();
+        if (m_input_bytes and not m_pty) {
+            int fds[2];
+            if (pipe2( fds, O_CLOEXEC )) {
+                LOG_ERROR(Lgr) << "Child_mgr for " << m_name
+                               << " cannot make a stdin pipe: " << strerror(errno);
+                throw CM_start_exception();
+            }
+            m_in_rfd = fds[0];
+            m_in_wfd = fds[1];
+            fcntl( m_in_wfd, F_SETPIPE_SZ, static_cast<int>(m_input_bytes) );
+        }
+        if (c_spawn and (SpawnChdir or m_chdir.empty())
+            and (SpawnSetsid or not m_pty) and m_policy.spawnable()) {
+            m_pid = spawn_child_binary(argv);
+        } else if (not m_policy.empty() and pipe2( exec_fds, O_CLOEXEC )) {
+            LOG_ERROR(Lgr) << "Child_mgr for " << m_name << " cannot make a pipe: "
+                           << strerror(errno);
+            throw CM_start_exception();
+        } else if (-1 == (m_pid = fork())) {
+            LOG_ERROR(Lgr) << "Child_mgr for " << m_name << " failed to fork "
+                           << m_bin_path ;
+            if (exec_fds[0] >= 0) {
+                close( exec_fds[0] );
+                close( exec_fds[1] );
+            }
+            throw CM_start_exception();
+        }
+        if (m_pid != 0) {
+            // nonzero pid:  I am running in the parent process...
+            m_start_time = time(0);
+            m_obs_phase = ChildPhase::running;
+            m_pidfd = open_pidfd( m_pid );
+            c_by_pid[ m_pid ] = shared_from_this();
+            watch_capture();
+            if (m_in_rfd >= 0) {
+                close( m_in_rfd );      // the child's now
+                m_in_rfd = -1;
+            }
+        }
     }
     if (m_pid != 0) {
-        // nonzero pid:  I am running in the parent process...
-        m_start_time = time(0);
-        m_obs_phase = ChildPhase::running;
-        LOG_INFO(Lgr) << "Child_mgr started " << m_name 
+        LOG_INFO(Lgr) << "Child_mgr started " << m_name
                       << " child pid=" << m_pid ;
+        if (exec_fds[0] >= 0) {
+            // EOF once the forked child has applied its policy and exec'd
+            close( exec_fds[1] );
+            char c;
+            while ((read( exec_fds[0], &c, 1 ) < 0) and (EINTR == errno)) { }
+            close( exec_fds[0] );
+        }
+        report_policy();
         return;
     }
     launch_child_binary(argv);
 }
 
+/// Launch the child binary with posix_spawn, doing in its file actions
+/// and attributes what launch_child_binary does after a fork: clear the
+/// signal mask, attach the pty, change directory, set any SCHED_RR
+/// priority, and (with a recent enough C library) close every other
+/// descriptor.  Unlike the fork
+/// path, failure to exec the binary is reported here.  Returns the pid.
+///
+/// * May throw CM_start_exception
+///
+pid_t Child_mgr::spawn_child_binary(std::vector<const char*> &argv)
+{
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t acts;
+    posix_spawnattr_init( &attr );
+    posix_spawn_file_actions_init( &acts );
+    sigset_t none;
+    sigemptyset( &none );
+    posix_spawnattr_setsigmask( &attr, &none );
+    short flags = POSIX_SPAWN_SETSIGMASK;
+    int rc = 0;
+    pid_t pid = NOTAPID;
+    try {
+        if (m_pty) {
+#ifdef POSIX_SPAWN_SETSID
+            flags |= POSIX_SPAWN_SETSID;
+#endif
+            m_pty->spawn_init( &acts );
+        } else if (m_capture) {
+            m_capture->spawn_init( &acts );
+        }
+        if ((m_in_rfd >= 0) and not m_pty) {
+            rc = posix_spawn_file_actions_adddup2( &acts, m_in_rfd, STDIN_FILENO );
+        }
+#if SPAWN_CHDIR
+        // A failed chdir action would fail the whole spawn; the fork
+        // path logs it and runs the child anyway, so do the same here.
+        if (not m_chdir.empty()) {
+            struct stat sb;
+            if (stat( m_chdir.c_str(), &sb ) or not S_ISDIR(sb.st_mode)
+                or access( m_chdir.c_str(), X_OK )) {
+                LOG_ERROR(Lgr) << "Child_mgr fails to change working directory to"
+                               << m_chdir;
+            } else {
+                rc = posix_spawn_file_actions_addchdir_np( &acts, m_chdir.c_str() );
+            }
+        }
+#endif
+#if SPAWN_CLOSEFROM
+        if (0 == rc) {
+            rc = posix_spawn_file_actions_addclosefrom_np( &acts, STDERR_FILENO+1 );
+        }
+#endif
+        if (m_policy.rt_priority) {
+            struct sched_param sp {};
+            sp.sched_priority = static_cast<int>(m_policy.rt_priority);
+            posix_spawnattr_setschedpolicy( &attr, SCHED_RR );
+            posix_spawnattr_setschedparam( &attr, &sp );
+            flags |= POSIX_SPAWN_SETSCHEDULER;
+        }
+        posix_spawnattr_setflags( &attr, flags );
+        if (0 == rc) {
+            rc = posix_spawn( &pid, m_bin_path.c_str(), &acts, &attr,
+                              const_cast<char* const*>(&argv[0]), environ );
+        }
+        if ((EPERM == rc) and (flags & POSIX_SPAWN_SETSCHEDULER)) {
+            // Not allowed SCHED_RR: run it anyway, as the fork path
+            // would, and let report_policy() warn.
+            flags &= static_cast<short>(~POSIX_SPAWN_SETSCHEDULER);
+            posix_spawnattr_setflags( &attr, flags );
+            rc = posix_spawn( &pid, m_bin_path.c_str(), &acts, &attr,
+                              const_cast<char* const*>(&argv[0]), environ );
+        }
+    } catch (const Chpty_exception &) {
+        rc = errno;
+    }
+    if (m_pty) {
+        m_pty->spawn_done();
+    }
+    posix_spawn_file_actions_destroy( &acts );
+    posix_spawnattr_destroy( &attr );
+    if (rc) {
+        LOG_ERROR(Lgr) << "Child_mgr for " << m_name << " failed to spawn "
+                       << m_bin_path << ": " << strerror(rc);
+        throw CM_start_exception();
+    }
+    return pid;
+}
+
 /// This run only in the child process.
 /// Prepare file handles.  Exec the child binary.
 ///
@@ -670,9 +1455,21 @@ void Child_mgr::launch_child_binary(std::vector<const char*> &argv)
 {
     // TODO: close open files and drop privilege (if needed)
 
-    // Prepare the pty, if enabled
+    // The parent may block signals to read them on a signalfd; the
+    // mask would survive the exec, so give the child a clean one.
+    sigset_t none;
+    sigemptyset( &none );
+    sigprocmask( SIG_SETMASK, &none, nullptr );
+    apply_policy();
+
+    // Prepare the pty, if enabled, or else the capture pipe
     if (m_pty) {
         m_pty->child_init();
+    } else if (m_capture) {
+        m_capture->child_init();
+    }
+    if ((m_in_rfd >= 0) and not m_pty) {
+        dup2( m_in_rfd, STDIN_FILENO );
     }
 
     // Change Directory if indicated by m_chdir; if this fails we still try
@@ -697,6 +1494,7 @@ void Child_mgr::launch_child_binary(std::vector<const char*> &argv)
 ///
 void Child_mgr::clear_status()
 {
+    forget_pid();
     m_obs_phase = ChildPhase::gone;
     m_exit_reason = 0;  // Not a valid CLD_reason--ignored on check
     m_terminate = 0;
@@ -723,6 +1521,7 @@ void Child_mgr::clear_status()
 ///
 bool Child_mgr::check_child(RunCond &cond)
 {
+    refresh();
     bool rc=true;
     switch (m_obs_phase) {
     case ChildPhase::gone:
@@ -911,6 +1710,26 @@ ssize_t Child_mgr::pty_read_nb( std::string &s, ssize_t maxbytes)
     return m_pty->read_nb(s, maxbytes);
 }
 
+/// Read from the child until the reply ends with term, up to maxbytes
+/// in length or usecs microseconds.  True if term was seen.
+/// * May throw
+///
+bool Child_mgr::pty_read_until( std::string &s, ssize_t maxbytes,
+                                const std::string &term, long usecs )
+{
+    if (not m_pty) throw CM_no_pty_exception();
+    return m_pty->read_until( s, maxbytes, term, usecs );
+}
+
+/// Discard any unread output from the child.
+/// * May throw
+///
+ssize_t Child_mgr::pty_discard()
+{
+    if (not m_pty) throw CM_no_pty_exception();
+    return m_pty->discard();
+}
+
 /// Write the string to the child's stdin.
 /// * May throw
 ///
@@ -20,11 +20,15 @@
 
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <mutex>
 #include <list>
 #include <memory>
 #include <climits>
+#include <unordered_map>
 #include <utility>
 
 #include <boost/filesystem.hpp>
@@ -32,7 +36,9 @@
 #include "logging.hpp"
 
 #include "cmexceptions.hpp"
+#include "chcapture.hpp"
 #include "chpty.hpp"
+#include "evloop.hpp"
 
 /// Some symbolic values used in Child_mgr:
 ///
@@ -61,6 +67,41 @@ enum class RunCond {
 };
 
 
+/// Resource use of one run of a child process, sampled from /proc
+/// while it runs and completed from wait4() when it exits.
+///
+struct Child_usage {
+    unsigned long samples {0};          // /proc samples taken
+    double cpu_pct {0};                 // smoothed, percent of one core
+    double peak_cpu_pct {0};            // highest over a sample interval
+    double cpu_secs {0};                // user+system time so far
+    unsigned long rss_kb {0};           // resident set at last sample
+    unsigned long peak_rss_kb {0};      // highest resident set seen
+    unsigned long long read_bytes {0};  // read from storage
+    unsigned long long write_bytes {0}; // written to storage
+};
+
+
+/// How a child process should be scheduled, relative to rsked and the
+/// rest of the system.  The defaults leave it as inherited from rsked.
+///
+struct Child_policy {
+    bool set_nice {false};              // apply nice?
+    int nice {0};                       // -20 (favored) .. 19
+    unsigned rt_priority {0};           // SCHED_RR priority 1..99, 0 for none
+    unsigned long cpu_mask {0};         // allowed CPUs, bit n for cpu n; 0 any
+    int io_class {0};                   // 1 realtime, 2 best-effort, 3 idle
+    int io_level {4};                   // 0 (favored) .. 7, within class
+    bool empty() const {
+        return not set_nice and not rt_priority and not cpu_mask
+            and not io_class;
+    }
+    bool spawnable() const {            // posix_spawn can set only SCHED_RR
+        return not set_nice and not cpu_mask and not io_class;
+    }
+};
+
+
 ///////////////////////////////////////////////////////////////////////
 
 /**
@@ -73,6 +114,16 @@ enum class RunCond {
  *
  * This class will takeover the SIGCHLD handler on creation of the first
  * instance, and assumes that no other code will change that handler.
+ * The handler does nothing but bump an eventfd, event_fd(), so that an
+ * event loop may wake whenever some child changes state; children are
+ * reaped by reap(), outside of signal context, as are they by
+ * check_child(), sample_all() and the waits.  The phase accessors
+ * (running, completed, last_obs_phase) only report the state as of the
+ * last reap: call refresh() (or clear_events) first for news.  The
+ * phases are atomic, so the accessors may be called from any thread
+ * (e.g. a player's worker) while another reaps.  Each child also has
+ * a pidfd (where the kernel supports them) on which waits for its
+ * death block.
  *
  * Typical usage:
  *
@@ -84,7 +135,7 @@ enum class RunCond {
  *   cm->add_arg("-c");
  *   cm->add_arg( my_param );
  *   cm->start_child();
- *      //  fork/exec binary
+ *      //  posix_spawn (or fork/exec) binary
  *      //  expect get_pid() > 0, and (soon) last_obs_phase()==running
  *
  *   cm->check_child()
@@ -93,26 +144,53 @@ enum class RunCond {
  *   cm->kill_child()
  *      # signals child to die.
  *
+ * sample_all() should be called periodically to keep the resource
+ * use of each child (usage()) current, log it hourly, and enforce any
+ * soft limits (set_limits) by terminating the child so that its owner
+ * will restart it as after any other abnormal exit.
+ *
+ * A Child_policy (set_policy) is applied by each new child to itself
+ * before it execs the binary, so before it can start any threads:
+ * SCHED_RR through the posix_spawn attributes, anything else by forking
+ * instead.  The scheduling the child actually got is then logged.
+ *
+ * With enable_capture, the stdout and stderr of the child go to a
+ * pipe rather than wherever rsked's own go.  All capture pipes are
+ * watched by a private event loop whose descriptor, capture_fd(), an
+ * outer event loop should watch, calling drain_captures() whenever it
+ * is readable.  Should the child fail, its last output is logged.
+ * Likewise with enable_input, the child's stdin is a pipe, whose other
+ * end (input_fd) the owner may write to.
+ *
  * Caution:  not completely thread safe.
  */
 class Child_mgr : public std::enable_shared_from_this<Child_mgr>
 {
 private:
     static std::list<std::shared_ptr<Child_mgr>> c_instances;
+    static std::unordered_map<pid_t,std::weak_ptr<Child_mgr>> c_by_pid;
     static std::mutex c_mutex;
     static bool CM_ready;
+    static bool c_spawn;                          // launch by posix_spawn
+    static std::unique_ptr<Event_fd> c_events;
+    static std::unique_ptr<Event_loop> c_captures; // watches capture pipes
+    static std::atomic<unsigned> c_sigchld_gen;   // SIGCHLDs handled
+    static std::atomic<unsigned> c_reaped_gen;    // ...as of the last reap
+    static std::chrono::steady_clock::time_point c_usage_logged;
     static std::shared_ptr<Child_mgr> find_child( pid_t );
     static void sigchld_handler(int);
     static void setup_sigchld_handler();
+    static bool wait_all_gone( long );  // usecs
     //
     pid_t m_pid {NOTAPID};             // last pid seen running
+    int m_pidfd {-1};                  // pidfd for m_pid, if any
     pid_t m_old_pid {NOTAPID};         // pid before that, if any
     int m_exit_status {0};             // last exit status of child
     int m_exit_reason {0};             // CLD_EXITED or CLD_KILLED
     int m_terminate   {0};             // last kill signal (0 if none)
     unsigned m_updates {0};            // signals handled
-    ChildPhase m_cmd_phase = ChildPhase::gone;  // commanded phase
-    ChildPhase m_obs_phase = ChildPhase::gone;  // observed phase
+    std::atomic<ChildPhase> m_cmd_phase { ChildPhase::gone };  // commanded phase
+    std::atomic<ChildPhase> m_obs_phase { ChildPhase::gone };  // observed phase
     std::vector<std::string> m_args {};   // cached args
     boost::filesystem::path m_chdir {}; // working directory for executable
     boost::filesystem::path m_bin_path; // application pathname
@@ -125,11 +203,33 @@ private:
     boost::circular_buffer<time_t> m_fails { 5 };  // abnormal exit times
     std::string m_name {};             // user friendly name (optional)
     std::unique_ptr<Pty_controller> m_pty {};   // pseudoterminal
+    std::unique_ptr<Output_capture> m_capture {}; // stdout+stderr, or null
+    size_t m_input_bytes {0};          // stdin pipe capacity, 0 for no pipe
+    int m_in_rfd {-1};                 // child's end of stdin pipe, at launch
+    int m_in_wfd {-1};                 // our end of stdin pipe
+    Child_usage m_usage {};            // resource use of the current run
+    unsigned long m_last_ticks {0};    // cpu clock ticks at last sample
+    std::chrono::steady_clock::time_point m_last_sample {};
+    double m_max_cpu_pct {0};          // soft limits, 0 for none
+    unsigned long m_max_rss_kb {0};
+    bool m_limit_hit {false};          // terminated for exceeding a limit
+    Child_policy m_policy {};          // scheduling for the child
     //
+    void apply_policy();
+    void report_policy();
     bool check_child_gone( RunCond &);
     bool check_child_paused( RunCond &);
     bool check_child_running( RunCond &);
+    void close_capture();
+    void close_input();
+    void drain_capture();
+    void forget_pid();
+    void watch_capture();
+    void log_usage( const char* ) const;
+    void note_rusage( const struct rusage & );
+    void sample_usage();
     void launch_child_binary(std::vector<const char*>&);
+    pid_t spawn_child_binary(std::vector<const char*>&);
     void postmortem( int, int );
     void presume_dead( int );
     void update_status( siginfo_t & );
@@ -137,12 +237,21 @@ private:
     Child_mgr( const boost::filesystem::path );
 
 public:
+    static int capture_fd();
     static const char* cond_name( RunCond );
+    static void clear_events();
+    static void drain_captures();
+    static int event_fd();
     static const char* phase_name( ChildPhase );
     static void kill_all();
     static void ListInstances();
     static void purge();
+    static void reap();
+    static void refresh() { if (c_sigchld_gen != c_reaped_gen) { reap(); } }
     static unsigned run_count();
+    static void sample_all();
+    static void set_spawn( bool );
+    static bool spawn_enabled() { return c_spawn; }
     //
     void add_arg(const char *);
     void add_arg( const std::string& );
@@ -153,11 +262,14 @@ public:
     ChildPhase cmd_phase() const { return m_cmd_phase; }
     bool completed() const;
     void cont_child(long wait_us=0);
+    void enable_capture( size_t );    // ring bytes, 0 to disable
+    void enable_input( size_t );      // pipe bytes, 0 to disable
     unsigned fails_since(time_t) const;
     int get_exit_reason() const { return m_exit_reason; }
     int get_exit_status() const { return m_exit_status; }
     const std::string & get_name() const { return m_name; }
     pid_t get_pid() const { return m_pid; }
+    int input_fd() const { return m_in_wfd; }
     void kill_child(bool force=false, long wait_us=0 );
     int last_exit_status() const { return m_exit_status; }
     ChildPhase last_obs_phase() const { return m_obs_phase; }
@@ -165,13 +277,16 @@ public:
     void set_max_run( time_t );
     void set_min_run( time_t );
     void set_binary( const boost::filesystem::path & );
+    void set_limits( double, unsigned long );  // cpu %, rss KB
     void set_name(const std::string&);
+    void set_policy( const Child_policy& );
     void set_wdir(const boost::filesystem::path &);
     void signal_child(int);
     void start_child();
     void stop_child(long wait_us=0);
     unsigned updates() { return m_updates; }
     time_t uptime() const;
+    const Child_usage& usage() const { return m_usage; }
     bool wait_for_phase( ChildPhase, long ); // usecs
     // pseudoterminal methods
     void enable_pty();
@@ -181,6 +296,8 @@ public:
     void set_pty_write_timeout( long, long );  // secs, usecs
     void set_pty_window_size(unsigned,unsigned);
     ssize_t pty_read_nb( std::string&, ssize_t ); // max bytes
+    bool pty_read_until( std::string&, ssize_t, const std::string&, long );
+    ssize_t pty_discard();
     ssize_t pty_write_nb( const std::string& );
     // factory
     template<typename... Ts>
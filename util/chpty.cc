@@ -2,17 +2,46 @@
 
 // define _XOPEN_SOURCE 600
 
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 
 #include "logging.hpp"
 
-/// CTOR which will take termios attributes from current STDIN
+/// Milliseconds of timeval tv for poll(), rounded up so that a short
+/// but nonzero wait is not taken as "do not wait".
+///
+static int timeval_ms( const struct timeval &tv )
+{
+    long ms = tv.tv_sec * 1000L + (tv.tv_usec + 999L) / 1000L;
+    return static_cast<int>( std::min( ms, static_cast<long>(INT_MAX) ) );
+}
+
+/// Deduct from tv the time since start, but not below zero.
+///
+static void deduct_elapsed( struct timeval &tv,
+                            std::chrono::steady_clock::time_point start )
+{
+    using namespace std::chrono;
+    auto left = microseconds( tv.tv_sec * 1'000'000L + tv.tv_usec )
+        - duration_cast<microseconds>( steady_clock::now() - start );
+    if (left.count() < 0) {
+        left = microseconds(0);
+    }
+    tv.tv_sec = static_cast<time_t>( left.count() / 1'000'000 );
+    tv.tv_usec = static_cast<suseconds_t>( left.count() % 1'000'000 );
+}
+
+/// CTOR which will take termios attributes from current STDIN, if
+/// that is a terminal; otherwise the pty keeps its defaults.
 ///
 Pty_controller::Pty_controller()
 {
-    if (tcgetattr(STDIN_FILENO, &m_termios)) {
+    if (0 == tcgetattr(STDIN_FILENO, &m_termios)) {
         m_valid_termios = true;
     }
 }
@@ -91,30 +120,29 @@ void Pty_controller::set_write_timeout( long secs, long usecs )
     }
 }
 
-/// Check if there is data to be read on the controlling file descriptor.
-/// waiting up to the read timeout period for some data to arrive.
-/// It will ignore signals that may interrupt the wait.
-/// Return 0 if no data ready (or pty closed), nonzero otherwise.
+/// Wait up to tv for data to read on the controlling file descriptor.
+/// Signals that interrupt the wait are ignored, the wait resuming for
+/// whatever is left of tv.  (poll, unlike select, copes with any
+/// descriptor number.)  Return 0 if no data ready (or pty closed),
+/// nonzero otherwise.
 ///
 /// *  May throw Chpty_read_exception
 ///
-int Pty_controller::can_read()
+int Pty_controller::await_read( struct timeval &tv )
 {
     if (non_fd == m_cfd) {
         return 0;
     }
-    struct timeval tv = m_rtimeout;
     while (1) {
-        fd_set fds;
-        FD_ZERO(&fds);
-        FD_SET( m_cfd, &fds);
+        struct pollfd pfd { m_cfd, POLLIN, 0 };
         errno = 0;
-        //                        RD    WR    XC    time remaining
-        int rc = select( m_cfd+1, &fds, NULL, NULL, &tv );
+        auto start = std::chrono::steady_clock::now();
+        int rc = poll( &pfd, 1, timeval_ms( tv ) );
         if (0 < rc) {
-            return FD_ISSET( m_cfd, &fds );
+            return (pfd.revents & (POLLIN|POLLHUP|POLLERR)); // as select
         }
         else if (0 == rc) {  // timeout occurred
+            tv = {0, 0};
             return 0;
         }
         else  if (libc_err == rc) {
@@ -122,10 +150,24 @@ int Pty_controller::can_read()
                 throw Chpty_read_exception();
             }
         }
-        LOG_DEBUG(Lgr) << "Pty_controller::can_read() select timeout interrupted.";
+        deduct_elapsed( tv, start );
+        LOG_DEBUG(Lgr) << "Pty_controller::can_read() poll timeout interrupted.";
     }
 }
 
+/// Check if there is data to be read on the controlling file descriptor.
+/// waiting up to the read timeout period for some data to arrive.
+/// It will ignore signals that may interrupt the wait.
+/// Return 0 if no data ready (or pty closed), nonzero otherwise.
+///
+/// *  May throw Chpty_read_exception
+///
+int Pty_controller::can_read()
+{
+    struct timeval tv = m_rtimeout;
+    return await_read( tv );
+}
+
 /// Check if there is space for data to be written on the controlling
 /// file descriptor, waiting up to the write timeout period for space
 /// to become available.  Return 0 if not ready (or pty closed),
@@ -138,19 +180,15 @@ int Pty_controller::can_write()
     if (non_fd == m_cfd) {
         return 0;
     }
-    struct timeval tv = m_wtimeout;
-    fd_set fds;
-    FD_ZERO(&fds);
-    FD_SET( m_cfd, &fds);
-    //                        RD    WR    XC    timeout
-    int rc = select( m_cfd+1, NULL, &fds, NULL, &tv );
+    struct pollfd pfd { m_cfd, POLLOUT, 0 };
+    int rc = poll( &pfd, 1, timeval_ms( m_wtimeout ) );
     if (libc_err == rc) {
         throw Chpty_write_exception();
     }
     if (0 == rc) {   // timeout occurred
         return 0;
     }
-    return FD_ISSET(m_cfd, &fds);
+    return (pfd.revents & (POLLOUT|POLLHUP|POLLERR));
 }
 
 
@@ -233,6 +271,85 @@ ssize_t Pty_controller::read_nb( std::string &dst, ssize_t maxlen )
 }
 
 
+/// Read from the pty, *appending* into string dst, until dst ends with
+/// the string term (e.g. the remote program's prompt), dst reaches
+/// maxlen, or usecs microseconds pass.  Returns true if dst ends with
+/// term.  Unlike read_nb(), a reply is complete as soon as its
+/// terminator arrives, so there is no lingering read timeout; the
+/// full usecs is spent only if the terminator never comes.
+///
+/// * May throw Chpty_read_exception()
+///
+bool Pty_controller::read_until( std::string &dst, ssize_t maxlen,
+                                 const std::string &term, long usecs )
+{
+    if (non_fd == m_cfd) {
+        throw Chpty_read_exception();
+    }
+    using namespace std::chrono;
+    auto deadline = steady_clock::now() + microseconds(usecs);
+    auto ends_with_term = [&dst,&term] {
+        return (dst.size() >= term.size())
+            and (0 == dst.compare( dst.size()-term.size(), term.size(), term ));
+    };
+    while (static_cast<ssize_t>(dst.size()) < maxlen) {
+        auto left = duration_cast<microseconds>( deadline - steady_clock::now() );
+        if (left.count() < 0) {
+            break;
+        }
+        struct timeval tv { static_cast<time_t>(left.count() / 1'000'000),
+                            static_cast<suseconds_t>(left.count() % 1'000'000) };
+        if (0 == await_read( tv )) {
+            break;
+        }
+        errno = 0;
+        ssize_t rc = read( m_cfd, m_read_buf, sizeof(m_read_buf) );
+        if (libc_err == rc) {
+            if (EINTR == errno) {
+                continue;
+            }
+            throw Chpty_read_exception();
+        }
+        if (0 == rc) {
+            break;
+        }
+        dst.append( m_read_buf, static_cast<size_t>(rc) );
+        if (ends_with_term()) {
+            return true;
+        }
+    }
+    return ends_with_term();
+}
+
+/// Throw away anything the remote program has written that has not
+/// been read yet, e.g. a late reply to an earlier command. Does not
+/// wait.  Returns the number of bytes discarded.
+///
+/// * May throw Chpty_read_exception()
+///
+ssize_t Pty_controller::discard()
+{
+    ssize_t n = 0;
+    for (;;) {
+        struct timeval tv { 0, 0 };
+        if (0 == await_read( tv )) {
+            break;
+        }
+        ssize_t rc = read( m_cfd, m_read_buf, sizeof(m_read_buf) );
+        if (libc_err == rc) {
+            if (EINTR == errno) {
+                continue;
+            }
+            throw Chpty_read_exception();
+        }
+        if (0 == rc) {
+            break;
+        }
+        n += rc;
+    }
+    return n;
+}
+
 
 ////////////////////////////////////////////////////////////////////////
 ///                            In Child
@@ -288,3 +405,47 @@ void Pty_controller::child_init()
         m_rfd = non_fd;
     }
 }
+
+/// The equivalent of child_init for a child to be started by
+/// posix_spawn, called in the PARENT.  It sets the terminal attributes
+/// and window size on the remote side now, then adds file actions to
+/// acts that attach it to the child's stdin/stdout/stderr (which also
+/// makes it the controlling terminal, given POSIX_SPAWN_SETSID) and
+/// close the controller.  Call spawn_done after spawning.
+///
+/// * May throw Chpty_*_exceptions
+///
+void Pty_controller::spawn_init( posix_spawn_file_actions_t *acts )
+{
+    spawn_done();
+    m_rfd = open( m_remote_name.c_str(), O_RDWR|O_NOCTTY|O_CLOEXEC );
+    if (libc_err == m_rfd) {
+        throw Chpty_open_exception();
+    }
+    if (m_valid_termios) {
+        if (libc_err == tcsetattr( m_rfd, TCSANOW, &m_termios )) {
+            throw Chpty_termio_exception();
+        }
+    }
+    if (libc_err == ioctl(m_rfd, TIOCSWINSZ, &m_winsize)) {
+        throw Chpty_ioctl_exception();
+    }
+    if (posix_spawn_file_actions_addclose( acts, m_cfd )
+        or posix_spawn_file_actions_addopen( acts, STDIN_FILENO,
+                                             m_remote_name.c_str(), O_RDWR, 0 )
+        or posix_spawn_file_actions_adddup2( acts, STDIN_FILENO, STDOUT_FILENO )
+        or posix_spawn_file_actions_adddup2( acts, STDIN_FILENO, STDERR_FILENO )) {
+        throw Chpty_dup2_exception();
+    }
+}
+
+/// Release the remote side held open by spawn_init, in the PARENT.
+/// * Does NOT throw.
+///
+void Pty_controller::spawn_done()
+{
+    if (m_rfd != non_fd) {
+        close(m_rfd);
+        m_rfd = non_fd;
+    }
+}
@@ -33,9 +33,10 @@
 ///
 /// Parent:
 ///    write_nb() ...
-///    read_nb() ...
+///    read_nb() ...   or  read_until() for prompt-terminated replies
 ///    close_pty()
 
+#include <spawn.h>
 #include <string>
 #include <termios.h>
 #include <sys/ioctl.h>
@@ -61,18 +62,25 @@ private:
     struct timeval m_wtimeout { 0, 10'000 }; // secs, usecs
     std::string m_remote_name {};
     char m_read_buf[ PTYBUFSIZE ];
+    //
+    int await_read( struct timeval& );
 public:
     int can_read();
     int can_write();
     void child_init();
     void close_pty();
+    ssize_t discard();
+    int fd() const { return m_cfd; }
     const std::string& remote_name() const { return m_remote_name; }
     int last_errno() const { return m_errno; }
     void open_pty();
     void set_read_timeout( long, long );  // secs, usecs
     void set_write_timeout( long, long );  // secs, usecs
     void set_window_size(unsigned,unsigned);
+    void spawn_done();
+    void spawn_init( posix_spawn_file_actions_t* );
     ssize_t read_nb( std::string&, ssize_t ); // max bytes
+    bool read_until( std::string&, ssize_t, const std::string&, long );
     ssize_t write_nb( const std::string& );
     //
     Pty_controller();
@@ -0,0 +1,112 @@
+/* Wall clock used by the scheduler; replaceable by a virtual clock
+ */
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <string.h>
+
+#include "clock.hpp"
+
+
+/// The installed source; the system clock until someone installs another.
+///
+std::shared_ptr<Clock_source> Clock::c_source { std::make_shared<System_clock>() };
+
+
+/// Current time from the system.
+///
+time_t System_clock::now()
+{
+    return time(nullptr);
+}
+
+/// Sleep for the given interval. Returns false if a signal cut it short.
+///
+bool System_clock::rest( const struct timespec &ts )
+{
+    return (0 == nanosleep( &ts, nullptr ));
+}
+
+/// Advance virtual time by secs seconds.
+///
+void Virtual_clock::advance( time_t secs )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_now += secs;
+}
+
+/// Current virtual time.
+///
+time_t Virtual_clock::now()
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    return m_now;
+}
+
+/// Set virtual time to t, dropping any fractional second.
+///
+void Virtual_clock::set( time_t t )
+{
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_now = t;
+    m_nsec = 0;
+}
+
+/// Advance virtual time by the interval ts, immediately.
+///
+bool Virtual_clock::rest( const struct timespec &ts )
+{
+    constexpr long NsPerSec { 1'000'000'000L };
+    std::lock_guard<std::mutex> lock( m_mutex );
+    m_nsec += ts.tv_nsec;
+    m_now += ts.tv_sec + (m_nsec / NsPerSec);
+    m_nsec %= NsPerSec;
+    return true;
+}
+
+
+/// Install clock source cs; null restores the system clock.
+/// Not thread safe: install before any other thread consults the Clock.
+///
+void Clock::install( std::shared_ptr<Clock_source> cs )
+{
+    if (cs) {
+        c_source = std::move(cs);
+    } else {
+        c_source = std::make_shared<System_clock>();
+    }
+}
+
+/// Is some clock other than the system clock installed?
+///
+bool Clock::is_virtual()
+{
+    return (nullptr == std::dynamic_pointer_cast<System_clock>(c_source));
+}
+
+/// Set ltm to the current local time.  If the time is unavailable,
+/// ltm will be all zeros (midnight Sunday, Jan 1).
+///
+void Clock::local( struct tm &ltm )
+{
+    time_t t = now();
+    if ((t == time_t(-1)) or not localtime_r( &t, &ltm )) {
+        explicit_bzero( &ltm, sizeof(ltm) );
+    }
+}
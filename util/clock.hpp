@@ -0,0 +1,91 @@
+#pragma once
+/// Wall clock used by the scheduler; replaceable by a virtual clock
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/// Normal usage pattern:
+///
+///    time_t now = Clock::now();      // instead of time(0)
+///    struct tm ltm;
+///    Clock::local( ltm );            // instead of localtime(time(0))
+///    Clock::rest( {2,0} );           // instead of nanosleep/sleep
+///
+/// A simulator installs a Virtual_clock, after which the same calls
+/// read and advance virtual time without actually sleeping:
+///
+///    auto vc = std::make_shared<Virtual_clock>( start );
+///    Clock::install( vc );
+///    ...
+///    Clock::install( nullptr );      // back to the system clock
+
+#include <ctime>
+#include <memory>
+#include <mutex>
+
+
+/// Source of wall clock time, and a way to wait for it to pass.
+///
+class Clock_source {
+public:
+    virtual time_t now() = 0;
+    virtual bool rest( const struct timespec& ) = 0;  // false: interrupted
+    virtual ~Clock_source() {}
+};
+
+
+/// The real clock: time(2) and nanosleep(2).
+///
+class System_clock : public Clock_source {
+public:
+    time_t now() override;
+    bool rest( const struct timespec& ) override;
+};
+
+
+/// Virtual time that only moves when someone rests (or calls advance).
+/// Resting never blocks. Fractional seconds are accumulated.  Safe to
+/// share with player worker threads, which also read the Clock.
+///
+class Virtual_clock : public Clock_source {
+private:
+    std::mutex m_mutex {};
+    time_t m_now;
+    long m_nsec {0};
+public:
+    void advance( time_t );
+    time_t now() override;
+    bool rest( const struct timespec& ) override;
+    void set( time_t );
+    //
+    explicit Virtual_clock( time_t start ) : m_now(start) {}
+};
+
+
+/// Access to the installed Clock_source (System_clock by default).
+///
+class Clock {
+private:
+    static std::shared_ptr<Clock_source> c_source;
+public:
+    static void install( std::shared_ptr<Clock_source> );
+    static bool is_virtual();
+    static void local( struct tm& );                  // local time now
+    static time_t now() { return c_source->now(); }
+    static bool rest( const struct timespec &ts ) { return c_source->rest(ts); }
+};
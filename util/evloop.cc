@@ -0,0 +1,306 @@
+/* Event loop over epoll, and wrappers for the Linux event descriptors
+ * that it typically waits on.
+ */
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#include "evloop.hpp"
+#include "logging.hpp"
+
+
+//////////////////////////// Event_loop ////////////////////////////////
+
+/// CTOR
+/// * May throw Event_loop_exception
+///
+Event_loop::Event_loop()
+{
+    m_epfd = epoll_create1( EPOLL_CLOEXEC );
+    if (m_epfd < 0) {
+        LOG_ERROR(Lgr) << "Event_loop: epoll_create1 failed: "
+                       << strerror(errno);
+        throw Event_loop_exception();
+    }
+}
+
+/// DTOR. Registered descriptors belong to their owners and stay open.
+///
+Event_loop::~Event_loop()
+{
+    if (m_epfd >= 0) {
+        close( m_epfd );
+    }
+}
+
+/// Register descriptor fd, calling handler h when any of the given
+/// epoll events are ready.  Registering an fd again replaces its handler.
+///
+/// * May throw Event_loop_exception
+///
+void Event_loop::add( int fd, Handler h, uint32_t events )
+{
+    struct epoll_event ev {};
+    ev.events = events;
+    ev.data.fd = fd;
+    int op = (m_handlers.count(fd) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD);
+    if (epoll_ctl( m_epfd, op, fd, &ev )) {
+        LOG_ERROR(Lgr) << "Event_loop: cannot watch fd " << fd << ": "
+                       << strerror(errno);
+        throw Event_loop_exception();
+    }
+    m_handlers[fd] = std::move(h);
+}
+
+/// Unregister descriptor fd, if registered.
+/// * Will NOT throw
+///
+void Event_loop::remove( int fd )
+{
+    if (m_handlers.erase(fd)) {
+        epoll_ctl( m_epfd, EPOLL_CTL_DEL, fd, nullptr );
+    }
+}
+
+/// Wait up to timeout_ms milliseconds (-1: indefinitely) for any
+/// registered descriptor to become ready, then call the handlers of
+/// all ready descriptors. Return the number of handlers called; 0 on
+/// timeout or interruption by a signal.
+///
+/// * May throw whatever the handlers throw
+///
+unsigned Event_loop::run_once( int timeout_ms )
+{
+    struct epoll_event evs[MaxEvents];
+    int n = epoll_wait( m_epfd, evs, MaxEvents, timeout_ms );
+    if (n < 0) {
+        if (errno != EINTR) {
+            LOG_ERROR(Lgr) << "Event_loop: epoll_wait failed: "
+                           << strerror(errno);
+        }
+        return 0;
+    }
+    unsigned ncalled = 0;
+    for (int i=0; i<n; i++) {
+        auto it = m_handlers.find( evs[i].data.fd );
+        if (it != m_handlers.end()) {   // may have been removed meanwhile
+            Handler h = it->second;
+            h( evs[i].events );
+            ++ncalled;
+        }
+    }
+    return ncalled;
+}
+
+
+//////////////////////////// Timer_fd ////////////////////////////////
+
+/// CTOR. Clock should be CLOCK_REALTIME for wall clock deadlines or
+/// CLOCK_MONOTONIC for intervals.
+/// * May throw Event_loop_exception
+///
+Timer_fd::Timer_fd( clockid_t clk ) : m_clock(clk)
+{
+    m_fd = timerfd_create( clk, TFD_NONBLOCK|TFD_CLOEXEC );
+    if (m_fd < 0) {
+        LOG_ERROR(Lgr) << "Timer_fd: timerfd_create failed: "
+                       << strerror(errno);
+        throw Event_loop_exception();
+    }
+}
+
+/// DTOR
+///
+Timer_fd::~Timer_fd()
+{
+    if (m_fd >= 0) {
+        close( m_fd );
+    }
+}
+
+/// Expire once at wall clock time t. A realtime timer will also expire
+/// (early) if the system clock is set, e.g. by NTP after boot, so the
+/// deadline can be recomputed.
+///
+/// * May throw Event_loop_exception
+///
+void Timer_fd::arm_at( time_t t )
+{
+    struct itimerspec its {};
+    its.it_value.tv_sec = t;
+    int flags = TFD_TIMER_ABSTIME;
+    if (CLOCK_REALTIME == m_clock) {
+        flags |= TFD_TIMER_CANCEL_ON_SET;
+    }
+    if (timerfd_settime( m_fd, flags, &its, nullptr )) {
+        LOG_ERROR(Lgr) << "Timer_fd: timerfd_settime failed: "
+                       << strerror(errno);
+        throw Event_loop_exception();
+    }
+}
+
+/// Expire every secs seconds, starting secs from now.
+///
+/// * May throw Event_loop_exception
+///
+void Timer_fd::arm_periodic( time_t secs )
+{
+    arm_periodic( timespec{ secs, 0 } );
+}
+
+/// Expire every interval ts, starting ts from now.
+///
+/// * May throw Event_loop_exception
+///
+void Timer_fd::arm_periodic( const struct timespec &ts )
+{
+    struct itimerspec its {};
+    its.it_value = ts;
+    its.it_interval = ts;
+    if (timerfd_settime( m_fd, 0, &its, nullptr )) {
+        LOG_ERROR(Lgr) << "Timer_fd: timerfd_settime failed: "
+                       << strerror(errno);
+        throw Event_loop_exception();
+    }
+}
+
+/// Stop the timer.
+/// * Will NOT throw
+///
+void Timer_fd::disarm()
+{
+    struct itimerspec its {};
+    timerfd_settime( m_fd, 0, &its, nullptr );
+}
+
+/// Read and return the expiration count, 0 if none (or the clock was
+/// set, which cancels an absolute realtime timer).
+/// * Will NOT throw
+///
+uint64_t Timer_fd::consume()
+{
+    uint64_t n = 0;
+    if (read( m_fd, &n, sizeof(n) ) != sizeof(n)) {
+        if (ECANCELED == errno) {
+            LOG_INFO(Lgr) << "Timer_fd: system clock was set";
+        }
+        return 0;
+    }
+    return n;
+}
+
+
+//////////////////////////// Signal_fd ////////////////////////////////
+
+/// CTOR. Blocks the listed signals for this thread and creates a
+/// descriptor on which they may be read.
+/// * May throw Event_loop_exception
+///
+Signal_fd::Signal_fd( std::initializer_list<int> sigs )
+{
+    sigemptyset( &m_mask );
+    for (int s : sigs) {
+        sigaddset( &m_mask, s );
+    }
+    if (pthread_sigmask( SIG_BLOCK, &m_mask, &m_old_mask )) {
+        LOG_ERROR(Lgr) << "Signal_fd: cannot block signals";
+        throw Event_loop_exception();
+    }
+    m_fd = signalfd( -1, &m_mask, SFD_NONBLOCK|SFD_CLOEXEC );
+    if (m_fd < 0) {
+        LOG_ERROR(Lgr) << "Signal_fd: signalfd failed: " << strerror(errno);
+        pthread_sigmask( SIG_SETMASK, &m_old_mask, nullptr );
+        throw Event_loop_exception();
+    }
+}
+
+/// DTOR. Restores the previous signal mask; any signal still pending
+/// is then delivered normally.
+///
+Signal_fd::~Signal_fd()
+{
+    if (m_fd >= 0) {
+        close( m_fd );
+    }
+    pthread_sigmask( SIG_SETMASK, &m_old_mask, nullptr );
+}
+
+/// Return the number of the next pending signal, or 0 if none.
+/// * Will NOT throw
+///
+int Signal_fd::next()
+{
+    struct signalfd_siginfo si {};
+    if (read( m_fd, &si, sizeof(si) ) != sizeof(si)) {
+        return 0;
+    }
+    return static_cast<int>(si.ssi_signo);
+}
+
+
+//////////////////////////// Event_fd ////////////////////////////////
+
+/// CTOR
+/// * May throw Event_loop_exception
+///
+Event_fd::Event_fd()
+{
+    m_fd = eventfd( 0, EFD_NONBLOCK|EFD_CLOEXEC );
+    if (m_fd < 0) {
+        LOG_ERROR(Lgr) << "Event_fd: eventfd failed: " << strerror(errno);
+        throw Event_loop_exception();
+    }
+}
+
+/// DTOR
+///
+Event_fd::~Event_fd()
+{
+    if (m_fd >= 0) {
+        close( m_fd );
+    }
+}
+
+/// Increment the counter, making the descriptor readable.
+/// Safe to call from a signal handler.
+///
+void Event_fd::notify()
+{
+    uint64_t one = 1;
+    ssize_t rc = write( m_fd, &one, sizeof(one) );
+    (void) rc;
+}
+
+/// Read and reset the counter; 0 if it was not set.
+/// * Will NOT throw
+///
+uint64_t Event_fd::consume()
+{
+    uint64_t n = 0;
+    if (read( m_fd, &n, sizeof(n) ) != sizeof(n)) {
+        return 0;
+    }
+    return n;
+}
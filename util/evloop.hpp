@@ -0,0 +1,131 @@
+#pragma once
+/// Event loop over epoll, with timerfd, signalfd and eventfd helpers
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/// Normal usage pattern:
+///
+///    Event_loop loop {};
+///    Timer_fd tick { CLOCK_MONOTONIC };
+///    tick.arm_periodic( 10 );
+///    loop.add( tick.fd(), [&](uint32_t){ tick.consume(); ... } );
+///    for (;;) {
+///        loop.run_once( -1 );    // dispatch whatever became ready
+///    }
+
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <unordered_map>
+#include <signal.h>
+#include <sys/epoll.h>
+
+
+/// Failure to create or operate one of the event descriptors.
+///
+struct Event_loop_exception : public std::exception {
+    const char* what() const throw() { return "Event loop exception"; }
+};
+
+
+///////////////////////////////////////////////////////////////////
+
+/// Dispatches readiness of registered file descriptors to handlers.
+/// Handlers are called with the epoll event mask for their fd.
+///
+class Event_loop {
+public:
+    using Handler = std::function<void(uint32_t)>;
+private:
+    enum { non_fd=(-1), MaxEvents=16 };
+    int m_epfd { non_fd };
+    std::unordered_map<int,Handler> m_handlers {};
+public:
+    void add( int, Handler, uint32_t events=EPOLLIN );
+    int fd() const { return m_epfd; }
+    void remove( int );
+    unsigned run_once( int );   // timeout ms, -1 to wait forever
+    //
+    Event_loop();
+    Event_loop(const Event_loop&) = delete;
+    void operator=(const Event_loop&) = delete;
+    ~Event_loop();
+};
+
+
+/// A timerfd: readable when it expires.
+///
+class Timer_fd {
+private:
+    int m_fd { -1 };
+    clockid_t m_clock;
+public:
+    void arm_at( time_t );       // absolute, CLOCK_REALTIME only
+    void arm_periodic( time_t ); // every n seconds
+    void arm_periodic( const struct timespec& );
+    uint64_t consume();
+    void disarm();
+    int fd() const { return m_fd; }
+    //
+    explicit Timer_fd( clockid_t );
+    Timer_fd(const Timer_fd&) = delete;
+    void operator=(const Timer_fd&) = delete;
+    ~Timer_fd();
+};
+
+
+/// A signalfd for a set of signals, which are blocked for normal
+/// delivery while this object exists.  This blocks them only in the
+/// thread that creates it; any other thread that does not block them
+/// too may take them first (see Main::block_signals).
+///
+class Signal_fd {
+private:
+    int m_fd { -1 };
+    sigset_t m_mask {};
+    sigset_t m_old_mask {};
+public:
+    int fd() const { return m_fd; }
+    int next();              // next pending signal number, or 0
+    //
+    Signal_fd( std::initializer_list<int> );
+    Signal_fd(const Signal_fd&) = delete;
+    void operator=(const Signal_fd&) = delete;
+    ~Signal_fd();
+};
+
+
+/// An eventfd: a counter that any party (even a signal handler) may
+/// bump to wake the loop.
+///
+class Event_fd {
+private:
+    int m_fd { -1 };
+public:
+    uint64_t consume();
+    int fd() const { return m_fd; }
+    void notify();          // async signal safe
+    //
+    Event_fd();
+    Event_fd(const Event_fd&) = delete;
+    void operator=(const Event_fd&) = delete;
+    ~Event_fd();
+};
@@ -0,0 +1,228 @@
+/* Cached existence of local resources, kept current with inotify
+ */
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+
+#include "reswatch.hpp"
+#include "logging.hpp"
+
+
+/// Events in a watched directory that may change whether something
+/// beneath it exists.
+///
+constexpr uint32_t WatchMask { IN_CREATE|IN_DELETE|IN_MOVED_FROM|IN_MOVED_TO
+        |IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT|IN_ONLYDIR };
+
+/// Events after which the watch no longer describes its directory.
+///
+constexpr uint32_t GoneMask { IN_IGNORED|IN_DELETE_SELF|IN_MOVE_SELF|IN_UNMOUNT };
+
+
+/// CTOR. If inotify cannot be had, the watcher still works but every
+/// query goes to the filesystem.
+/// * Will NOT throw
+///
+Res_watcher::Res_watcher()
+{
+    m_fd = inotify_init1( IN_NONBLOCK|IN_CLOEXEC );
+    if (m_fd < 0) {
+        LOG_WARNING(Lgr) << "Res_watcher: inotify unavailable: "
+                         << strerror(errno);
+        return;
+    }
+    m_mounts_fd = open( "/proc/self/mounts", O_RDONLY|O_CLOEXEC );
+    if (m_mounts_fd < 0) {
+        LOG_WARNING(Lgr) << "Res_watcher: cannot watch mount table: "
+                         << strerror(errno);
+    }
+}
+
+/// DTOR. Closing the inotify descriptor drops all of its watches.
+///
+Res_watcher::~Res_watcher()
+{
+    if (m_mounts_fd >= 0) {
+        close( m_mounts_fd );
+    }
+    if (m_fd >= 0) {
+        close( m_fd );
+    }
+}
+
+/// Does path p exist?  Answered from memory if p was looked up before
+/// and nothing has happened since that could change the answer.
+/// * Will NOT throw
+///
+bool Res_watcher::exists( const boost::filesystem::path &p )
+{
+    drain();
+    const std::string &key = p.native();
+    auto it = m_exists.find( key );
+    if (it != m_exists.end()) {
+        return it->second;
+    }
+    ++m_stats;
+    // Watch before looking, so a change made between the two is still
+    // reported by the next drain() and cannot leave a stale answer.
+    int wd = (m_fd >= 0) ? watch_ancestor( p ) : -1;
+    boost::system::error_code ec;
+    bool ex = boost::filesystem::exists( p, ec );
+    if (wd >= 0) {
+        m_exists[key] = ex;
+        m_watches[wd].paths.push_back( key );
+    }
+    return ex;
+}
+
+/// Watch the parent directory of p, or if that does not exist, the
+/// nearest ancestor that does.  Return the watch descriptor, or -1 if
+/// no directory could be watched (p is then not cached).
+/// * Will NOT throw
+///
+int Res_watcher::watch_ancestor( const boost::filesystem::path &p )
+{
+    for (auto d = p.parent_path(); not d.empty(); d = d.parent_path()) {
+        const std::string &dk = d.native();
+        auto it = m_dir_wd.find( dk );
+        if (it != m_dir_wd.end()) {
+            return it->second;
+        }
+        int wd = inotify_add_watch( m_fd, dk.c_str(), WatchMask );
+        if (wd >= 0) {
+            m_dir_wd[dk] = wd;
+            Watch &w = m_watches[wd];    // may be an alias of a known dir
+            if (w.dir.empty()) {
+                w.dir = dk;
+            }
+            return wd;
+        }
+        if (errno != ENOENT and errno != ENOTDIR) {
+            LOG_WARNING(Lgr) << "Res_watcher: cannot watch " << d << ": "
+                             << strerror(errno);
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/// Process any pending inotify events and mount table changes,
+/// discarding the cached answers they may affect.  Never blocks.
+/// * Will NOT throw
+///
+void Res_watcher::drain()
+{
+    if (m_fd < 0) {
+        return;
+    }
+    struct pollfd pfds[2] { {m_fd, POLLIN, 0}, {m_mounts_fd, POLLPRI, 0} };
+    if (poll( pfds, (m_mounts_fd < 0 ? 1 : 2), 0 ) <= 0) {
+        return;                 // the usual case: one system call
+    }
+    if (pfds[1].revents & (POLLPRI|POLLERR)) {
+        mounts_changed();
+    }
+    alignas(struct inotify_event) char buf[4096];
+    for (;;) {
+        ssize_t n = read( m_fd, buf, sizeof(buf) );
+        if (n <= 0) {
+            break;              // EAGAIN: nothing more pending
+        }
+        for (char *p = buf; p < buf+n; ) {
+            const auto *ev = reinterpret_cast<const struct inotify_event*>(p);
+            if (ev->mask & IN_Q_OVERFLOW) {
+                LOG_WARNING(Lgr) << "Res_watcher: event queue overflow";
+                forget_all();
+            } else {
+                forget_watch( ev->wd, (ev->mask & GoneMask) );
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+}
+
+/// Forget the cached answers that depend on watch wd; if gone, the
+/// directory was deleted, moved or unmounted, so drop the watch too.
+/// * Will NOT throw
+///
+void Res_watcher::forget_watch( int wd, bool gone )
+{
+    auto it = m_watches.find( wd );
+    if (it == m_watches.end()) {
+        return;
+    }
+    if (not it->second.paths.empty()) {
+        for (const auto &key : it->second.paths) {
+            m_exists.erase( key );
+        }
+        it->second.paths.clear();
+        ++m_changes;
+    }
+    if (gone) {
+        inotify_rm_watch( m_fd, wd );   // harmless if already removed
+        for (auto dit = m_dir_wd.begin(); dit != m_dir_wd.end(); ) {
+            if (dit->second == wd) {
+                dit = m_dir_wd.erase( dit );
+            } else {
+                ++dit;
+            }
+        }
+        m_watches.erase( it );
+    }
+}
+
+/// Forget everything: cached answers and watches.
+/// * Will NOT throw
+///
+void Res_watcher::forget_all()
+{
+    for (const auto &pr : m_watches) {
+        inotify_rm_watch( m_fd, pr.first );
+    }
+    m_watches.clear();
+    m_dir_wd.clear();
+    m_exists.clear();
+    ++m_changes;
+}
+
+/// The mount table changed.  A mount or unmount anywhere may reveal or
+/// hide any path, and does
+/// not show up as an inotify event in the mount point directory, so
+/// it flushes the whole cache.  The mount table must be read again to
+/// rearm its change notification.  Call this when an outside poll of
+/// mounts_fd() reports the change, since drain() will not see it then.
+/// * Will NOT throw
+///
+void Res_watcher::mounts_changed()
+{
+    if (m_mounts_fd < 0) {
+        return;
+    }
+    LOG_INFO(Lgr) << "Res_watcher: mount table changed";
+    forget_all();
+    char buf[4096];
+    lseek( m_mounts_fd, 0, SEEK_SET );
+    while (read( m_mounts_fd, buf, sizeof(buf) ) > 0) { }
+}
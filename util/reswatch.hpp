@@ -0,0 +1,71 @@
+#pragma once
+/// Cached existence of local resources, kept current with inotify
+
+/*   Part of the rsked package.
+ *
+ *   Copyright 2020 Steven A. Harp
+ *
+ *   Licensed under the Apache License, Version 2.0 (the "License");
+ *   you may not use this file except in compliance with the License.
+ *   You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *   Unless required by applicable law or agreed to in writing, software
+ *   distributed under the License is distributed on an "AS IS" BASIS,
+ *   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *   See the License for the specific language governing permissions and
+ *   limitations under the License.
+ *
+ */
+
+/// Normal usage pattern:
+///
+///    Res_watcher rw {};
+///    if (rw.exists( "/media/usb/Music/Album" )) ...   // stats, then watches
+///    if (rw.exists( "/media/usb/Music/Album" )) ...   // answered from memory
+///
+/// The first query for a path stats it and puts an inotify watch on its
+/// parent directory (or the nearest ancestor that exists).  Later
+/// queries are answered from memory until an event in that directory,
+/// or any mount or unmount, discards the cached answer.  If inotify is
+/// not available every query stats the path, as before.
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+
+class Res_watcher {
+private:
+    struct Watch {
+        std::string dir;                  // watched directory
+        std::vector<std::string> paths;   // cached paths depending on it
+    };
+    int m_fd { -1 };                      // inotify descriptor
+    int m_mounts_fd { -1 };               // /proc/self/mounts, pollable
+    std::unordered_map<std::string,bool> m_exists {};  // path -> exists?
+    std::unordered_map<int,Watch> m_watches {};        // wd -> Watch
+    std::unordered_map<std::string,int> m_dir_wd {};   // dir -> wd
+    unsigned long m_changes {0};          // invalidations so far
+    unsigned long m_stats {0};            // filesystem lookups so far
+    //
+    void forget_all();
+    void forget_watch( int, bool );
+    int watch_ancestor( const boost::filesystem::path& );
+public:
+    unsigned long changes() { drain(); return m_changes; }
+    void drain();
+    bool enabled() const { return m_fd >= 0; }
+    bool exists( const boost::filesystem::path& );
+    int fd() const { return m_fd; }
+    void mounts_changed();
+    int mounts_fd() const { return m_mounts_fd; }
+    unsigned long stats() const { return m_stats; }
+    //
+    Res_watcher();
+    Res_watcher(const Res_watcher&) = delete;
+    void operator=(const Res_watcher&) = delete;
+    ~Res_watcher();
+};